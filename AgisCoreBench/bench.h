@@ -0,0 +1,87 @@
+//
+// bench.h
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace AgisBench
+{
+
+//============================================================================
+/// <summary>
+/// Point of the parameter grid a benchmark case is run at
+/// </summary>
+struct BenchParams
+{
+	size_t assets = 100;
+	size_t bars = 1000;
+	size_t strategies = 1;
+	size_t threads = 1;
+};
+
+
+//============================================================================
+/// <summary>
+/// What a case measured inside its timed region. Steps and orders are left unset by cases that
+/// do not step a Hydra or can not see the orders their strategies place, resident bytes by
+/// cases that do not measure a footprint.
+/// </summary>
+struct BenchMeasure
+{
+	double seconds = 0.0;
+	std::optional<size_t> steps;
+	std::optional<size_t> orders;
+	std::optional<uint64_t> allocations;
+	std::optional<size_t> resident_bytes;
+};
+
+
+//============================================================================
+struct BenchResult
+{
+	std::string name;
+	BenchParams params;
+	BenchMeasure measure;
+	size_t peak_rss_bytes = 0;
+	std::optional<std::string> error;
+};
+
+
+//============================================================================
+/// <summary>
+/// A named benchmark. The case builds whatever it needs outside of the timed region and returns
+/// the measure of that region only.
+/// </summary>
+struct BenchCase
+{
+	std::string name;
+	std::function<std::expected<BenchMeasure, std::string>(BenchParams const&)> run;
+};
+
+
+std::vector<BenchCase> hydra_cases();
+
+/// <summary>
+/// Rolling observer kernels outside of a Hydra, each pushes bars values into one window per asset
+/// </summary>
+std::vector<BenchCase> observer_cases();
+
+/// <summary>
+/// Peak resident set size of the process so far in bytes, 0 where the platform does not report it
+/// </summary>
+size_t peak_rss_bytes() noexcept;
+
+/// <summary>
+/// Current resident set size of the process in bytes, 0 where the platform does not report it
+/// </summary>
+size_t resident_bytes() noexcept;
+
+}
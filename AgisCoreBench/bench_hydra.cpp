@@ -0,0 +1,536 @@
+//
+// bench_hydra.cpp : end to end Hydra benchmark cases
+//
+
+#include "bench.h"
+
+#include <Eigen/Dense>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <type_traits>
+
+import HydraModule;
+import ExchangeModule;
+import AssetModule;
+import PortfolioModule;
+import TradeModule;
+import StrategyModule;
+import AgisStrategyTree;
+import AgisTimeUtils;
+import AgisTypes;
+import AssetCacheModule;
+import AgisAllocCounter;
+import MarketGeneratorModule;
+
+using namespace Agis;
+using namespace Agis::AST;
+
+namespace AgisBench
+{
+
+namespace
+{
+
+std::string const exchange_id = "bench";
+constexpr double strategy_cash = 1e9;
+constexpr uint64_t market_seed = 42;
+constexpr size_t view_evaluations = 16;
+
+
+//============================================================================
+/// <summary>
+/// Strategy base that counts the orders it places so a case can report orders per second
+/// </summary>
+class CountingStrategy : public Strategy
+{
+public:
+	CountingStrategy(std::string strategy_id, Exchange const& exchange, Portfolio& portfolio)
+		: Strategy(strategy_id, strategy_cash, exchange, portfolio), _exchange(exchange)
+	{
+	}
+
+	size_t orders() const noexcept { return _orders; }
+
+protected:
+	void place_order(size_t asset_index, double units)
+	{
+		Strategy::place_market_order(asset_index, units);
+		_orders++;
+	}
+
+	Exchange const& _exchange;
+	size_t _orders = 0;
+};
+
+
+//============================================================================
+/// <summary>
+/// Touches one asset per step, opening a unit position or closing the open one
+/// </summary>
+class RotationStrategy : public CountingStrategy
+{
+public:
+	using CountingStrategy::CountingStrategy;
+
+	std::expected<bool, AgisException> step() noexcept override
+	{
+		auto const& assets = _exchange.get_assets();
+		auto const& asset = assets[_next++ % assets.size()];
+		if (!asset->is_streaming()) return true;
+		auto index = asset->get_index();
+		auto trade = this->get_trade(index);
+		place_order(index, trade ? -(*trade)->get_units() : 1.0);
+		return true;
+	}
+
+private:
+	size_t _next = 0;
+};
+
+
+//============================================================================
+/// <summary>
+/// Trades every streaming asset on every step, alternating between buying and selling a unit
+/// </summary>
+class RebalanceStrategy : public CountingStrategy
+{
+public:
+	using CountingStrategy::CountingStrategy;
+
+	std::expected<bool, AgisException> step() noexcept override
+	{
+		_units = -_units;
+		for (auto const& asset : _exchange.get_assets())
+		{
+			if (asset->is_streaming()) place_order(asset->get_index(), _units);
+		}
+		return true;
+	}
+
+private:
+	double _units = -1.0;
+};
+
+
+//============================================================================
+/// <summary>
+/// Equal weights the tenth of the exchange with the largest one bar price ratio
+/// </summary>
+class ASTBenchStrategy : public Strategy
+{
+public:
+	ASTBenchStrategy(std::string strategy_id, Exchange const& exchange, Portfolio& portfolio)
+		: Strategy(strategy_id, strategy_cash, exchange, portfolio)
+	{
+		auto exchange_node = std::make_shared<ExchangeNode>(&exchange);
+		auto previous_price = exchange_node->create_asset_lambda_read_node("CLOSE", -1);
+		auto current_price = exchange_node->create_asset_lambda_read_node("CLOSE", 0);
+		auto return_node = std::make_unique<AssetOpperationNode>(
+			std::move(previous_price.value()),
+			std::move(current_price.value()),
+			AgisOperator::DIVIDE
+		);
+		auto view_node = std::make_unique<ExchangeViewNode>(exchange_node, std::move(return_node));
+		auto count = std::max<size_t>(1, exchange.get_assets().size() / 10);
+		auto sort_node = std::make_unique<ExchangeViewSortNode>(
+			std::move(view_node),
+			ExchangeQueryType::NLargest,
+			static_cast<int>(count)
+		);
+		auto alloc_node = std::make_unique<AllocationNode>(std::move(sort_node), AllocType::UNIFORM);
+		_node = std::make_unique<StrategyNode>(*this, std::move(alloc_node), 0.0f);
+	}
+
+	std::expected<bool, AgisException> step() noexcept override
+	{
+		return _node->evaluate();
+	}
+
+private:
+	std::unique_ptr<StrategyNode> _node;
+};
+
+
+//============================================================================
+enum class Workload
+{
+	EMPTY,
+	MARKET,
+	AST,
+	REBALANCE
+};
+
+
+//============================================================================
+/// <summary>
+/// Times a region and the allocations made inside of it
+/// </summary>
+class Stopwatch
+{
+public:
+	Stopwatch() noexcept
+		: _allocations(allocation_count()), _start(std::chrono::steady_clock::now())
+	{
+	}
+
+	BenchMeasure stop() const noexcept
+	{
+		BenchMeasure measure;
+		measure.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+		if (allocation_counting()) measure.allocations = allocation_count() - _allocations;
+		return measure;
+	}
+
+private:
+	uint64_t _allocations;
+	std::chrono::steady_clock::time_point _start;
+};
+
+
+//============================================================================
+MarketGeneratorConfig
+market_config(BenchParams const& params) noexcept
+{
+	MarketGeneratorConfig config;
+	config.asset_count = params.assets;
+	config.bar_count = params.bars;
+	config.seed = market_seed;
+	config.process = PriceProcess::FACTOR;
+	config.missing_probability = 0.01;
+	return config;
+}
+
+
+//============================================================================
+/// <summary>
+/// Write the generated market as one csv per asset with epoch nanosecond dates, once per
+/// asset and bar count, and return the folder
+/// </summary>
+std::expected<std::string, std::string>
+write_market(BenchParams const& params)
+{
+	auto source = std::filesystem::temp_directory_path() /
+		("agis_bench_" + std::to_string(params.assets) + "_" + std::to_string(params.bars));
+	if (std::filesystem::exists(source)) return source.string();
+
+	auto market = generate_market(market_config(params));
+	if (!market) return std::unexpected(market.error().what());
+	std::filesystem::create_directories(source);
+	auto const& columns = generated_columns();
+	for (auto const& panel : market->assets)
+	{
+		std::ofstream file(source / (panel.asset_id + ".csv"));
+		file.precision(17);
+		file << "DATE";
+		for (auto const& column : columns) file << "," << column;
+		file << "\n";
+		for (size_t row = 0; row < panel.dt_index.size(); row++)
+		{
+			file << panel.dt_index[row];
+			for (size_t col = 0; col < columns.size(); col++) file << "," << panel.data[row * columns.size() + col];
+			file << "\n";
+		}
+		if (!file) return std::unexpected("Failed to write " + panel.asset_id);
+	}
+	return source.string();
+}
+
+
+//============================================================================
+/// <summary>
+/// Hydra over the generated market along with the strategies registered on it
+/// </summary>
+struct BenchHydra
+{
+	std::unique_ptr<Hydra> hydra = std::make_unique<Hydra>();
+	std::vector<CountingStrategy const*> counters;
+
+	size_t orders() const noexcept
+	{
+		size_t orders = 0;
+		for (auto counter : counters) orders += counter->orders();
+		return orders;
+	}
+};
+
+
+//============================================================================
+template <typename T>
+std::expected<bool, std::string>
+register_strategy(BenchHydra& bench, size_t i, Exchange const& exchange)
+{
+	auto id = std::to_string(i);
+	auto portfolio = bench.hydra->create_portfolio("portfolio" + id, exchange_id);
+	if (!portfolio) return std::unexpected(portfolio.error().what());
+	auto strategy = std::make_unique<T>("strategy" + id, exchange, *portfolio.value());
+	auto strategy_ptr = strategy.get();
+	auto res = bench.hydra->register_strategy(std::move(strategy));
+	if (!res) return std::unexpected(res.error().what());
+	if constexpr (std::is_base_of_v<CountingStrategy, T>) bench.counters.push_back(strategy_ptr);
+	return true;
+}
+
+
+//============================================================================
+std::expected<BenchHydra, std::string>
+make_hydra(BenchParams const& params, Workload workload)
+{
+	auto market = generate_market(market_config(params));
+	if (!market) return std::unexpected(market.error().what());
+
+	BenchHydra bench;
+	bench.hydra->set_step_workers(params.threads > 1 ? params.threads : 0);
+	auto exchange = bench.hydra->create_exchange(exchange_id, std::move(market.value()));
+	if (!exchange) return std::unexpected(exchange.error().what());
+	for (size_t i = 0; i < params.strategies && workload != Workload::EMPTY; i++)
+	{
+		std::expected<bool, std::string> res;
+		switch (workload)
+		{
+			case Workload::MARKET: res = register_strategy<RotationStrategy>(bench, i, *exchange.value()); break;
+			case Workload::AST: res = register_strategy<ASTBenchStrategy>(bench, i, *exchange.value()); break;
+			case Workload::REBALANCE: res = register_strategy<RebalanceStrategy>(bench, i, *exchange.value()); break;
+			default: break;
+		}
+		if (!res) return std::unexpected(res.error());
+	}
+	return bench;
+}
+
+
+//============================================================================
+std::expected<BenchMeasure, std::string>
+bench_load(BenchParams const& params, bool warm)
+{
+	auto source = write_market(params);
+	if (!source) return std::unexpected(source.error());
+	std::error_code ec;
+	std::filesystem::remove(asset_cache_path(*source), ec);
+	if (warm)
+	{
+		// a first load writes the cache the timed load maps
+		Hydra hydra;
+		auto res = hydra.create_exchange(exchange_id, std::string(DT_FORMAT_EPOCH_NS), *source);
+		if (!res) return std::unexpected(res.error().what());
+	}
+
+	Hydra hydra;
+	Stopwatch watch;
+	auto res = hydra.create_exchange(exchange_id, std::string(DT_FORMAT_EPOCH_NS), *source);
+	auto measure = watch.stop();
+	if (!res) return std::unexpected(res.error().what());
+	// a cold load goes on to write the cache and a warm one does not, the load stats stop the
+	// clock once the assets are parsed or mapped so neither pays for the cache write or the
+	// build. Allocations still cover the whole call.
+	measure.seconds = res.value()->get_load_stats().seconds;
+	return measure;
+}
+
+
+//============================================================================
+std::expected<BenchMeasure, std::string>
+bench_generate(BenchParams const& params)
+{
+	Stopwatch watch;
+	auto market = generate_market(market_config(params));
+	auto measure = watch.stop();
+	if (!market) return std::unexpected(market.error().what());
+	return measure;
+}
+
+
+//============================================================================
+std::expected<BenchMeasure, std::string>
+bench_build(BenchParams const& params)
+{
+	auto bench = make_hydra(params, Workload::MARKET);
+	if (!bench) return std::unexpected(bench.error());
+	Stopwatch watch;
+	auto res = bench->hydra->build();
+	auto measure = watch.stop();
+	if (!res) return std::unexpected(res.error().what());
+	return measure;
+}
+
+
+//============================================================================
+std::expected<BenchMeasure, std::string>
+bench_run(BenchParams const& params, Workload workload, bool rerun)
+{
+	auto bench = make_hydra(params, workload);
+	if (!bench) return std::unexpected(bench.error());
+	auto& hydra = *bench->hydra;
+	auto build_res = hydra.build();
+	if (!build_res) return std::unexpected(build_res.error().what());
+	if (rerun)
+	{
+		auto first_run = hydra.run();
+		if (!first_run) return std::unexpected(first_run.error().what());
+	}
+
+	auto orders = bench->orders();
+	Stopwatch watch;
+	if (rerun)
+	{
+		auto reset_res = hydra.reset();
+		if (!reset_res) return std::unexpected(reset_res.error().what());
+	}
+	auto run_res = hydra.run();
+	auto measure = watch.stop();
+	if (!run_res) return std::unexpected(run_res.error().what());
+
+	measure.steps = hydra.get_dt_index().size();
+	// ast strategies allocate through the tree rather than placing orders themselves
+	if (workload != Workload::AST) measure.orders = bench->orders() - orders;
+	return measure;
+}
+
+
+//============================================================================
+/// <summary>
+/// Steps a Hydra without strategies through every row, one step call at a time or with a single
+/// run_n call that takes the lock once
+/// </summary>
+std::expected<BenchMeasure, std::string>
+bench_run_n(BenchParams const& params, bool run_n)
+{
+	auto bench = make_hydra(params, Workload::EMPTY);
+	if (!bench) return std::unexpected(bench.error());
+	auto& hydra = *bench->hydra;
+	auto build_res = hydra.build();
+	if (!build_res) return std::unexpected(build_res.error().what());
+	auto steps = hydra.get_dt_index().size();
+
+	Stopwatch watch;
+	if (run_n)
+	{
+		auto res = hydra.run_n(steps);
+		if (!res) return std::unexpected(res.error().what());
+		if (res.value() != steps) return std::unexpected(std::string("run_n stopped early"));
+	}
+	else
+	{
+		for (size_t i = 0; i < steps; i++)
+		{
+			auto res = hydra.step();
+			if (!res) return std::unexpected(res.error().what());
+		}
+	}
+	auto measure = watch.stop();
+	measure.steps = steps;
+	return measure;
+}
+
+
+//============================================================================
+/// <summary>
+/// Steps a sparse generated market, where each asset misses gaps of twenty bars at a time and
+/// prints on about one bar in eleven, with the exchange scanning every asset or only the active set
+/// </summary>
+std::expected<BenchMeasure, std::string>
+bench_active_set(BenchParams const& params, bool active_set)
+{
+	auto config = market_config(params);
+	config.missing_probability = 0.5;
+	config.missing_length = 20;
+	auto market = generate_market(config);
+	if (!market) return std::unexpected(market.error().what());
+	Hydra hydra;
+	auto exchange = hydra.create_exchange(exchange_id, std::move(market.value()));
+	if (!exchange) return std::unexpected(exchange.error().what());
+	hydra.get_exchange_mut(exchange_id).value()->set_active_set(active_set);
+	auto build_res = hydra.build();
+	if (!build_res) return std::unexpected(build_res.error().what());
+
+	Stopwatch watch;
+	auto run_res = hydra.run();
+	auto measure = watch.stop();
+	if (!run_res) return std::unexpected(run_res.error().what());
+	measure.steps = hydra.get_dt_index().size();
+	return measure;
+}
+
+
+//============================================================================
+/// <summary>
+/// Evaluates an exchange view of the five bar price ratio of every asset on each step of a
+/// generated market stored at the given precision. Steps counts evaluations, so the step rate is
+/// the evaluate rate. The exchange narrows after it loads, so peak RSS still holds the double panel
+/// and the resident bytes taken after the run show what the precision keeps.
+/// </summary>
+std::expected<BenchMeasure, std::string>
+bench_view(BenchParams const& params, StoragePrecision precision)
+{
+	auto market = generate_market(market_config(params));
+	if (!market) return std::unexpected(market.error().what());
+	auto hydra = std::make_unique<Hydra>();
+	auto exchange = hydra->create_exchange(exchange_id, std::move(market.value()), precision);
+	if (!exchange) return std::unexpected(exchange.error().what());
+
+	auto exchange_node = std::make_shared<ExchangeNode>(exchange.value());
+	auto previous_price = exchange_node->create_asset_lambda_read_node("CLOSE", -5);
+	auto current_price = exchange_node->create_asset_lambda_read_node("CLOSE", 0);
+	if (!previous_price || !current_price) return std::unexpected(std::string("Missing CLOSE column"));
+	ExchangeViewNode view_node(exchange_node, std::make_unique<AssetOpperationNode>(
+		std::move(previous_price.value()),
+		std::move(current_price.value()),
+		AgisOperator::DIVIDE
+	));
+	auto build_res = hydra->build();
+	if (!build_res) return std::unexpected(build_res.error().what());
+
+	// only the evaluations are timed, the steps between them are not
+	BenchMeasure measure;
+	size_t evaluations = 0;
+	double sink = 0.0;
+	for (size_t i = 0; i < hydra->get_dt_index().size(); i++)
+	{
+		auto step_res = hydra->step();
+		if (!step_res) return std::unexpected(step_res.error().what());
+		auto start = std::chrono::steady_clock::now();
+		for (size_t j = 0; j < view_evaluations; j++)
+		{
+			auto view = view_node.evaluate();
+			if (!view) return std::unexpected(view.error().what());
+			sink += (*view.value())[j % params.assets];
+		}
+		measure.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		evaluations += view_evaluations;
+	}
+	measure.steps = evaluations;
+	measure.resident_bytes = resident_bytes();
+	if (std::isinf(sink)) return std::unexpected(std::string("Non finite price ratio"));
+	return measure;
+}
+
+}
+
+
+//============================================================================
+std::vector<BenchCase>
+hydra_cases()
+{
+	return {
+		{ "load_csv", [](BenchParams const& p) { return bench_load(p, false); } },
+		{ "load_cache", [](BenchParams const& p) { return bench_load(p, true); } },
+		{ "generate", [](BenchParams const& p) { return bench_generate(p); } },
+		{ "build", [](BenchParams const& p) { return bench_build(p); } },
+		{ "run_empty", [](BenchParams const& p) { return bench_run(p, Workload::EMPTY, false); } },
+		{ "run_market", [](BenchParams const& p) { return bench_run(p, Workload::MARKET, false); } },
+		{ "run_ast", [](BenchParams const& p) { return bench_run(p, Workload::AST, false); } },
+		{ "rerun", [](BenchParams const& p) { return bench_run(p, Workload::MARKET, true); } },
+		{ "rebalance", [](BenchParams const& p) { return bench_run(p, Workload::REBALANCE, false); } },
+		{ "step_loop", [](BenchParams const& p) { return bench_run_n(p, false); } },
+		{ "run_n", [](BenchParams const& p) { return bench_run_n(p, true); } },
+		{ "step_full_scan", [](BenchParams const& p) { return bench_active_set(p, false); } },
+		{ "step_active_set", [](BenchParams const& p) { return bench_active_set(p, true); } },
+		{ "view_float64", [](BenchParams const& p) { return bench_view(p, StoragePrecision::FLOAT64); } },
+		{ "view_float32", [](BenchParams const& p) { return bench_view(p, StoragePrecision::FLOAT32); } },
+	};
+}
+
+}
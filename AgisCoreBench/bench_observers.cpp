@@ -0,0 +1,135 @@
+//
+// bench_observers.cpp : rolling observer microbenchmarks
+//
+
+#include "bench.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+import AssetObserverModule;
+
+using namespace Agis;
+
+namespace AgisBench
+{
+
+namespace
+{
+
+constexpr uint64_t series_seed = 7;
+constexpr size_t extremum_lookbacks[] = { 10, 100, 1000, 10000 };
+
+
+//============================================================================
+/// <summary>
+/// The rolling maximum the way TsMaxObserver computed it before it moved to a monotonic deque: keep
+/// the running maximum and rescan the whole buffer when the row holding it leaves the window. The
+/// old observer never moved its max index after a rescan, so it rarely rescanned and went stale,
+/// the index is kept here so that the baseline computes the same values as the deque.
+/// </summary>
+class RescanMax
+{
+public:
+	explicit RescanMax(size_t lookback) : _lookback(lookback), _buffer(lookback, 0.0) {}
+
+	void push(double v) noexcept
+	{
+		bool max_leaving = _count >= _lookback && _current_index == _max_index;
+		_buffer[_current_index] = v;
+		if (!_count || v >= _max)
+		{
+			_max = v;
+			_max_index = _current_index;
+		}
+		else if (max_leaving)
+		{
+			auto end = _buffer.begin() + std::min(_count + 1, _lookback);
+			auto itr = std::max_element(_buffer.begin(), end);
+			_max = *itr;
+			_max_index = static_cast<size_t>(itr - _buffer.begin());
+		}
+		_current_index = (_current_index + 1) % _lookback;
+		_count++;
+	}
+
+	double value() const noexcept { return _max; }
+
+private:
+	size_t _lookback;
+	size_t _current_index = 0;
+	size_t _max_index = 0;
+	size_t _count = 0;
+	double _max = 0.0;
+	std::vector<double> _buffer;
+};
+
+
+//============================================================================
+/// <summary>
+/// One downward trending random walk per asset, the case the rescan handles worst since the
+/// maximum keeps leaving the window
+/// </summary>
+std::vector<std::vector<double>>
+trending_series(BenchParams const& params)
+{
+	std::mt19937_64 rng(series_seed);
+	std::normal_distribution<double> noise(-0.05, 1.0);
+	std::vector<std::vector<double>> series(params.assets);
+	for (auto& s : series)
+	{
+		s.resize(params.bars);
+		double x = 1e4;
+		for (auto& v : s) v = x += noise(rng);
+	}
+	return series;
+}
+
+
+//============================================================================
+template <typename Window>
+std::expected<BenchMeasure, std::string>
+bench_extremum(BenchParams const& params, size_t lookback)
+{
+	auto series = trending_series(params);
+	double sink = 0.0;
+	auto start = std::chrono::steady_clock::now();
+	for (auto const& s : series)
+	{
+		Window window(lookback);
+		for (auto v : s)
+		{
+			window.push(v);
+			sink += window.value();
+		}
+	}
+	BenchMeasure measure;
+	measure.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	measure.steps = params.assets * params.bars;
+	if (sink == 0.0) return std::unexpected(std::string("Empty series"));
+	return measure;
+}
+
+}
+
+
+//============================================================================
+std::vector<BenchCase>
+observer_cases()
+{
+	std::vector<BenchCase> cases;
+	for (auto lookback : extremum_lookbacks)
+	{
+		auto suffix = "_" + std::to_string(lookback);
+		cases.push_back({ "ts_max_deque" + suffix, [lookback](BenchParams const& p) {
+			return bench_extremum<RollingExtremum>(p, lookback);
+		} });
+		cases.push_back({ "ts_max_rescan" + suffix, [lookback](BenchParams const& p) {
+			return bench_extremum<RescanMax>(p, lookback);
+		} });
+	}
+	return cases;
+}
+
+}
@@ -0,0 +1,332 @@
+//
+// main.cpp : runs the Hydra benchmark cases over a grid of parameters
+//
+// AgisCoreBench [--assets=10,100] [--bars=1000] [--strategies=1] [--threads=1,4]
+//               [--filter=run_] [--format=json|csv] [--out=path]
+//
+// The allocations columns are only filled when AgisCore counts its heap allocations, build it
+// with msbuild AgisCore.sln /p:Configuration=Release /p:AgisCountAllocations=true to define
+// AGIS_COUNT_ALLOCATIONS for the counter.
+//
+
+#include "bench.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+#include <tbb/global_control.h>
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string_view>
+
+namespace AgisBench
+{
+
+//============================================================================
+size_t
+peak_rss_bytes() noexcept
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+	{
+		return counters.PeakWorkingSetSize;
+	}
+	return 0;
+#else
+	rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage)) return 0;
+#ifdef __APPLE__
+	return static_cast<size_t>(usage.ru_maxrss);
+#else
+	return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+
+//============================================================================
+size_t
+resident_bytes() noexcept
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+	{
+		return counters.WorkingSetSize;
+	}
+	return 0;
+#elif defined(__linux__)
+	std::ifstream statm("/proc/self/statm");
+	size_t pages = 0;
+	size_t resident = 0;
+	if (!(statm >> pages >> resident)) return 0;
+	return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#else
+	return 0;
+#endif
+}
+
+
+//============================================================================
+struct BenchOptions
+{
+	std::vector<size_t> assets = { 10, 100, 1000 };
+	std::vector<size_t> bars = { 1000 };
+	std::vector<size_t> strategies = { 1 };
+	std::vector<size_t> threads = { 1 };
+	std::string filter;
+	std::string format = "json";
+	std::string out;
+};
+
+
+//============================================================================
+static std::expected<std::vector<size_t>, std::string>
+parse_list(std::string_view value)
+{
+	std::vector<size_t> list;
+	while (!value.empty())
+	{
+		auto comma = value.find(',');
+		auto item = value.substr(0, comma);
+		size_t number = 0;
+		auto [end, ec] = std::from_chars(item.data(), item.data() + item.size(), number);
+		if (ec != std::errc() || end != item.data() + item.size() || !number)
+		{
+			return std::unexpected("Invalid positive integer: " + std::string(item));
+		}
+		list.push_back(number);
+		value = comma == std::string_view::npos ? std::string_view() : value.substr(comma + 1);
+	}
+	if (list.empty()) return std::unexpected(std::string("Empty parameter list"));
+	return list;
+}
+
+
+//============================================================================
+static std::expected<BenchOptions, std::string>
+parse_options(int argc, char** argv)
+{
+	BenchOptions options;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string_view arg = argv[i];
+		auto eq = arg.find('=');
+		if (!arg.starts_with("--") || eq == std::string_view::npos)
+		{
+			return std::unexpected("Expected --name=value, got " + std::string(arg));
+		}
+		auto name = arg.substr(2, eq - 2);
+		auto value = arg.substr(eq + 1);
+		std::vector<size_t>* list = nullptr;
+		if (name == "assets") list = &options.assets;
+		else if (name == "bars") list = &options.bars;
+		else if (name == "strategies") list = &options.strategies;
+		else if (name == "threads") list = &options.threads;
+		else if (name == "filter") options.filter = value;
+		else if (name == "format") options.format = value;
+		else if (name == "out") options.out = value;
+		else return std::unexpected("Unknown option --" + std::string(name));
+
+		if (list)
+		{
+			auto parsed = parse_list(value);
+			if (!parsed) return std::unexpected("--" + std::string(name) + ": " + parsed.error());
+			*list = std::move(*parsed);
+		}
+	}
+	if (options.format != "json" && options.format != "csv")
+	{
+		return std::unexpected("Format must be json or csv, got " + options.format);
+	}
+	return options;
+}
+
+
+//============================================================================
+static std::string
+escape_json(std::string const& value)
+{
+	std::string escaped;
+	for (char c : value)
+	{
+		if (c == '"' || c == '\\') escaped += '\\';
+		if (static_cast<unsigned char>(c) < 0x20) c = ' ';
+		escaped += c;
+	}
+	return escaped;
+}
+
+
+//============================================================================
+template <typename T>
+static std::string
+optional_field(std::optional<T> const& value, std::string const& none)
+{
+	std::ostringstream out;
+	out.precision(12);
+	if (value) out << *value;
+	else out << none;
+	return out.str();
+}
+
+
+//============================================================================
+/// <summary>
+/// Rates derived from a measure, unset when the case did not measure what they are taken over
+/// </summary>
+struct BenchRates
+{
+	std::optional<double> steps_per_sec;
+	std::optional<double> ns_per_step;
+	std::optional<double> orders_per_sec;
+	std::optional<double> allocs_per_step;
+
+	explicit BenchRates(BenchMeasure const& measure) noexcept
+	{
+		auto const& m = measure;
+		if (m.steps && m.seconds > 0.0) steps_per_sec = *m.steps / m.seconds;
+		if (m.steps && *m.steps) ns_per_step = m.seconds * 1e9 / *m.steps;
+		if (m.orders && m.seconds > 0.0) orders_per_sec = *m.orders / m.seconds;
+		if (m.allocations && m.steps && *m.steps) allocs_per_step = static_cast<double>(*m.allocations) / *m.steps;
+	}
+};
+
+
+//============================================================================
+static void
+write_json(std::ostream& out, std::vector<BenchResult> const& results)
+{
+	out << "[\n";
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		auto const& r = results[i];
+		BenchRates rates(r.measure);
+		out << "  {\"name\":\"" << r.name << "\""
+			<< ",\"assets\":" << r.params.assets
+			<< ",\"bars\":" << r.params.bars
+			<< ",\"strategies\":" << r.params.strategies
+			<< ",\"threads\":" << r.params.threads
+			<< ",\"seconds\":" << optional_field(std::optional(r.measure.seconds), "null")
+			<< ",\"steps\":" << optional_field(r.measure.steps, "null")
+			<< ",\"steps_per_sec\":" << optional_field(rates.steps_per_sec, "null")
+			<< ",\"ns_per_step\":" << optional_field(rates.ns_per_step, "null")
+			<< ",\"orders\":" << optional_field(r.measure.orders, "null")
+			<< ",\"orders_per_sec\":" << optional_field(rates.orders_per_sec, "null")
+			<< ",\"peak_rss_bytes\":" << r.peak_rss_bytes
+			<< ",\"resident_bytes\":" << optional_field(r.measure.resident_bytes, "null")
+			<< ",\"allocations\":" << optional_field(r.measure.allocations, "null")
+			<< ",\"allocs_per_step\":" << optional_field(rates.allocs_per_step, "null")
+			<< ",\"error\":" << (r.error ? "\"" + escape_json(*r.error) + "\"" : std::string("null"))
+			<< "}" << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	out << "]\n";
+}
+
+
+//============================================================================
+static void
+write_csv(std::ostream& out, std::vector<BenchResult> const& results)
+{
+	out << "name,assets,bars,strategies,threads,seconds,steps,steps_per_sec,ns_per_step,orders,orders_per_sec,"
+		"peak_rss_bytes,resident_bytes,allocations,allocs_per_step,error\n";
+	for (auto const& r : results)
+	{
+		BenchRates rates(r.measure);
+		auto error = r.error.value_or("");
+		std::replace(error.begin(), error.end(), ',', ';');
+		out << r.name << "," << r.params.assets << "," << r.params.bars << "," << r.params.strategies
+			<< "," << r.params.threads
+			<< "," << optional_field(std::optional(r.measure.seconds), "")
+			<< "," << optional_field(r.measure.steps, "")
+			<< "," << optional_field(rates.steps_per_sec, "")
+			<< "," << optional_field(rates.ns_per_step, "")
+			<< "," << optional_field(r.measure.orders, "")
+			<< "," << optional_field(rates.orders_per_sec, "")
+			<< "," << r.peak_rss_bytes
+			<< "," << optional_field(r.measure.resident_bytes, "")
+			<< "," << optional_field(r.measure.allocations, "")
+			<< "," << optional_field(rates.allocs_per_step, "")
+			<< "," << error << "\n";
+	}
+}
+
+
+//============================================================================
+static std::vector<BenchResult>
+run_grid(BenchOptions const& options)
+{
+	std::vector<BenchResult> results;
+	auto cases = hydra_cases();
+	auto observers = observer_cases();
+	cases.insert(cases.end(), observers.begin(), observers.end());
+	for (auto threads : options.threads)
+	{
+		// caps every tbb algorithm of the library, the step pool is sized by the case itself
+		tbb::global_control parallelism(tbb::global_control::max_allowed_parallelism, threads);
+		for (auto assets : options.assets)
+		for (auto bars : options.bars)
+		for (auto strategies : options.strategies)
+		for (auto const& bench_case : cases)
+		{
+			if (!options.filter.empty() && bench_case.name.find(options.filter) == std::string::npos) continue;
+			BenchResult result;
+			result.name = bench_case.name;
+			result.params = { assets, bars, strategies, threads };
+			auto measure = bench_case.run(result.params);
+			if (measure) result.measure = *measure;
+			else result.error = measure.error();
+			result.peak_rss_bytes = peak_rss_bytes();
+			std::cerr << result.name << " assets=" << assets << " bars=" << bars << " strategies=" << strategies
+				<< " threads=" << threads << ": " << (result.error ? *result.error : std::to_string(result.measure.seconds) + " s")
+				<< "\n";
+			results.push_back(std::move(result));
+		}
+	}
+	return results;
+}
+
+}
+
+
+//============================================================================
+int
+main(int argc, char** argv)
+{
+	using namespace AgisBench;
+	auto options = parse_options(argc, argv);
+	if (!options)
+	{
+		std::cerr << options.error() << "\n";
+		return 2;
+	}
+
+	auto results = run_grid(*options);
+	std::ofstream file;
+	if (!options->out.empty())
+	{
+		file.open(options->out);
+		if (!file)
+		{
+			std::cerr << "Failed to open " << options->out << "\n";
+			return 2;
+		}
+	}
+	auto& out = options->out.empty() ? std::cout : static_cast<std::ostream&>(file);
+	if (options->format == "csv") write_csv(out, results);
+	else write_json(out, results);
+
+	bool failed = std::any_of(results.begin(), results.end(), [](auto const& r) { return r.error.has_value(); });
+	return failed ? 1 : 0;
+}
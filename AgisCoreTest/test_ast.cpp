@@ -29,12 +29,12 @@ namespace AgisASTTest {
 	double cash1 = 10000.0f;
 	double cash2 = 20000.0f;
 
-	constexpr long long t0 = 960181200000000000;
-	constexpr long long t1 = 960267600000000000;
-	constexpr long long t2 = 960354000000000000;
-	constexpr long long t3 = 960440400000000000;
-	constexpr long long t4 = 960526800000000000;
-	constexpr long long t5 = 960786000000000000;
+	constexpr long long t0 = 960163200000000000;
+	constexpr long long t1 = 960249600000000000;
+	constexpr long long t2 = 960336000000000000;
+	constexpr long long t3 = 960422400000000000;
+	constexpr long long t4 = 960508800000000000;
+	constexpr long long t5 = 960768000000000000;
 };
 
 using namespace AgisASTTest;
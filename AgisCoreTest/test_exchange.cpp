@@ -3,6 +3,18 @@
 #include <rapidjson/allocators.h>
 #include <rapidjson/document.h>
 #include <Eigen/Dense>
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <thread>
+#include <unordered_map>
 
 import HydraModule;
 import ExchangeMapModule;
@@ -11,6 +23,21 @@ import AgisStrategyTree;
 import SerializeModule;
 import AssetModule;
 import AssetObserverModule;
+import AgisTimeUtils;
+import AssetCacheModule;
+import AgisFileUtils;
+import HydraFeedModule;
+import AgisTypes;
+import AgisArrayUtils;
+import AgisProfiler;
+import MarketGeneratorModule;
+import HydraRunModule;
+import CrossSectionModule;
+import PortfolioModule;
+import StrategyModule;
+import StrategyTracerModule;
+import OrderModule;
+import TradeModule;
 
 using namespace Agis;
 using namespace Agis::AST;
@@ -27,14 +54,116 @@ namespace AgisExchangeTest {
 	std::string exchange_id_complex = "SPY_DAILY";
 	std::string dt_format = "%Y-%m-%d";
 
-	constexpr long long t0 = 960181200000000000;
-	constexpr long long t1 = 960267600000000000;
-	constexpr long long t2 = 960354000000000000;
-	constexpr long long t3 = 960440400000000000;
-	constexpr long long t4 = 960526800000000000;
-	constexpr long long t5 = 960786000000000000;
+	constexpr long long t0 = 960163200000000000;
+	constexpr long long t1 = 960249600000000000;
+	constexpr long long t2 = 960336000000000000;
+	constexpr long long t3 = 960422400000000000;
+	constexpr long long t4 = 960508800000000000;
+	constexpr long long t5 = 960768000000000000;
+	constexpr long long t6 = 960854400000000000;
+	constexpr long long t7 = 960940800000000000;
 	constexpr double epsilon = 1e-7;  
 
+	/// <summary>
+	/// Write a csv exchange to a temp directory where asset i prints once every 20 + i % 31 days
+	/// </summary>
+	std::string write_sparse_exchange(std::string const& name, std::string const& prefix, size_t asset_count, size_t day_count)
+	{
+		auto source = std::filesystem::temp_directory_path() / name;
+		std::filesystem::remove_all(source);
+		std::filesystem::create_directories(source);
+		auto start_day = std::chrono::sys_days{ std::chrono::year{ 2000 } / 1 / 3 };
+		for (size_t a = 0; a < asset_count; a++)
+		{
+			std::ofstream file(source / (prefix + std::to_string(a) + ".csv"));
+			file << "DATE,OPEN,CLOSE\n";
+			auto period = 20 + a % 31;
+			for (size_t d = a % period; d < day_count; d += period)
+			{
+				std::chrono::year_month_day ymd{ start_day + std::chrono::days{ d } };
+				char date[16];
+				std::snprintf(date, sizeof(date), "%04d-%02u-%02u",
+					static_cast<int>(ymd.year()), static_cast<unsigned>(ymd.month()), static_cast<unsigned>(ymd.day()));
+				file << date << "," << 100 + d << "," << 101 + d << "\n";
+			}
+		}
+		return source.string();
+	}
+
+
+	/// <summary>
+	/// Remove every cache written next to an exchange source, the full one and the ones keyed by a
+	/// symbol filter. The exchanges loaded from it must be gone so that nothing maps the caches.
+	/// </summary>
+	void remove_exchange_caches(std::string const& source)
+	{
+		auto path = std::filesystem::path(source);
+		if (!path.has_filename()) path = path.parent_path();
+		auto name = path.filename().string();
+		std::error_code ec;
+		for (auto const& entry : std::filesystem::directory_iterator(path.parent_path(), ec))
+		{
+			auto file_name = entry.path().filename().string();
+			if (file_name.starts_with(name) && entry.path().extension().string() == ASSET_CACHE_EXTENSION)
+			{
+				std::filesystem::remove(entry.path(), ec);
+			}
+		}
+	}
+
+
+	/// <summary>
+	/// Remove an exchange source written by a test along with the caches its loads wrote next to it
+	/// </summary>
+	void remove_exchange_source(std::string const& source)
+	{
+		std::error_code ec;
+		std::filesystem::remove_all(source, ec);
+		remove_exchange_caches(source);
+	}
+
+
+	/// <summary>
+	/// Removes the caches left next to the shared test data once every test has released its exchanges
+	/// </summary>
+	class ExchangeCacheEnvironment : public ::testing::Environment
+	{
+	public:
+		void TearDown() override
+		{
+			remove_exchange_caches(exchange1_path);
+			remove_exchange_caches(exchange_complex_path);
+		}
+	};
+	auto const exchange_cache_environment = ::testing::AddGlobalTestEnvironment(new ExchangeCacheEnvironment);
+
+
+	/// <summary>
+	/// Flips a unit position in every streaming asset of its exchange on each step, so every
+	/// exchange fills orders on each row it prints
+	/// </summary>
+	class FlipStrategy : public Strategy
+	{
+	public:
+		FlipStrategy(std::string strategy_id, Exchange const& exchange, Portfolio& portfolio)
+			: Strategy(strategy_id, 1e6, exchange, portfolio), _exchange(exchange) {}
+
+		std::expected<bool, AgisException> step() noexcept override
+		{
+			for (auto const& asset : _exchange.get_assets())
+			{
+				if (!asset->is_streaming()) continue;
+				auto index = asset->get_index();
+				auto trade = this->get_trade(index);
+				Strategy::place_market_order(index, trade ? -(*trade)->get_units() : 1.0);
+			}
+			return true;
+		}
+
+	private:
+		Exchange const& _exchange;
+	};
+
 };
 
 using namespace AgisExchangeTest;
@@ -110,12 +239,721 @@ TEST_F(ComplexExchangeTests, TestH5Load)
 }
 
 
+TEST(TimeUtilsTests, DateTimeParser)
+{
+	DateTimeParser date_parser(dt_format);
+	EXPECT_TRUE(date_parser.is_compiled());
+	EXPECT_EQ(date_parser.parse("2000-06-05").value(), t0);
+	EXPECT_EQ(date_parser.parse(" 2000-06-12\r").value(), t5);
+	EXPECT_FALSE(date_parser.parse("2000-13-05").has_value());
+	EXPECT_FALSE(date_parser.parse("2000-06-5").has_value());
+	EXPECT_FALSE(date_parser.parse("2000-06-00").has_value());
+	EXPECT_FALSE(date_parser.parse("2000-02-30").has_value());
+	EXPECT_FALSE(date_parser.parse("2000-04-31").has_value());
+	EXPECT_FALSE(date_parser.parse("2001-02-29").has_value());
+	EXPECT_FALSE(date_parser.parse("1900-02-29").has_value());
+	EXPECT_EQ(date_parser.parse("2000-02-29").value() + 86400000000000, date_parser.parse("2000-03-01").value());
+	EXPECT_TRUE(date_parser.parse("2000-01-31").has_value());
+
+	DateTimeParser datetime_parser("%Y-%m-%d %H:%M:%S");
+	EXPECT_EQ(datetime_parser.parse("2000-06-05 13:45:07").value(), t0 + 49507000000000);
+
+	DateTimeParser epoch_parser(std::string(DT_FORMAT_EPOCH_NS));
+	EXPECT_EQ(epoch_parser.parse("960163200000000000").value(), t0);
+}
+
+
 TEST_F(SimpleExchangeTests, ExchangeCreate) {
 	EXPECT_TRUE(hydra->asset_exists("test1"));
 	EXPECT_FALSE(hydra->asset_exists("test0"));
 }
 
 
+TEST_F(SimpleExchangeTests, ExchangeLoadStats) {
+	auto exchange = hydra->get_exchange(exchange_id_1).value();
+	auto const& stats = exchange->get_load_stats();
+	EXPECT_EQ(stats.rows, 16);
+	EXPECT_GT(stats.bytes, 0);
+	EXPECT_EQ(exchange->get_asset(asset_id_1).value()->get_load_stats().rows, 4);
+	EXPECT_EQ(exchange->get_asset(asset_id_2).value()->get_load_stats().rows, 6);
+}
+
+
+TEST_F(SimpleExchangeTests, ExchangeCache) {
+	// the fixture load leaves a cache behind, a second load must map it and see identical data
+	EXPECT_TRUE(std::filesystem::exists(asset_cache_path(exchange1_path)));
+	auto cached_hydra = std::make_shared<Hydra>();
+	auto res = cached_hydra->create_exchange(exchange_id_1, dt_format, exchange1_path);
+	EXPECT_TRUE(res.has_value());
+	auto exchange = hydra->get_exchange(exchange_id_1).value();
+	auto cached_exchange = cached_hydra->get_exchange(exchange_id_1).value();
+	EXPECT_EQ(cached_exchange->get_columns(), exchange->get_columns());
+	for (auto const& asset_id : { asset_id_1, asset_id_2, asset_id_3 })
+	{
+		auto asset = exchange->get_asset(asset_id).value();
+		auto cached_asset = cached_exchange->get_asset(asset_id).value();
+		EXPECT_EQ(cached_asset->get_index(), asset->get_index());
+		EXPECT_EQ(cached_asset->get_close_index(), asset->get_close_index());
+		EXPECT_TRUE(std::ranges::equal(cached_asset->get_dt_index(), asset->get_dt_index()));
+		EXPECT_TRUE(std::ranges::equal(cached_asset->get_data(), asset->get_data()));
+	}
+}
+
+
+TEST_F(SimpleExchangeTests, ExchangeSharedStore) {
+	// every load of the same source binds to one mapping, including the load that wrote the cache
+	auto shared_hydra = std::make_shared<Hydra>();
+	auto res = shared_hydra->create_exchange(exchange_id_1, dt_format, exchange1_path);
+	EXPECT_TRUE(res.has_value());
+	auto exchange = hydra->get_exchange(exchange_id_1).value();
+	auto shared_exchange = shared_hydra->get_exchange(exchange_id_1).value();
+	for (auto const& asset_id : { asset_id_1, asset_id_2, asset_id_3 })
+	{
+		auto asset = exchange->get_asset(asset_id).value();
+		auto shared_asset = shared_exchange->get_asset(asset_id).value();
+		EXPECT_EQ(shared_asset->get_data().data(), asset->get_data().data());
+		EXPECT_EQ(shared_asset->get_dt_index().data(), asset->get_dt_index().data());
+	}
+
+	// a symbol filter is cached separately from the full source
+	std::vector<std::string> symbols = { asset_id_2 };
+	auto filtered_hydra = std::make_shared<Hydra>();
+	res = filtered_hydra->create_exchange(exchange_id_1, dt_format, exchange1_path, symbols);
+	EXPECT_TRUE(res.has_value());
+	EXPECT_NE(asset_cache_path(exchange1_path, symbols), asset_cache_path(exchange1_path));
+	EXPECT_TRUE(std::filesystem::exists(asset_cache_path(exchange1_path, symbols)));
+}
+
+
+TEST_F(SimpleExchangeTests, ExchangeLoadWindow) {
+	LoadWindow window;
+	window.start = t1;
+	window.end = t3;
+	window.columns = std::vector<std::string>{ "CLOSE" };
+	auto window_hydra = std::make_shared<Hydra>();
+	auto res = window_hydra->create_exchange(exchange_id_1, dt_format, exchange1_path, std::nullopt, window);
+	EXPECT_TRUE(res.has_value());
+	auto exchange = window_hydra->get_exchange(exchange_id_1).value();
+	EXPECT_EQ(exchange->get_columns().size(), 2);
+	for (auto const& asset_id : { asset_id_1, asset_id_2, asset_id_3 })
+	{
+		auto asset = exchange->get_asset(asset_id).value();
+		EXPECT_EQ(asset->rows(), 3);
+		EXPECT_EQ(asset->get_dt_index().front(), t1);
+		EXPECT_EQ(asset->get_dt_index().back(), t3);
+	}
+	EXPECT_EQ(exchange->get_asset(asset_id_2).value()->get_column("CLOSE").value().front(), 99);
+
+	// assets without a row inside of the window are dropped
+	window.end = t0;
+	window.start = t0;
+	window_hydra = std::make_shared<Hydra>();
+	res = window_hydra->create_exchange(exchange_id_1, dt_format, exchange1_path, std::nullopt, window);
+	EXPECT_TRUE(res.has_value());
+	EXPECT_FALSE(window_hydra->asset_exists(asset_id_1));
+	EXPECT_TRUE(window_hydra->asset_exists(asset_id_2));
+	EXPECT_EQ(window_hydra->get_exchange(exchange_id_1).value()->get_assets().size(), 2);
+}
+
+
+TEST_F(SimpleExchangeTests, ExchangeFloat32) {
+	auto float_hydra = std::make_shared<Hydra>();
+	auto res = float_hydra->create_exchange(
+		exchange_id_1, dt_format, exchange1_path, std::nullopt, std::nullopt, StoragePrecision::FLOAT32
+	);
+	EXPECT_TRUE(res.has_value());
+	auto exchange = hydra->get_exchange(exchange_id_1).value();
+	auto float_exchange = float_hydra->get_exchange(exchange_id_1).value();
+	EXPECT_EQ(float_exchange->precision(), StoragePrecision::FLOAT32);
+	for (auto const& asset_id : { asset_id_1, asset_id_2, asset_id_3 })
+	{
+		auto asset = exchange->get_asset(asset_id).value();
+		auto float_asset = float_exchange->get_asset(asset_id).value();
+		EXPECT_EQ(float_asset->get_precision(), StoragePrecision::FLOAT32);
+		EXPECT_EQ(float_asset->get_data_bytes() * 2, asset->get_data_bytes());
+		EXPECT_TRUE(std::ranges::equal(float_asset->get_dt_index(), asset->get_dt_index()));
+	}
+
+	// both runs see the same prices to within float precision
+	hydra->build();
+	float_hydra->build();
+	auto& exchanges = hydra->get_exchanges();
+	auto& float_exchanges = float_hydra->get_exchanges();
+	for (size_t i = 0; i < 6; i++)
+	{
+		EXPECT_TRUE(hydra->step());
+		EXPECT_TRUE(float_hydra->step());
+		EXPECT_EQ(float_exchanges.get_global_time(), exchanges.get_global_time());
+		for (auto const& asset_id : { asset_id_1, asset_id_2, asset_id_3 })
+		{
+			auto price = exchanges.get_market_price(asset_id, true);
+			auto float_price = float_exchanges.get_market_price(asset_id, true);
+			EXPECT_EQ(price.has_value(), float_price.has_value());
+			if (price) EXPECT_NEAR(*float_price, *price, 1e-4);
+		}
+	}
+}
+
+
+TEST_F(SimpleExchangeTests, ExchangeRowAlignment) {
+	auto exchange = hydra->get_exchange(exchange_id_1).value();
+	auto dt_index = exchange->get_dt_index();
+	for (auto const& asset_id : { asset_id_1, asset_id_2, asset_id_3 })
+	{
+		auto asset = exchange->get_asset(asset_id).value();
+		auto asset_index = asset->get_dt_index();
+		for (size_t i = 0; i < dt_index.size(); i++)
+		{
+			auto it = std::find(asset_index.begin(), asset_index.end(), dt_index[i]);
+			auto row = exchange->get_asset_row(asset_id, dt_index[i]);
+			if (it == asset_index.end())
+			{
+				EXPECT_FALSE(row.has_value());
+				EXPECT_FALSE(asset->get_aligned_row(i).has_value());
+			}
+			else
+			{
+				EXPECT_EQ(row.value(), static_cast<size_t>(it - asset_index.begin()));
+				EXPECT_EQ(asset->get_aligned_row(i), row);
+			}
+		}
+	}
+	EXPECT_FALSE(exchange->get_asset_row(asset_id_1, t0 + 1).has_value());
+
+	// test1 runs from t1 to t4, a contiguous run of test2 which covers t0 to t5
+	auto asset1 = exchange->get_asset(asset_id_1).value();
+	auto asset2 = exchange->get_asset(asset_id_2).value();
+	EXPECT_TRUE(asset2->encloses(*asset1));
+	EXPECT_FALSE(asset1->encloses(*asset2));
+	EXPECT_EQ(asset2->get_enclosing_index(*asset1), 1);
+}
+
+
+TEST(SparseExchangeTests, CacheEntryColumnMismatch) {
+	auto source = write_sparse_exchange("agis_cache_columns", "asset", 5, 200);
+	std::vector<std::vector<double>> expected;
+	{
+		// the first load parses the source and writes the cache
+		auto hydra = std::make_shared<Hydra>();
+		EXPECT_TRUE(hydra->create_exchange("sparse", dt_format, source).has_value());
+		for (auto const& asset : hydra->get_exchange("sparse").value()->get_assets())
+		{
+			expected.emplace_back(asset->get_data().begin(), asset->get_data().end());
+		}
+	}
+
+	// narrow the first entry's rows, the bounds still fit the file but no longer match the header
+	auto cache_path = asset_cache_path(source);
+	ASSERT_TRUE(std::filesystem::exists(cache_path));
+	{
+		std::fstream file(cache_path, std::ios::in | std::ios::out | std::ios::binary);
+		AssetCacheHeader header;
+		file.read(reinterpret_cast<char*>(&header), sizeof(header));
+		AssetCacheEntry entry;
+		file.seekg(header.entries_offset);
+		file.read(reinterpret_cast<char*>(&entry), sizeof(entry));
+		ASSERT_EQ(entry.cols, header.column_count);
+		entry.cols--;
+		file.seekp(header.entries_offset);
+		file.write(reinterpret_cast<char const*>(&entry), sizeof(entry));
+	}
+
+	// the cache is rejected and the source parsed again
+	auto hydra = std::make_shared<Hydra>();
+	EXPECT_TRUE(hydra->create_exchange("sparse", dt_format, source).has_value());
+	auto const& assets = hydra->get_exchange("sparse").value()->get_assets();
+	ASSERT_EQ(assets.size(), expected.size());
+	for (size_t i = 0; i < assets.size(); i++)
+	{
+		EXPECT_TRUE(std::ranges::equal(assets[i]->get_data(), expected[i]));
+	}
+	hydra.reset();
+	remove_exchange_source(source);
+}
+
+
+TEST(SparseExchangeTests, ActiveSetMatchesFullScan) {
+	// a sparse universe where each asset prints on one day in every 20 to 50, the step rate of
+	// both modes is measured by the step_active_set and step_full_scan cases of AgisCoreBench
+	auto source = write_sparse_exchange("agis_sparse_exchange", "asset", 100, 500);
+
+	auto hydra = std::make_shared<Hydra>();
+	EXPECT_TRUE(hydra->create_exchange("sparse", dt_format, source).has_value());
+	auto exchange = hydra->get_exchange_mut("sparse").value();
+	auto const& assets = exchange->get_assets();
+	auto run = [&](bool active_set, std::vector<AssetState>& states) {
+		exchange->set_active_set(active_set);
+		EXPECT_TRUE(hydra->build().has_value());
+		EXPECT_TRUE(hydra->reset().has_value());
+		states.clear();
+		for (size_t i = 0; i < exchange->get_dt_index().size(); i++)
+		{
+			EXPECT_TRUE(hydra->step().has_value());
+			for (auto const& asset : assets) states.push_back(asset->get_state());
+		}
+	};
+	std::vector<AssetState> full_states, active_states;
+	run(false, full_states);
+	run(true, active_states);
+	EXPECT_EQ(active_states, full_states);
+	hydra.reset();
+	remove_exchange_source(source);
+}
+
+
+TEST(SparseExchangeTests, ParallelExchangeStep) {
+	auto source_a = write_sparse_exchange("agis_parallel_exchange_a", "a", 200, 500);
+	auto source_b = write_sparse_exchange("agis_parallel_exchange_b", "b", 200, 500);
+	using Fill = std::tuple<size_t, double, double, long long, OrderState>;
+	struct RunResult
+	{
+		std::vector<double> prices;
+		std::vector<Fill> fills;
+		std::vector<double> nlv;
+	};
+	auto run = [&](bool parallel) {
+		// one portfolio and strategy per exchange so that both exchanges fill orders on the same steps
+		RunResult result;
+		auto hydra = std::make_shared<Hydra>();
+		std::vector<std::string> portfolio_ids;
+		for (auto const& exchange_id : { "a", "b" })
+		{
+			EXPECT_TRUE(hydra->create_exchange(exchange_id, dt_format, exchange_id == std::string("a") ? source_a : source_b).has_value());
+			auto portfolio = hydra->create_portfolio(std::string("portfolio_") + exchange_id, exchange_id);
+			EXPECT_TRUE(portfolio.has_value());
+			portfolio.value()->set_tracer(Tracer::ORDERS);
+			portfolio_ids.push_back(portfolio.value()->get_portfolio_id());
+			auto strategy = std::make_unique<FlipStrategy>(
+				std::string("strategy_") + exchange_id, *hydra->get_exchange(exchange_id).value(), *portfolio.value()
+			);
+			EXPECT_TRUE(hydra->register_strategy(std::move(strategy)).has_value());
+		}
+		hydra->set_parallel_exchanges(parallel);
+		EXPECT_TRUE(hydra->build().has_value());
+		auto& exchanges = hydra->get_exchanges();
+		for (size_t i = 0; i < exchanges.get_dt_index().size(); i++)
+		{
+			EXPECT_TRUE(hydra->step().has_value());
+			for (auto const& exchange_id : { "a", "b" })
+			{
+				for (auto const& asset : hydra->get_exchange(exchange_id).value()->get_assets())
+				{
+					result.prices.push_back(asset->get_market_price(true).value_or(-1.0));
+					result.prices.push_back(static_cast<double>(asset->get_state()));
+				}
+			}
+		}
+		for (auto const& portfolio_id : portfolio_ids)
+		{
+			for (auto order : hydra->get_portfolio(portfolio_id).value()->order_history())
+			{
+				result.fills.emplace_back(
+					order->get_asset_index(), order->get_units(), order->get_fill_price(),
+					order->get_fill_time(), order->get_order_state()
+				);
+			}
+		}
+		result.nlv = *hydra->get_portfolio("master").value()->get_tracers().get_column(Tracer::NLV).value();
+		return result;
+	};
+	auto serial = run(false);
+	auto parallel = run(true);
+	EXPECT_FALSE(serial.fills.empty());
+	EXPECT_EQ(parallel.prices, serial.prices);
+	EXPECT_EQ(parallel.fills, serial.fills);
+	EXPECT_EQ(parallel.nlv, serial.nlv);
+	remove_exchange_source(source_a);
+	remove_exchange_source(source_b);
+}
+
+
+TEST(SparseExchangeTests, RunNMatchesStep) {
+	// the cost per step of both is measured by the step_loop and run_n cases of AgisCoreBench
+	auto source = write_sparse_exchange("agis_run_n_exchange", "asset", 20, 1000);
+	auto hydra = std::make_shared<Hydra>();
+	EXPECT_TRUE(hydra->create_exchange("sparse", dt_format, source).has_value());
+	EXPECT_TRUE(hydra->build().has_value());
+	auto steps = hydra->get_dt_index().size();
+
+	EXPECT_TRUE(hydra->reset().has_value());
+	for (size_t i = 0; i < steps; i++) EXPECT_TRUE(hydra->step().has_value());
+	auto step_global_time = hydra->get_exchanges().get_global_time();
+
+	EXPECT_TRUE(hydra->reset().has_value());
+	auto res = hydra->run_n(steps);
+	EXPECT_TRUE(res.has_value());
+	EXPECT_EQ(res.value(), steps);
+	EXPECT_EQ(hydra->get_exchanges().get_global_time(), step_global_time);
+	hydra.reset();
+	remove_exchange_source(source);
+}
+
+
+TEST(SyntheticExchangeTests, GeneratedExchange) {
+	MarketGeneratorConfig config;
+	config.asset_count = 50;
+	config.bar_count = 500;
+	config.process = PriceProcess::JUMP_DIFFUSION;
+	config.missing_probability = 0.05;
+	config.missing_length = 3;
+	config.listing_fraction = 0.2;
+	config.delisting_fraction = 0.2;
+	config.timestamp_jitter = 0.5;
+	auto source = generate_market(config);
+	EXPECT_TRUE(source.has_value());
+	EXPECT_EQ(source->assets.size(), 50);
+	EXPECT_EQ(generate_market(config)->assets[7].data, source->assets[7].data);
+
+	auto hydra = std::make_shared<Hydra>();
+	EXPECT_TRUE(hydra->create_exchange("synthetic", std::move(source.value())).has_value());
+	EXPECT_FALSE(hydra->create_exchange("synthetic", generate_market(config).value()).has_value());
+	EXPECT_TRUE(hydra->build().has_value());
+	auto exchange = hydra->get_exchange("synthetic").value();
+	EXPECT_EQ(exchange->get_assets().size(), 50);
+	EXPECT_EQ(exchange->get_assets().front()->get_id(), "SYN00");
+	auto const& dt_index = hydra->get_dt_index();
+	EXPECT_LE(dt_index.size(), 500);
+	EXPECT_TRUE(std::is_sorted(dt_index.begin(), dt_index.end()));
+	EXPECT_TRUE(hydra->run().has_value());
+	EXPECT_EQ(hydra->get_state(), HydraState::FINISHED);
+}
+
+
+TEST(SyntheticExchangeTests, GeneratedMarketScales) {
+	// generation and step cost across universe sizes are measured by the generate and run_empty
+	// cases of AgisCoreBench
+	for (size_t asset_count : { 10, 100 })
+	{
+		MarketGeneratorConfig config;
+		config.asset_count = asset_count;
+		config.bar_count = 252;
+		config.process = PriceProcess::FACTOR;
+		config.missing_probability = 0.02;
+		auto source = generate_market(config);
+		ASSERT_TRUE(source.has_value());
+
+		auto hydra = std::make_shared<Hydra>();
+		EXPECT_TRUE(hydra->create_exchange("synthetic", std::move(source.value())).has_value());
+		EXPECT_TRUE(hydra->build().has_value());
+		auto steps = hydra->get_dt_index().size();
+		EXPECT_EQ(steps, 252);
+		auto res = hydra->run_n(steps);
+		EXPECT_TRUE(res.has_value());
+		EXPECT_EQ(res.value(), steps);
+		EXPECT_EQ(hydra->get_state(), HydraState::FINISHED);
+	}
+
+	// an asset without rows has no last row to step against
+	auto source = generate_market(MarketGeneratorConfig{});
+	ASSERT_TRUE(source.has_value());
+	source->assets[3].dt_index.clear();
+	source->assets[3].data.clear();
+	auto hydra = std::make_shared<Hydra>();
+	EXPECT_FALSE(hydra->create_exchange("synthetic", std::move(source.value())).has_value());
+}
+
+
+TEST(SyntheticExchangeTests, RunStopFlag) {
+	MarketGeneratorConfig config;
+	config.asset_count = 5;
+	config.bar_count = 1000;
+	auto hydra = std::make_shared<Hydra>();
+	EXPECT_TRUE(hydra->create_exchange("synthetic", generate_market(config).value()).has_value());
+	EXPECT_TRUE(hydra->build().has_value());
+
+	// an interrupt issued while no run is in progress does not stop the next one
+	hydra->interupt();
+	auto res = hydra->run_n(300);
+	ASSERT_TRUE(res.has_value());
+	EXPECT_EQ(res.value(), 300);
+
+	// a caller's stop flag set before the call stops it at the first poll, and is left set
+	std::atomic<bool> stop = true;
+	res = hydra->run_n(500, stop);
+	ASSERT_TRUE(res.has_value());
+	EXPECT_EQ(res.value(), 64);
+	EXPECT_TRUE(stop.load());
+
+	stop.store(false);
+	res = hydra->run_n(100, stop);
+	ASSERT_TRUE(res.has_value());
+	EXPECT_EQ(res.value(), 100);
+}
+
+
+TEST(SyntheticExchangeTests, AsyncRun) {
+	MarketGeneratorConfig config;
+	config.asset_count = 20;
+	config.bar_count = 5000;
+	auto hydra = std::make_shared<Hydra>();
+	EXPECT_TRUE(hydra->create_exchange("synthetic", generate_market(config).value()).has_value());
+	EXPECT_TRUE(hydra->build().has_value());
+	auto steps = hydra->get_dt_index().size();
+
+	// hold the run inside its first report until it has been asked to pause
+	std::promise<void> reported;
+	std::promise<void> released;
+	auto release = released.get_future().share();
+	size_t reports = 0;
+	auto run = hydra->run_async([&](RunProgress const& progress) {
+		if (reports++ == 0)
+		{
+			reported.set_value();
+			release.wait();
+		}
+	}, 100);
+	reported.get_future().wait();
+	run->pause();
+	released.set_value();
+	while (run->status() != RunStatus::PAUSED) std::this_thread::yield();
+
+	// a paused run holds no lock and does not move
+	auto index = hydra->get_current_index();
+	EXPECT_EQ(run->progress().index, index);
+	EXPECT_EQ(run->progress().steps, 100);
+	EXPECT_TRUE(hydra->__aquire_read_lock().owns_lock());
+	std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	EXPECT_EQ(hydra->get_current_index(), index);
+
+	run->resume();
+	auto res = run->wait();
+	EXPECT_TRUE(res.has_value());
+	EXPECT_EQ(res.value(), steps);
+	EXPECT_EQ(run->status(), RunStatus::FINISHED);
+	EXPECT_EQ(run->progress().index, steps - 1);
+	EXPECT_GT(run->progress().steps_per_sec, 0.0);
+	EXPECT_EQ(reports, (steps + 99) / 100 + 1);
+	EXPECT_EQ(hydra->get_state(), HydraState::FINISHED);
+
+	// a cancelled run keeps its state and a new run picks up from it
+	EXPECT_TRUE(hydra->reset().has_value());
+	run = hydra->run_async([](RunProgress const&) {}, 64);
+	run->cancel();
+	res = run->wait();
+	EXPECT_TRUE(res.has_value());
+	EXPECT_EQ(run->status(), RunStatus::CANCELLED);
+	EXPECT_LE(res.value(), steps);
+	auto rest = hydra->run_n(steps);
+	EXPECT_EQ(res.value() + rest.value(), steps);
+}
+
+TEST(SyntheticExchangeTests, CrossSectionWindows) {
+	MarketGeneratorConfig config;
+	config.asset_count = 40;
+	config.bar_count = 300;
+	config.missing_probability = 0.05;
+	config.listing_fraction = 0.2;
+	auto hydra = std::make_shared<Hydra>();
+	EXPECT_TRUE(hydra->create_exchange("synthetic", generate_market(config).value()).has_value());
+	EXPECT_TRUE(hydra->build().has_value());
+	auto exchange = hydra->get_exchange_mut("synthetic").value();
+	EXPECT_FALSE(exchange->register_window("NOT_A_COLUMN", 10).has_value());
+	EXPECT_FALSE(exchange->register_window("CLOSE", 0).has_value());
+	auto slot = exchange->register_window("CLOSE", 20).value();
+	EXPECT_EQ(exchange->register_window("CLOSE", 20).value(), slot);
+	auto short_slot = exchange->register_window("CLOSE", 5).value();
+	EXPECT_NE(short_slot, slot);
+	auto engine = exchange->get_cross_section();
+	EXPECT_EQ(engine->window_count(), 2);
+
+	ExchangeNode exchange_node(exchange);
+	auto mean_node = exchange_node.create_asset_window_node(slot, RollingStat::MEAN).value();
+	EXPECT_EQ(mean_node->get_warmup(), 20);
+	EXPECT_FALSE(exchange_node.create_asset_window_node(2, RollingStat::MEAN).has_value());
+
+	// every window must match the statistic taken directly over the asset's own last rows
+	auto check = [&]() {
+		for (auto const& asset : exchange->get_assets())
+		{
+			auto streaming_index = asset->get_streaming_index();
+			if (!streaming_index) continue;
+			auto position = asset->get_index() - exchange->get_index_offset();
+			auto data = asset->get_data();
+			auto cols = asset->get_column_names().size();
+			auto rows = *streaming_index + 1;
+			for (auto [window_slot, lookback] : { std::pair{ slot, size_t(20) }, std::pair{ short_slot, size_t(5) } })
+			{
+				auto n = std::min(rows, lookback);
+				double sum = 0.0;
+				for (auto r = rows - n; r < rows; r++) sum += data[r * cols + asset->get_close_index()];
+				double mean = sum / n;
+				double sq = 0.0;
+				for (auto r = rows - n; r < rows; r++) sq += std::pow(data[r * cols + asset->get_close_index()] - mean, 2);
+				EXPECT_NEAR(engine->value(window_slot, position, RollingStat::SUM).value(), sum, 1e-6);
+				EXPECT_NEAR(engine->value(window_slot, position, RollingStat::MEAN).value(), mean, 1e-8);
+				if (n > 1) EXPECT_NEAR(engine->value(window_slot, position, RollingStat::VARIANCE).value(), sq / (n - 1), 1e-6);
+			}
+			EXPECT_NEAR(mean_node->evaluate(asset.get()).value(), engine->value(slot, position, RollingStat::MEAN).value(), 1e-12);
+		}
+	};
+	for (size_t i = 0; i < 150; i++)
+	{
+		hydra->step();
+		check();
+	}
+	// missing rows and late listings leave the assets on different rows
+	EXPECT_FALSE(engine->aligned());
+
+	// a snapshot restore rebuilds the windows from the rows already stepped over
+	auto snapshot = hydra->snapshot().value();
+	for (size_t i = 0; i < 50; i++) hydra->step();
+	EXPECT_TRUE(hydra->restore(*snapshot).has_value());
+	check();
+
+	EXPECT_TRUE(hydra->reset().has_value());
+	EXPECT_TRUE(engine->aligned());
+	EXPECT_FALSE(engine->value(slot, 0, RollingStat::SUM).has_value());
+	hydra->step();
+	check();
+}
+
+
+
+TEST(SyntheticExchangeTests, CrossSectionWindowsSkipNonFinite) {
+	// prices around 1e8 moving by about 0.1 leave almost nothing of a variance taken as a difference
+	// of raw sums of squares
+	MarketGeneratorConfig config;
+	config.asset_count = 6;
+	config.bar_count = 200;
+	config.start_price = 1e8;
+	config.drift = 0.0;
+	config.volatility = 1e-9;
+	auto source = generate_market(config);
+	ASSERT_TRUE(source.has_value());
+	auto cols = source->columns.size();
+	auto close_column = static_cast<size_t>(std::find(source->columns.begin(), source->columns.end(), "CLOSE") - source->columns.begin());
+	source->assets[2].data[30 * cols + close_column] = std::numeric_limits<double>::quiet_NaN();
+	source->assets[4].data[90 * cols + close_column] = std::numeric_limits<double>::infinity();
+
+	auto hydra = std::make_shared<Hydra>();
+	EXPECT_TRUE(hydra->create_exchange("synthetic", std::move(source.value())).has_value());
+	EXPECT_TRUE(hydra->build().has_value());
+	auto exchange = hydra->get_exchange_mut("synthetic").value();
+	size_t const lookback = 20;
+	auto slot = exchange->register_window("CLOSE", lookback).value();
+	auto engine = exchange->get_cross_section();
+	auto factory = [&](std::string type) {
+		return [=](Asset const& asset) -> UniquePtr<AssetObserver> {
+			std::vector<UniquePtr<AssetObserver>> inputs;
+			inputs.push_back(std::make_unique<AssetReadObserver>(asset, asset.get_close_index()));
+			return create_rolling_observer(type, asset, lookback, std::move(inputs)).value();
+		};
+	};
+	auto mean_hash = exchange->register_observer(factory("Mean")).value();
+	auto variance_hash = exchange->register_observer(factory("Variance")).value();
+
+	// the engine must agree with the per asset observers and with two passes over the last finite rows
+	auto check = [&]() {
+		for (auto const& asset : exchange->get_assets())
+		{
+			auto streaming_index = asset->get_streaming_index();
+			if (!streaming_index) continue;
+			auto position = asset->get_index() - exchange->get_index_offset();
+			auto data = asset->get_data();
+			std::vector<double> window;
+			for (auto r = *streaming_index + 1; r-- > 0 && window.size() < lookback;)
+			{
+				auto v = data[r * cols + asset->get_close_index()];
+				if (std::isfinite(v)) window.push_back(v);
+			}
+			ASSERT_FALSE(window.empty());
+			double mean = 0.0;
+			for (auto v : window) mean += v;
+			mean /= window.size();
+			double sq = 0.0;
+			for (auto v : window) sq += (v - mean) * (v - mean);
+			auto variance = window.size() > 1 ? sq / (window.size() - 1) : 0.0;
+
+			auto engine_mean = engine->value(slot, position, RollingStat::MEAN).value();
+			auto engine_variance = engine->value(slot, position, RollingStat::VARIANCE).value();
+			EXPECT_TRUE(std::isfinite(engine_mean));
+			EXPECT_NEAR(engine_mean, mean, 1e-6);
+			EXPECT_NEAR(engine_variance, variance, 1e-6 * (1.0 + variance));
+			EXPECT_NEAR(engine_mean, asset->get_observer(mean_hash).value()->value(), 1e-6);
+			EXPECT_NEAR(engine_variance, asset->get_observer(variance_hash).value()->value(), 1e-6 * (1.0 + variance));
+		}
+	};
+	for (size_t i = 0; i < 150; i++)
+	{
+		hydra->step();
+		check();
+	}
+	// the skipped values leave two assets a value behind the rest
+	EXPECT_FALSE(engine->aligned());
+
+	auto snapshot = hydra->snapshot().value();
+	for (size_t i = 0; i < 20; i++) hydra->step();
+	EXPECT_TRUE(hydra->restore(*snapshot).has_value());
+	check();
+}
+
+TEST(ArrayUtilsTests, KWaySortedUnion) {
+	std::vector<std::vector<long long>> inputs = {
+		{ 1, 4, 9 }, {}, { 2, 4, 6, 8 }, { 0, 9, 12 }, { 4 }
+	};
+	for (long long i = 0; i < 300; i++) inputs.push_back({ i % 17, i % 17 + 20, 40 + 3 * i });
+	std::vector<std::span<long long const>> spans(inputs.begin(), inputs.end());
+
+	std::vector<long long> expected;
+	for (auto const& input : inputs) expected = sorted_union(expected, input);
+
+	std::vector<long long> merged = { -1 };
+	sorted_union(spans, merged);
+	EXPECT_EQ(merged, expected);
+
+	std::vector<long long> parallel_merged;
+	parallel_sorted_union(spans, parallel_merged, 8);
+	EXPECT_EQ(parallel_merged, expected);
+}
+
+
+TEST_F(SimpleExchangeTests, ExchangeLive) {
+	EXPECT_TRUE(hydra->enable_live(exchange_id_1, 1024).has_value());
+	hydra->build();
+	hydra->reset();
+	auto& exchanges = hydra->get_exchanges();
+
+	// test1 ends at t4 so t5 is not complete until its next bar arrives or the exchange is sealed
+	for (size_t i = 0; i < 5; i++) EXPECT_TRUE(hydra->step().value());
+	EXPECT_EQ(exchanges.get_global_time(), t4);
+	EXPECT_FALSE(hydra->step().value());
+	EXPECT_TRUE(hydra->seal(exchange_id_1, t5).has_value());
+	EXPECT_TRUE(hydra->step().value());
+	EXPECT_EQ(exchanges.get_global_time(), t5);
+
+	std::vector<double> bar = { 104.0, 105.0 };
+	for (auto const& asset_id : { asset_id_1, asset_id_2, asset_id_3 })
+	{
+		EXPECT_TRUE(hydra->append_bar(exchange_id_1, asset_id, t6, bar).has_value());
+	}
+	EXPECT_FALSE(hydra->append_bar(exchange_id_1, asset_id_1, t5, bar).has_value());
+	EXPECT_TRUE(hydra->step().value());
+	EXPECT_EQ(exchanges.get_global_time(), t6);
+	EXPECT_EQ(exchanges.get_market_price(asset_id_2, true).value(), 105.0);
+	EXPECT_EQ(hydra->get_latency_stats().count, 1);
+
+	// the file tail feed appends complete lines and steps through the timestamps they complete
+	auto feed_path = (std::filesystem::temp_directory_path() / "agis_live_feed.csv").string();
+	{
+		std::ofstream feed_file(feed_path, std::ios::trunc);
+		feed_file << "exchange1,test1,2000-06-14,106,107\n";
+		feed_file << "exchange1,test2,2000-06-14,106,108\n";
+		feed_file << "exchange1,test3,2000-06-14,106,109";
+	}
+	FileTailFeed feed(*hydra, feed_path, dt_format);
+	EXPECT_EQ(feed.poll_and_step().value(), 2);
+	EXPECT_EQ(exchanges.get_global_time(), t6);
+	{
+		std::ofstream feed_file(feed_path, std::ios::app);
+		feed_file << "\n";
+	}
+	EXPECT_EQ(feed.poll_and_step().value(), 1);
+	EXPECT_EQ(exchanges.get_global_time(), t7);
+	EXPECT_EQ(exchanges.get_market_price(asset_id_3, true).value(), 109.0);
+	EXPECT_EQ(hydra->get_latency_stats().count, 2);
+}
+
+
 TEST_F(SimpleExchangeTests, ExchangeDtIndex) {
 	hydra->build();
 	auto& dt_index = hydra->get_dt_index();
@@ -178,6 +1016,63 @@ TEST_F(SimpleExchangeTests, TestRunTo) {
 
 }
 
+TEST_F(SimpleExchangeTests, TestRunUntil) {
+	hydra->build();
+	auto& exchanges = hydra->get_exchanges();
+
+	auto res = hydra->run_until(t2);
+	EXPECT_TRUE(res.has_value());
+	EXPECT_EQ(res.value(), 3);
+	EXPECT_EQ(exchanges.get_global_time(), t2);
+
+	res = hydra->run_n(2);
+	EXPECT_TRUE(res.has_value());
+	EXPECT_EQ(res.value(), 2);
+	EXPECT_EQ(exchanges.get_global_time(), t4);
+	EXPECT_EQ(exchanges.get_market_price(asset_id_1, true).value(), 106.0f);
+
+	res = hydra->run_n(100);
+	EXPECT_TRUE(res.has_value());
+	EXPECT_EQ(res.value(), 1);
+	EXPECT_EQ(hydra->get_state(), HydraState::FINISHED);
+
+	res = hydra->run_until(t5);
+	EXPECT_TRUE(res.has_value());
+	EXPECT_EQ(res.value(), 0);
+}
+
+TEST_F(SimpleExchangeTests, TestStepProfile) {
+	hydra->build();
+	hydra->set_profiling(true);
+	hydra->set_profile_trace(1, 3);
+	EXPECT_TRUE(hydra->run().has_value());
+
+	auto profile = hydra->get_profile();
+	EXPECT_EQ(profile.steps, 6);
+	EXPECT_EQ(profile.get(StepPhase::EXCHANGE_STEP).count, 6);
+	EXPECT_EQ(profile.get(StepPhase::EVALUATE).count, 6);
+	EXPECT_GT(profile.get(StepPhase::EXCHANGE_STEP).cycles, 0);
+	EXPECT_GT(profile.cycles_per_us, 0.0);
+	EXPECT_TRUE(profile.exchanges.contains(exchange_id_1));
+	EXPECT_EQ(profile.exchanges[exchange_id_1][static_cast<size_t>(StepPhase::EXCHANGE_STEP)].count, 6);
+
+	auto path = (std::filesystem::temp_directory_path() / "agis_step_trace.json").string();
+	EXPECT_TRUE(hydra->write_profile_trace(path).has_value());
+	std::ifstream file(path);
+	std::string json((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	file.close();
+	EXPECT_NE(json.find("\"exchange_step\""), std::string::npos);
+	EXPECT_NE(json.find("\"step\":2"), std::string::npos);
+	EXPECT_EQ(json.find("\"step\":3"), std::string::npos);
+	std::filesystem::remove(path);
+
+	// a disabled profiler records nothing
+	hydra->set_profiling(false);
+	hydra->reset();
+	EXPECT_TRUE(hydra->run().has_value());
+	EXPECT_EQ(hydra->get_profile().steps, 0);
+}
+
 TEST_F(SimpleExchangeTests, TestExchangeMapSerialize) {	// create rapid json doc and get the allocator
 	rapidjson::Document doc;
 	auto& allocator = doc.GetAllocator();
@@ -212,6 +1107,13 @@ std::function<UniquePtr<AssetObserver>(const Asset&)> createTsArgMaxObserverFact
 		};
 }
 
+template <typename T>
+std::function<UniquePtr<AssetObserver>(const Asset&)> createCloseWindowObserverFactory(size_t lookback) {
+	return [lookback](const Asset& asset) -> UniquePtr<AssetObserver> {
+		return std::make_unique<T>(asset, lookback, std::make_unique<AssetReadObserver>(asset, asset.get_close_index()));
+		};
+}
+
 TEST_F(SimpleExchangeTests, TestArgMaxObserve)
 {
 	hydra->build();
@@ -221,6 +1123,245 @@ TEST_F(SimpleExchangeTests, TestArgMaxObserve)
 	size_t observer_hash = res.value();
 }
 
+
+TEST(SyntheticExchangeTests, RollingExtremaObservers) {
+	// a series below zero used to report a maximum of 0 from the initial state
+	RollingExtremum negative(3);
+	for (double v : { -5.0, -3.0, -4.0, -6.0, -7.0 }) negative.push(v);
+	EXPECT_DOUBLE_EQ(negative.value(), -4.0);
+	EXPECT_DOUBLE_EQ(negative.age(), 2.0);
+
+	MarketGeneratorConfig config;
+	config.asset_count = 20;
+	config.bar_count = 400;
+	config.drift = -0.002;
+	config.missing_probability = 0.05;
+	auto hydra = std::make_shared<Hydra>();
+	EXPECT_TRUE(hydra->create_exchange("synthetic", generate_market(config).value()).has_value());
+	EXPECT_TRUE(hydra->build().has_value());
+	auto exchange = hydra->get_exchange_mut("synthetic").value();
+	size_t const lookback = 10;
+	auto max_hash = exchange->register_observer(createCloseWindowObserverFactory<TsMaxObserver>(lookback)).value();
+	auto min_hash = exchange->register_observer(createCloseWindowObserverFactory<TsMinObserver>(lookback)).value();
+	auto arg_max_hash = exchange->register_observer(createCloseWindowObserverFactory<TsArgMaxObserver>(lookback)).value();
+	auto arg_min_hash = exchange->register_observer(createCloseWindowObserverFactory<TsArgMinObserver>(lookback)).value();
+	EXPECT_NE(max_hash, min_hash);
+	EXPECT_NE(arg_max_hash, arg_min_hash);
+
+	// compare against a scan of the asset's last rows, ties go to the earliest row
+	for (size_t i = 0; i < 300; i++)
+	{
+		hydra->step();
+		for (auto const& asset : exchange->get_assets())
+		{
+			auto streaming_index = asset->get_streaming_index();
+			if (!streaming_index) continue;
+			auto data = asset->get_data();
+			auto cols = asset->get_column_names().size();
+			auto rows = *streaming_index + 1;
+			auto close = [&](size_t r) { return data[r * cols + asset->get_close_index()]; };
+			size_t arg_max = rows - std::min(rows, lookback);
+			size_t arg_min = arg_max;
+			for (auto r = arg_max; r < rows; r++)
+			{
+				if (close(r) > close(arg_max)) arg_max = r;
+				if (close(r) < close(arg_min)) arg_min = r;
+			}
+			EXPECT_DOUBLE_EQ(asset->get_observer(max_hash).value()->value(), close(arg_max));
+			EXPECT_DOUBLE_EQ(asset->get_observer(min_hash).value()->value(), close(arg_min));
+			EXPECT_DOUBLE_EQ(asset->get_observer(arg_max_hash).value()->value(), static_cast<double>(rows - 1 - arg_max));
+			EXPECT_DOUBLE_EQ(asset->get_observer(arg_min_hash).value()->value(), static_cast<double>(rows - 1 - arg_min));
+		}
+	}
+}
+
+
+TEST(SyntheticExchangeTests, RollingStatisticsObservers) {
+	MarketGeneratorConfig config;
+	config.asset_count = 10;
+	config.bar_count = 300;
+	config.start_price = 1e6;
+	config.missing_probability = 0.05;
+	auto hydra = std::make_shared<Hydra>();
+	EXPECT_TRUE(hydra->create_exchange("synthetic", generate_market(config).value()).has_value());
+	EXPECT_TRUE(hydra->build().has_value());
+	auto exchange = hydra->get_exchange_mut("synthetic").value();
+	size_t const lookback = 20;
+
+	// close is x and open is y for the pair observers
+	auto factory = [&](std::string type, bool pair) {
+		return [=](Asset const& asset) -> UniquePtr<AssetObserver> {
+			std::vector<UniquePtr<AssetObserver>> inputs;
+			inputs.push_back(std::make_unique<AssetReadObserver>(asset, asset.get_close_index()));
+			if (pair) inputs.push_back(std::make_unique<AssetReadObserver>(asset, asset.get_open_index()));
+			return create_rolling_observer(type, asset, lookback, std::move(inputs)).value();
+		};
+	};
+	auto asset_0 = exchange->get_asset(0).value();
+	EXPECT_FALSE(create_rolling_observer("Median", *asset_0, lookback, {}).has_value());
+	std::vector<UniquePtr<AssetObserver>> one_input;
+	one_input.push_back(std::make_unique<AssetReadObserver>(*asset_0, asset_0->get_close_index()));
+	EXPECT_FALSE(create_rolling_observer("Beta", *asset_0, lookback, std::move(one_input)).has_value());
+
+	std::unordered_map<std::string, size_t> hashes;
+	for (auto type : { "Sum", "Mean", "Variance", "StdDev", "ZScore", "Ema", "Slope" })
+	{
+		hashes[type] = exchange->register_observer(factory(type, false)).value();
+	}
+	for (auto type : { "Correlation", "Beta" })
+	{
+		hashes[type] = exchange->register_observer(factory(type, true)).value();
+	}
+	auto exchange_node = std::make_shared<ExchangeNode>(exchange);
+	AssetObserverNode zscore_node(hashes["ZScore"], exchange_node);
+	EXPECT_EQ(zscore_node.get_warmup(), lookback);
+
+	// compare against two pass statistics over the asset's own last rows
+	auto expect_close = [](double actual, double expected) {
+		EXPECT_NEAR(actual, expected, 1e-6 * (1.0 + std::abs(expected)));
+	};
+	for (size_t i = 0; i < 250; i++)
+	{
+		hydra->step();
+		for (auto const& asset : exchange->get_assets())
+		{
+			auto streaming_index = asset->get_streaming_index();
+			if (!streaming_index) continue;
+			auto data = asset->get_data();
+			auto cols = asset->get_column_names().size();
+			auto rows = *streaming_index + 1;
+			auto x = [&](size_t r) { return data[r * cols + asset->get_close_index()]; };
+			auto y = [&](size_t r) { return data[r * cols + asset->get_open_index()]; };
+			auto value = [&](std::string const& type) { return asset->get_observer(hashes[type]).value()->value(); };
+
+			auto n = std::min(rows, lookback);
+			auto first = rows - n;
+			double sum = 0.0, sum_y = 0.0, sum_r = 0.0;
+			for (auto r = first; r < rows; r++)
+			{
+				sum += x(r);
+				sum_y += y(r);
+				sum_r += r;
+			}
+			double mean = sum / n, mean_y = sum_y / n, mean_r = sum_r / n;
+			double var = 0.0, var_y = 0.0, var_r = 0.0, cov = 0.0, cov_r = 0.0;
+			for (auto r = first; r < rows; r++)
+			{
+				var += (x(r) - mean) * (x(r) - mean);
+				var_y += (y(r) - mean_y) * (y(r) - mean_y);
+				var_r += (r - mean_r) * (r - mean_r);
+				cov += (x(r) - mean) * (y(r) - mean_y);
+				cov_r += (r - mean_r) * (x(r) - mean);
+			}
+			double ema = x(0);
+			for (size_t r = 1; r < rows; r++) ema += 2.0 / (lookback + 1.0) * (x(r) - ema);
+
+			expect_close(value("Sum"), sum);
+			expect_close(value("Mean"), mean);
+			expect_close(value("Ema"), ema);
+			if (n < 2) continue;
+			expect_close(value("Variance"), var / (n - 1));
+			expect_close(value("StdDev"), std::sqrt(var / (n - 1)));
+			expect_close(value("ZScore"), (x(rows - 1) - mean) / std::sqrt(var / (n - 1)));
+			expect_close(value("Correlation"), cov / std::sqrt(var * var_y));
+			expect_close(value("Beta"), cov / var_y);
+			expect_close(value("Slope"), cov_r / var_r);
+			EXPECT_DOUBLE_EQ(zscore_node.evaluate(asset.get()).value(), value("ZScore"));
+		}
+	}
+}
+
+
+TEST(SyntheticExchangeTests, PrecomputedObservers) {
+	MarketGeneratorConfig config;
+	config.asset_count = 20;
+	config.bar_count = 300;
+	config.missing_probability = 0.05;
+	config.listing_fraction = 0.2;
+	auto hydra = std::make_shared<Hydra>();
+	EXPECT_TRUE(hydra->create_exchange("synthetic", generate_market(config).value()).has_value());
+	EXPECT_TRUE(hydra->build().has_value());
+	auto exchange = hydra->get_exchange_mut("synthetic").value();
+	std::vector<size_t> hashes = {
+		exchange->register_observer(createCloseWindowObserverFactory<ZScoreObserver>(20)).value(),
+		exchange->register_observer(createCloseWindowObserverFactory<EmaObserver>(10)).value(),
+		exchange->register_observer(createCloseWindowObserverFactory<TsArgMinObserver>(15)).value()
+	};
+	auto exchange_node = std::make_shared<ExchangeNode>(exchange);
+	AssetObserverNode zscore_node(hashes[0], exchange_node);
+
+	// record the incremental values of every observer on every step
+	auto steps = hydra->get_dt_index().size();
+	auto record = [&]() {
+		std::vector<std::optional<double>> values;
+		for (size_t i = 0; i < steps; i++)
+		{
+			EXPECT_TRUE(hydra->step().has_value());
+			for (auto const& asset : exchange->get_assets())
+			{
+				if (!asset->is_streaming()) continue;
+				for (auto hash : hashes) values.push_back(asset->get_observer_value(hash));
+				values.push_back(zscore_node.evaluate(asset.get()));
+			}
+		}
+		return values;
+	};
+	auto incremental = record();
+	EXPECT_FALSE(exchange->precompute_observers().has_value());
+
+	EXPECT_TRUE(hydra->reset().has_value());
+	EXPECT_EQ(exchange->precompute_observers(true).value(), exchange->get_assets().size());
+	EXPECT_TRUE(exchange->get_assets().front()->observers_precomputed());
+	auto validated = record();
+	EXPECT_EQ(validated, incremental);
+	EXPECT_EQ(exchange->feature_mismatches(), 0);
+
+	EXPECT_TRUE(hydra->reset().has_value());
+	EXPECT_EQ(exchange->precompute_observers().value(), exchange->get_assets().size());
+	EXPECT_EQ(record(), incremental);
+
+	// a new observer puts the assets back on the incremental path
+	EXPECT_TRUE(hydra->reset().has_value());
+	exchange->register_observer(createCloseWindowObserverFactory<MeanObserver>(5));
+	EXPECT_FALSE(exchange->get_assets().front()->observers_precomputed());
+	EXPECT_EQ(record(), incremental);
+}
+
+
+TEST_F(SimpleExchangeTests, TestObserverGraph)
+{
+	hydra->build();
+	auto exchange = hydra->get_exchange_mut(exchange_id_1).value();
+	auto read_close = [](Asset const& asset) { return std::make_unique<AssetReadObserver>(asset, asset.get_close_index()); };
+	auto ts_max = [&](Asset const& asset) -> UniquePtr<AssetObserver> {
+		return std::make_unique<TsMaxObserver>(asset, 2, read_close(asset));
+	};
+	auto sum = [&](Asset const& asset) -> UniquePtr<AssetObserver> {
+		return std::make_unique<SumObserver>(asset, 2, read_close(asset));
+	};
+
+	// two strategies asking for the same rolling max share one read and one max node
+	auto max_hash = exchange->register_observer(ts_max).value();
+	EXPECT_EQ(exchange->register_observer(ts_max).value(), max_hash);
+	auto asset = exchange->get_asset(asset_id_2).value();
+	EXPECT_EQ(asset->observer_count(), 2);
+	auto sum_hash = exchange->register_observer(sum).value();
+	EXPECT_NE(sum_hash, max_hash);
+	EXPECT_EQ(asset->observer_count(), 3);
+	exchange->register_observer(createTsArgMaxObserverFactory(2));
+	EXPECT_EQ(asset->observer_count(), 4);
+
+	// inputs are stepped ahead of their readers so the window sums the current close
+	hydra->step();
+	hydra->step();
+	hydra->step();
+	auto close_index = asset->get_close_index();
+	auto current = asset->get_asset_feature(close_index, 0);
+	auto previous = asset->get_asset_feature(close_index, -1);
+	EXPECT_TRUE(current.has_value() && previous.has_value());
+	EXPECT_DOUBLE_EQ(asset->get_observer(sum_hash).value()->value(), *current + *previous);
+}
+
 TEST_F(SimpleExchangeTests, TestExchangeViewNode) {
 	hydra->build();
 	auto res = exchange_view_node->evaluate();
@@ -296,8 +1437,16 @@ TEST_F(SimpleExchangeTests, TestCovarianceMatrix)
 {
 	hydra->build();
 	auto exchange = hydra->get_exchange_mut(exchange_id_1).value();
+	auto asset = exchange->get_asset(asset_index_3).value();
+	auto observer_count = asset->observer_count();
+
+	// a second call replaces the observers of the first, whatever their lookback
+	EXPECT_TRUE(exchange->init_covariance_matrix(5, 1).has_value());
+	auto covariance_count = asset->observer_count();
+	EXPECT_GT(covariance_count, observer_count);
 	auto res = exchange->init_covariance_matrix(3, 1);
 	EXPECT_TRUE(res.has_value());
+	EXPECT_EQ(asset->observer_count(), covariance_count);
 	hydra->step();
 	EXPECT_FALSE(exchange->get_covariance(asset_index_2, asset_index_3).has_value());
 	hydra->step();
@@ -5,8 +5,13 @@ import ExchangeMapModule;
 import ExchangeModule;
 import PortfolioModule;
 import StrategyModule;
+import OrderModule;
 import PositionModule;
 import TradeModule;
+import HydraSweepModule;
+import HydraSnapshotModule;
+import AgisStepPool;
+import StrategyTracerModule;
 
 using namespace Agis;
 
@@ -28,12 +33,12 @@ namespace AgisPortfolioTest {
 	double cash1 = 1000.0f;
 	double cash2 = 2000.0f;
 
-	constexpr long long t0 = 960181200000000000;
-	constexpr long long t1 = 960267600000000000;
-	constexpr long long t2 = 960354000000000000;
-	constexpr long long t3 = 960440400000000000;
-	constexpr long long t4 = 960526800000000000;
-	constexpr long long t5 = 960786000000000000;
+	constexpr long long t0 = 960163200000000000;
+	constexpr long long t1 = 960249600000000000;
+	constexpr long long t2 = 960336000000000000;
+	constexpr long long t3 = 960422400000000000;
+	constexpr long long t4 = 960508800000000000;
+	constexpr long long t5 = 960768000000000000;
 };
 
 using namespace AgisPortfolioTest;
@@ -58,6 +63,54 @@ public:
 };
 
 
+class SweepStrategy : public Strategy {
+public:
+	SweepStrategy(
+		std::string strategy_id,
+		double cash,
+		Exchange const& exchange,
+		Portfolio& portfolio,
+		double units
+	) : Strategy(strategy_id, cash, exchange, portfolio), _units(units) {}
+
+	std::expected<bool, AgisException> step() noexcept override {
+		if (!_placed && _units != 0.0) {
+			Strategy::place_market_order(this->get_asset_index(asset_id_2).value(), _units);
+		}
+		_placed = true;
+		return true;
+	}
+
+private:
+	double _units;
+	bool _placed = false;
+};
+
+
+class SnapshotStrategy : public Strategy {
+public:
+	SnapshotStrategy(
+		std::string strategy_id,
+		double cash,
+		Exchange const& exchange,
+		Portfolio& portfolio,
+		double units
+	) : Strategy(strategy_id, cash, exchange, portfolio), _units(units) {}
+
+	// decisions depend only on the strategy's trades so a restored strategy makes the same ones
+	std::expected<bool, AgisException> step() noexcept override {
+		for (auto const& asset_id : { asset_id_1, asset_id_2 }) {
+			auto index = this->get_asset_index(asset_id).value();
+			if (!this->get_trade(index)) Strategy::place_market_order(index, _units);
+		}
+		return true;
+	}
+
+private:
+	double _units;
+};
+
+
 class PortfolioTest : public ::testing::Test
 {
 protected:
@@ -397,3 +450,199 @@ TEST_F(PortfolioTest, OrderClose) {
 	hydra->step();
 }
 
+
+TEST(HydraSweepTest, SweepMatchesSingleRuns) {
+	auto setup = [](Hydra& hydra, size_t run_index) -> std::expected<bool, AgisException> {
+		auto portfolio = hydra.create_portfolio(portfolio_id_1, exchange_id_1);
+		if (!portfolio) return std::unexpected(portfolio.error());
+		auto exchange = hydra.get_exchange(exchange_id_1).value();
+		auto strategy = std::make_unique<SweepStrategy>(
+			strategy_id_1, cash1, *exchange, *portfolio.value(), static_cast<double>(run_index)
+		);
+		return hydra.register_strategy(std::move(strategy));
+	};
+
+	auto base = std::make_shared<Hydra>();
+	EXPECT_TRUE(base->create_exchange(exchange_id_1, dt_format, exchange1_path).has_value());
+	EXPECT_TRUE(base->build().has_value());
+	HydraSweep sweep(*base, 2);
+	auto table = sweep.run(4, setup);
+	ASSERT_TRUE(table.has_value());
+	EXPECT_EQ(table->dt_index, base->get_dt_index());
+	EXPECT_EQ(table->runs.size(), 4);
+
+	// every forked run matches the same setup run on its own freshly loaded Hydra
+	for (size_t i = 0; i < table->runs.size(); i++)
+	{
+		auto const& run = table->runs[i];
+		EXPECT_EQ(run.run_index, i);
+		EXPECT_FALSE(run.error.has_value());
+		auto single = std::make_shared<Hydra>();
+		EXPECT_TRUE(single->create_exchange(exchange_id_1, dt_format, exchange1_path).has_value());
+		EXPECT_TRUE(setup(*single, i).has_value());
+		EXPECT_TRUE(single->run().has_value());
+		auto master = single->get_portfolio("master").value();
+		EXPECT_EQ(run.nlv_history, *master->get_tracers().get_column(Tracer::NLV).value());
+		EXPECT_DOUBLE_EQ(run.final_nlv, master->get_nlv());
+	}
+	EXPECT_DOUBLE_EQ(table->runs[0].total_return, 0.0);
+	EXPECT_DOUBLE_EQ(table->runs[0].max_drawdown, 0.0);
+}
+
+
+
+TEST(HydraSweepTest, SetupExceptionIsRecorded) {
+	auto setup = [](Hydra& hydra, size_t run_index) -> std::expected<bool, AgisException> {
+		if (run_index == 1) throw std::runtime_error("bad parameters");
+		auto portfolio = hydra.create_portfolio(portfolio_id_1, exchange_id_1);
+		if (!portfolio) return std::unexpected(portfolio.error());
+		auto exchange = hydra.get_exchange(exchange_id_1).value();
+		auto strategy = std::make_unique<SweepStrategy>(
+			strategy_id_1, cash1, *exchange, *portfolio.value(), static_cast<double>(run_index)
+		);
+		return hydra.register_strategy(std::move(strategy));
+	};
+
+	auto base = std::make_shared<Hydra>();
+	EXPECT_TRUE(base->create_exchange(exchange_id_1, dt_format, exchange1_path).has_value());
+	EXPECT_TRUE(base->build().has_value());
+	HydraSweep sweep(*base, 2);
+	auto table = sweep.run(3, setup);
+	ASSERT_TRUE(table.has_value());
+
+	// the throwing run fails on its own, the rest of the sweep completes
+	ASSERT_TRUE(table->runs[1].error.has_value());
+	EXPECT_NE(std::string(table->runs[1].error->what()).find("bad parameters"), std::string::npos);
+	EXPECT_FALSE(table->runs[0].error.has_value());
+	EXPECT_FALSE(table->runs[2].error.has_value());
+	EXPECT_FALSE(table->runs[2].nlv_history.empty());
+}
+
+TEST(HydraSnapshotTest, RestoreMatchesUninterruptedRun) {
+	auto setup = [](Hydra& hydra, size_t run_index) -> std::expected<bool, AgisException> {
+		auto portfolio = hydra.create_portfolio(portfolio_id_1, exchange_id_1);
+		if (!portfolio) return std::unexpected(portfolio.error());
+		portfolio.value()->set_tracer(Tracer::ORDERS);
+		auto exchange = hydra.get_exchange(exchange_id_1).value();
+		auto strategy = std::make_unique<SnapshotStrategy>(
+			strategy_id_1, cash1, *exchange, *portfolio.value(), 10.0
+		);
+		return hydra.register_strategy(std::move(strategy));
+	};
+	// value copies of the histories, restored histories hold new objects
+	using OrderRecord = std::tuple<size_t, double, double, long long, OrderState, bool>;
+	using TradeRecord = std::tuple<size_t, double, double, double, long long, long long, double>;
+	auto order_records = [](Portfolio const* portfolio) {
+		std::vector<OrderRecord> records;
+		for (auto order : portfolio->order_history())
+		{
+			records.emplace_back(
+				order->get_asset_index(), order->get_units(), order->get_fill_price(),
+				order->get_fill_time(), order->get_order_state(), order->is_force_close()
+			);
+		}
+		return records;
+	};
+	auto trade_records = [](Portfolio const* portfolio) {
+		std::vector<TradeRecord> records;
+		for (auto trade : portfolio->trade_history())
+		{
+			records.emplace_back(
+				trade->get_asset_index(), trade->get_units(), trade->get_open_price(), trade->get_close_price(),
+				trade->get_open_time(), trade->get_close_time(), trade->get_realized_pnl()
+			);
+		}
+		return records;
+	};
+
+	auto hydra = std::make_shared<Hydra>();
+	EXPECT_TRUE(hydra->create_exchange(exchange_id_1, dt_format, exchange1_path).has_value());
+	EXPECT_TRUE(setup(*hydra, 0).has_value());
+	EXPECT_TRUE(hydra->build().has_value());
+	EXPECT_TRUE(hydra->step().has_value());
+
+	// test1 has no bar at t0 so its order is still resting on the exchange
+	auto snapshot = hydra->snapshot();
+	ASSERT_TRUE(snapshot.has_value());
+	EXPECT_EQ((*snapshot)->current_index, 1);
+	EXPECT_EQ((*snapshot)->open_orders.size(), 1);
+	EXPECT_TRUE(hydra->run().has_value());
+	auto master = hydra->get_portfolio("master").value();
+	auto portfolio = hydra->get_portfolio(portfolio_id_1).value();
+	auto full_history = *master->get_tracers().get_column(Tracer::NLV).value();
+	auto full_nlv = master->get_nlv();
+	auto full_orders = order_records(portfolio);
+	auto full_trades = trade_records(portfolio);
+	EXPECT_FALSE(full_orders.empty());
+
+	// restoring into the same Hydra and running on reproduces the uninterrupted run
+	EXPECT_TRUE(hydra->restore(**snapshot).has_value());
+	EXPECT_EQ(hydra->get_global_time(), t0);
+	EXPECT_EQ(master->get_tracers().get_current_index(), 1);
+	EXPECT_TRUE(hydra->run().has_value());
+	EXPECT_EQ(*master->get_tracers().get_column(Tracer::NLV).value(), full_history);
+	EXPECT_DOUBLE_EQ(master->get_nlv(), full_nlv);
+
+	// the histories from before the snapshot survive the restore
+	EXPECT_EQ(order_records(portfolio), full_orders);
+	EXPECT_EQ(trade_records(portfolio), full_trades);
+
+	// forks given the same setup continue from the snapshot to the same result
+	HydraSweep sweep(*hydra, 2);
+	auto table = sweep.run(2, setup, *snapshot);
+	ASSERT_TRUE(table.has_value());
+	for (auto const& run : table->runs)
+	{
+		EXPECT_FALSE(run.error.has_value());
+		EXPECT_EQ(run.nlv_history, full_history);
+	}
+}
+
+
+TEST(StepPoolTest, RunCoversRangeOnce) {
+	StepPool pool(4);
+	EXPECT_EQ(pool.size(), 4);
+	std::vector<int> hits(101, 0);
+	for (size_t n = 0; n <= hits.size(); n++)
+	{
+		pool.run(n, [&hits](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) hits[i]++;
+		});
+	}
+	// item i is covered by every run of size n > i
+	for (size_t i = 0; i < hits.size(); i++)
+	{
+		EXPECT_EQ(hits[i], hits.size() - i);
+	}
+}
+
+
+TEST(HydraStepPoolTest, WorkersMatchTaskGroup) {
+	auto make_hydra = []() {
+		auto hydra = std::make_shared<Hydra>();
+		EXPECT_TRUE(hydra->create_exchange(exchange_id_1, dt_format, exchange1_path).has_value());
+		auto exchange = hydra->get_exchange(exchange_id_1).value();
+		for (auto const& [portfolio_id, strategy_id] : { std::pair{portfolio_id_1, strategy_id_1}, std::pair{portfolio_id_2, strategy_id_2} })
+		{
+			auto portfolio = hydra->create_portfolio(portfolio_id, exchange_id_1);
+			EXPECT_TRUE(portfolio.has_value());
+			auto strategy = std::make_unique<SnapshotStrategy>(strategy_id, cash1, *exchange, *portfolio.value(), 5.0);
+			EXPECT_TRUE(hydra->register_strategy(std::move(strategy)).has_value());
+		}
+		return hydra;
+	};
+
+	auto tasks = make_hydra();
+	EXPECT_TRUE(tasks->run().has_value());
+	auto workers = make_hydra();
+	workers->set_step_workers(3);
+	EXPECT_TRUE(workers->run().has_value());
+
+	auto tasks_master = tasks->get_portfolio("master").value();
+	auto workers_master = workers->get_portfolio("master").value();
+	EXPECT_EQ(
+		*workers_master->get_tracers().get_column(Tracer::NLV).value(),
+		*tasks_master->get_tracers().get_column(Tracer::NLV).value()
+	);
+	EXPECT_DOUBLE_EQ(workers_master->get_nlv(), tasks_master->get_nlv());
+}
@@ -22,6 +22,7 @@ namespace AST
 		AssetOpp,
 		AssetLogical,
 		AssetObserver,
+		AssetWindow,
 		Exchange,
 		ExchangeView,
 		ExchangeViewSort,
@@ -50,6 +51,7 @@ namespace AST
 
 	class AssetLambdaNode;
 	class AssetLambdaReadNode;
+	class AssetWindowNode;
 
 	class ExchangeNode;
 	class ExchangeViewNode;
@@ -0,0 +1,223 @@
+module;
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include "AgisDeclare.h"
+
+export module AssetCacheModule;
+
+import <string>;
+import <string_view>;
+import <vector>;
+import <filesystem>;
+import <algorithm>;
+import <system_error>;
+import <mutex>;
+import <unordered_map>;
+import <memory>;
+
+import AgisMemoryMap;
+
+export namespace Agis
+{
+
+//============================================================================
+/// <summary>
+/// On disk layout of the binary exchange cache. The file is a header, a table of
+/// per asset entries, a block of '\0' terminated strings (column names then asset ids)
+/// followed by the dt index and row major data block of each asset. Every block starts on
+/// an ASSET_CACHE_ALIGNMENT boundary so the cache can be mapped and read in place.
+/// </summary>
+constexpr char ASSET_CACHE_MAGIC[8] = { 'A', 'G', 'I', 'S', 'C', 'A', 'C', 'H' };
+constexpr uint32_t ASSET_CACHE_VERSION = 1;
+constexpr size_t ASSET_CACHE_ALIGNMENT = 64;
+constexpr std::string_view ASSET_CACHE_EXTENSION = ".agiscache";
+
+
+//============================================================================
+struct AssetCacheHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t asset_count;
+	uint64_t fingerprint;
+	uint64_t column_count;
+	uint64_t entries_offset;
+	uint64_t strings_offset;
+	uint64_t strings_length;
+	uint64_t file_size;
+};
+
+
+//============================================================================
+struct AssetCacheEntry
+{
+	uint64_t rows;
+	uint64_t cols;
+	uint64_t open_index;
+	uint64_t close_index;
+	uint64_t id_offset;
+	uint64_t id_length;
+	uint64_t dt_offset;
+	uint64_t data_offset;
+};
+
+
+//============================================================================
+constexpr size_t
+asset_cache_align(size_t offset) noexcept
+{
+	return (offset + ASSET_CACHE_ALIGNMENT - 1) & ~(ASSET_CACHE_ALIGNMENT - 1);
+}
+
+
+//============================================================================
+/// <summary>
+/// True if count items of width bytes starting at offset lie inside a block of size bytes. The
+/// values come from a file that may be corrupt, so neither the product nor the sum may wrap.
+/// </summary>
+constexpr bool
+asset_cache_range_fits(uint64_t offset, uint64_t count, uint64_t width, uint64_t size) noexcept
+{
+	if (offset > size) return false;
+	if (width && count > (size - offset) / width) return false;
+	return true;
+}
+
+
+//============================================================================
+/// <summary>
+/// Location of the cache for an exchange source, a sibling of the source folder or file.
+/// Exchanges loaded with a symbol filter get their own cache keyed by a hash of the symbols
+/// so differently filtered loads of one source do not keep overwriting each other.
+/// </summary>
+std::string
+asset_cache_path(std::string const& source, std::vector<std::string> const& symbols = {}) noexcept
+{
+	auto path = std::filesystem::path(source);
+	if (!path.has_filename()) path = path.parent_path();
+	auto cache_path = path.string();
+	if (!symbols.empty())
+	{
+		uint64_t hash = 14695981039346656037ull;
+		for (auto const& symbol : symbols)
+		{
+			// hash the '\0' terminator as well so {"ab", "c"} and {"a", "bc"} differ
+			for (unsigned char c : std::string_view(symbol.c_str(), symbol.size() + 1))
+			{
+				hash ^= c;
+				hash *= 1099511628211ull;
+			}
+		}
+		char suffix[18];
+		std::snprintf(suffix, sizeof(suffix), ".%016llx", static_cast<unsigned long long>(hash));
+		cache_path += suffix;
+	}
+	return cache_path + std::string(ASSET_CACHE_EXTENSION);
+}
+
+
+//============================================================================
+/// <summary>
+/// FNV-1a hash of everything that determines the contents of an exchange: the name, size and
+/// last write time of every source file plus the symbol filter and datetime format. Any change
+/// to the source on disk yields a new fingerprint and invalidates the cache.
+/// </summary>
+uint64_t
+asset_cache_fingerprint(
+	std::string const& source,
+	std::vector<std::string> const& symbols,
+	std::string const& dt_format) noexcept
+{
+	uint64_t hash = 14695981039346656037ull;
+	auto mix = [&hash](void const* data, size_t n) {
+		auto bytes = static_cast<unsigned char const*>(data);
+		for (size_t i = 0; i < n; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+	};
+	auto mix_string = [&mix](std::string const& s) {
+		mix(s.data(), s.size());
+		mix("\0", 1);
+	};
+	auto mix_file = [&mix, &mix_string](std::filesystem::path const& path) {
+		std::error_code ec;
+		mix_string(path.filename().string());
+		uint64_t size = std::filesystem::file_size(path, ec);
+		if (ec) size = 0;
+		auto mtime = std::filesystem::last_write_time(path, ec);
+		long long ticks = ec ? 0 : static_cast<long long>(mtime.time_since_epoch().count());
+		mix(&size, sizeof(size));
+		mix(&ticks, sizeof(ticks));
+	};
+
+	uint32_t version = ASSET_CACHE_VERSION;
+	mix(&version, sizeof(version));
+	mix_string(dt_format);
+	for (auto const& symbol : symbols) mix_string(symbol);
+
+	std::error_code ec;
+	if (std::filesystem::is_directory(source, ec))
+	{
+		std::vector<std::filesystem::path> paths;
+		for (auto const& entry : std::filesystem::directory_iterator(source, ec))
+		{
+			if (entry.is_regular_file(ec)) paths.push_back(entry.path());
+		}
+		std::sort(paths.begin(), paths.end());
+		for (auto const& path : paths) mix_file(path);
+	}
+	else
+	{
+		mix_file(std::filesystem::path(source));
+	}
+	return hash;
+}
+
+
+//============================================================================
+/// <summary>
+/// Process wide registry of live cache mappings keyed by path and fingerprint. Every exchange
+/// of every Hydra instance that loads the same source binds its assets to a single read only
+/// mapping, and because the mapping is file backed the OS shares its pages with any other
+/// process mapping the same cache. Entries are weak so a mapping is released with its last asset.
+/// </summary>
+class AssetCacheRegistry
+{
+public:
+	static SharedPtr<MemoryMappedFile> find(std::string const& path, uint64_t fingerprint) noexcept
+	{
+		auto lock = std::lock_guard(mutex());
+		auto it = entries().find(key(path, fingerprint));
+		if (it == entries().end()) return nullptr;
+		auto mapping = it->second.lock();
+		if (!mapping) entries().erase(it);
+		return mapping;
+	}
+
+	static void insert(std::string const& path, uint64_t fingerprint, SharedPtr<MemoryMappedFile> const& mapping) noexcept
+	{
+		auto lock = std::lock_guard(mutex());
+		entries()[key(path, fingerprint)] = mapping;
+	}
+
+private:
+	static std::string key(std::string const& path, uint64_t fingerprint)
+	{
+		return path + '\0' + std::to_string(fingerprint);
+	}
+	static std::mutex& mutex() noexcept
+	{
+		static std::mutex m;
+		return m;
+	}
+	static std::unordered_map<std::string, std::weak_ptr<MemoryMappedFile>>& entries() noexcept
+	{
+		static std::unordered_map<std::string, std::weak_ptr<MemoryMappedFile>> e;
+		return e;
+	}
+};
+
+}
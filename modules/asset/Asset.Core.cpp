@@ -1,6 +1,7 @@
 module;
 
 #include "AgisMacros.h"
+#include <cmath>
 
 #define READ_LOCK std::shared_lock<std::shared_mutex> lock(_mutex);
 #define WRITE_LOCK std::unique_lock<std::shared_mutex> lock(_mutex);
@@ -8,9 +9,12 @@ module;
 module AssetModule;
 
 import <optional>;
+import <utility>;
 
 import AssetPrivateModule;
+import AgisAlignment;
 import AgisFileUtils;
+import AgisProfiler;
 
 namespace Agis
 {
@@ -20,7 +24,9 @@ namespace Agis
 Asset::Asset(AssetPrivate* asset, std::string asset_id, size_t asset_index)
 {
 	_p = asset;
-	_p->_data_ptr = _p->_data.data();
+	// forked assets arrive with views into the storage of the asset they were forked from
+	if (!_p->_mapping && _p->_dt_view.empty()) _p->bind_owned_storage();
+	_p->_data_ptr = _p->_data_view.data();
 	_asset_id = asset_id;
 	_asset_index = asset_index;
 }
@@ -28,7 +34,7 @@ Asset::Asset(AssetPrivate* asset, std::string asset_id, size_t asset_index)
 
 
 //============================================================================
-double*
+double const*
 Asset::get_data_ptr() const noexcept
 {
 	return _p->_data_ptr;
@@ -36,14 +42,14 @@ Asset::get_data_ptr() const noexcept
 
 
 //============================================================================
-StridedPointer<double const>
+StridedColumn
 Asset::get_close_span() const noexcept
 {
-	return StridedPointer<double const>(
-		_p->_data.data() + _p->_close_index,
-		_p->_rows,
-		_p->_cols
-	);
+	if (_p->_precision == StoragePrecision::FLOAT32)
+	{
+		return StridedColumn(_p->_data32_view.data() + _p->_close_index, _p->_rows, _p->_cols);
+	}
+	return StridedColumn(_p->_data_view.data() + _p->_close_index, _p->_rows, _p->_cols);
 }
 
 
@@ -52,19 +58,16 @@ void
 Asset::reset() noexcept
 {
 	_p->_current_index = 0;
-	_p->_data_ptr = _p->_data.data();
+	_p->_data_ptr = _p->_data_view.data();
+	if (_p->_data32_ptr) _p->_data32_ptr = _p->_data32_view.data();
 	_state = AssetState::PENDING;
-	if (!_p->observers.size()) return;
-	for (auto& [id, observer] : _p->observers)
-	{
-		observer->on_reset();
-	}
+	_p->observers.reset();
 }
 
 
 //============================================================================
 AssetState
-Asset::step(long long global_time) noexcept
+Asset::step(long long global_time, size_t exchange_index) noexcept
 {
 	// if the asset is expired, return the state and do nothing
 	if (_state == AssetState::LAST)
@@ -73,25 +76,38 @@ Asset::step(long long global_time) noexcept
 		return _state;
 	}
 
+	// a live asset never expires, it is disabled until its next bar arrives
+	if (_p->_live_dt)
+	{
+		if (_p->_current_index >= _p->_dt_view.size())
+		{
+			if (_state == AssetState::STREAMING) _state = AssetState::DISABLED;
+			return _state;
+		}
+	}
 	// check if last step to force close open positions
-	if (_p->_current_index == _p->_dt_index.size() - 1)
+	else if (_p->_current_index == _p->_dt_view.size() - 1)
 	{
 		_state = AssetState::LAST;
 		advance();
 		return _state;
 	}
-	auto asset_time = _p->_dt_index[_p->_current_index];
+	// aligned assets look up whether they have a row at this exchange index, live assets
+	// whose exchange index is still growing compare timestamps
+	bool has_row = _p->_alignment.empty() ?
+		_p->_dt_view[_p->_current_index] == global_time :
+		_p->_alignment.contains(exchange_index);
 	switch (_state)
 	{
 		case AssetState::PENDING:
-			if (asset_time == global_time)
+			if (has_row)
 			{
 				_state = AssetState::STREAMING;
 				advance();
 			}
 			break;
 		case AssetState::STREAMING:
-			if (asset_time != global_time)
+			if (!has_row)
 			{
 				_state = AssetState::DISABLED;
 			}
@@ -101,7 +117,7 @@ Asset::step(long long global_time) noexcept
 			}
 			break;
 		case AssetState::DISABLED:
-			if (asset_time == global_time)
+			if (has_row)
 			{
 				_state = AssetState::STREAMING;
 				advance();
@@ -118,13 +134,104 @@ Asset::step(long long global_time) noexcept
 void
 Asset::advance() noexcept
 {
-	_p->_data_ptr += _p->_cols;
+	if (_p->_data32_ptr) _p->_data32_ptr += _p->_cols;
+	else _p->_data_ptr += _p->_cols;
 	_p->_current_index++;
-	if(!_p->observers.size()) return;
-	for (auto& [id,observer] : _p->observers)
+	if (_p->observers.empty()) return;
+	if (_p->precomputed)
+	{
+		if (_p->validate_features) check_features();
+		return;
+	}
+	if (PROFILER_AVAILABLE && _p->_observer_profile)
+	{
+		auto begin = read_cycles();
+		_p->observers.step();
+		_p->_observer_profile->add(read_cycles() - begin);
+		return;
+	}
+	_p->observers.step();
+}
+
+
+//============================================================================
+AssetCursor
+Asset::cursor() const noexcept
+{
+	return { _p->_current_index, _state };
+}
+
+
+//============================================================================
+void
+Asset::restore(AssetCursor const& cursor) noexcept
+{
+	// observers are only ever fed the rows the asset steps over, so replaying those rows from
+	// a reset leaves every observer exactly as it was when the cursor was taken
+	if (_p->observers.empty() || (_p->precomputed && !_p->validate_features))
+	{
+		_p->_current_index = cursor.current_index;
+		if (_p->_data32_ptr) _p->_data32_ptr = _p->_data32_view.data() + cursor.current_index * _p->_cols;
+		else _p->_data_ptr = _p->_data_view.data() + cursor.current_index * _p->_cols;
+	}
+	else
+	{
+		// replays run concurrently across assets and are not part of any step, keep them out of the profile
+		auto profile = std::exchange(_p->_observer_profile, nullptr);
+		reset();
+		while (_p->_current_index < cursor.current_index) advance();
+		_p->_observer_profile = profile;
+	}
+	_state = cursor.state;
+}
+
+
+//============================================================================
+void
+Asset::set_observer_profile(PhaseCounter* counter) noexcept
+{
+	_p->_observer_profile = counter;
+}
+
+
+//============================================================================
+std::expected<bool, AgisException>
+Asset::enable_live(size_t capacity) noexcept
+{
+	// observers hold pointers into the storage that is about to move
+	if (!_p->observers.empty())
+	{
+		return std::unexpected(AgisException("Asset " + _asset_id + " must go live before observers are registered"));
+	}
+	return _p->enable_live(capacity);
+}
+
+
+//============================================================================
+std::expected<bool, AgisException>
+Asset::append(long long dt, std::span<double const> values) noexcept
+{
+	return _p->append(dt, values);
+}
+
+
+//============================================================================
+std::expected<bool, AgisException>
+Asset::narrow() noexcept
+{
+	if (!_p->observers.empty())
 	{
-		observer->on_step();
+		return std::unexpected(AgisException("Asset " + _asset_id + " must be narrowed before observers are registered"));
 	}
+	return _p->narrow();
+}
+
+
+//============================================================================
+bool
+Asset::is_live() const noexcept
+{
+	return _p->_live_dt != nullptr;
 }
 
 
@@ -135,6 +242,34 @@ Asset::~Asset()
 }
 
 
+//============================================================================
+UniquePtr<Asset>
+Asset::fork(std::span<long long const> exchange_dt_index) const noexcept
+{
+	// the panel is immutable once loaded so the fork shares it, only the cursor, state and
+	// observers belong to the fork
+	auto p = new AssetPrivate();
+	p->_rows = _p->_rows;
+	p->_cols = _p->_cols;
+	p->_open_index = _p->_open_index;
+	p->_close_index = _p->_close_index;
+	p->_close_column = _p->_close_column;
+	p->_dt_view = _p->_dt_view;
+	p->_data_view = _p->_data_view;
+	p->_data32_view = _p->_data32_view;
+	p->_mapping = _p->_mapping;
+	p->_precision = _p->_precision;
+	p->_data32_ptr = p->_data32_view.empty() ? nullptr : p->_data32_view.data();
+	p->_headers = _p->_headers;
+	p->_load_stats = _p->_load_stats;
+	p->_alignment = _p->_alignment;
+	p->_alignment.rebind(exchange_dt_index);
+	auto asset = std::make_unique<Asset>(p, _asset_id, _asset_index);
+	asset->_dt_format = _dt_format;
+	return asset;
+}
+
+
 //============================================================================
 size_t Asset::rows() const noexcept
 {
@@ -154,13 +289,17 @@ bool
 Asset::encloses(Asset const& other) const noexcept
 {
 	if(_p->_rows < other._p->_rows) return false;
+	if (_p->_alignment.same_index(other._p->_alignment))
+	{
+		return _p->_alignment.encloses(other._p->_alignment);
+	}
 	auto const& other_index = other.get_dt_index();
 	auto other_start = get_enclosing_index(other);
 	if (!other_start) return false;
 	for (size_t i = 0; i < other.rows(); i++)
 	{
 		if (i > _p->_rows) return false;
-		if (_p->_dt_index[*other_start + i] != other_index[i])
+		if (_p->_dt_view[*other_start + i] != other_index[i])
 		{
 			return false;
 		}
@@ -173,20 +312,72 @@ Asset::encloses(Asset const& other) const noexcept
 std::optional<size_t>
 Asset::get_enclosing_index(Asset const& other) const noexcept
 {
+	if (_p->_alignment.same_index(other._p->_alignment))
+	{
+		return _p->_alignment.row(other._p->_alignment.first());
+	}
 	auto other_index = other.get_dt_index();
 	auto other_start = other_index.front();
-	auto it = std::find(_p->_dt_index.begin(), _p->_dt_index.end(), other_start);
-	if (it == _p->_dt_index.end()) return std::nullopt;
-	return static_cast<size_t>(std::distance(_p->_dt_index.begin(), it));
+	auto it = std::find(_p->_dt_view.begin(), _p->_dt_view.end(), other_start);
+	if (it == _p->_dt_view.end()) return std::nullopt;
+	return static_cast<size_t>(std::distance(_p->_dt_view.begin(), it));
 }
 
 
 //============================================================================
 void
+Asset::align(std::span<long long const> exchange_dt_index) noexcept
+{
+	if (_p->_live_dt)
+	{
+		_p->_alignment = RowAlignment();
+		return;
+	}
+	auto alignment = RowAlignment::build(_p->_dt_view, exchange_dt_index);
+	_p->_alignment = alignment ? std::move(*alignment) : RowAlignment();
+}
+
+
+//============================================================================
+std::optional<size_t>
+Asset::get_aligned_row(size_t exchange_index) const noexcept
+{
+	if (_p->_alignment.empty())
+	{
+		return std::nullopt;
+	}
+	return _p->_alignment.row(exchange_index);
+}
+
+
+//============================================================================
+AssetObserver const*
 Asset::add_observer(UniquePtr<AssetObserver> observer) noexcept
 {
-	auto obs_hash = observer->hash();
-	_p->observers[obs_hash] = std::move(observer);
+	auto node = _p->observers.insert(std::move(observer));
+	drop_features();
+	return node;
+}
+
+
+//============================================================================
+void
+Asset::remove_observers(std::span<AssetObserver const* const> nodes) noexcept
+{
+	if (_p->observers.erase(nodes)) drop_features();
+}
+
+
+//============================================================================
+void
+Asset::drop_features() noexcept
+{
+	if (!_p->precomputed) return;
+	// the series no longer matches the graph's nodes, go back to stepping the graph from where the asset is
+	_p->precomputed = false;
+	_p->features.clear();
+	_p->features.shrink_to_fit();
+	restore(cursor());
 }
 
 
@@ -194,9 +385,97 @@ Asset::add_observer(UniquePtr<AssetObserver> observer) noexcept
 std::optional<AssetObserver const*>
 Asset::get_observer(size_t hash) const noexcept
 {
-	auto itr = _p->observers.find(hash);
-	if (itr == _p->observers.end()) return std::nullopt;
-	return itr->second.get();
+	return _p->observers.find(hash);
+}
+
+
+//============================================================================
+size_t
+Asset::observer_count() const noexcept
+{
+	return _p->observers.size();
+}
+
+
+//============================================================================
+std::optional<double>
+Asset::get_observer_value(size_t hash) const noexcept
+{
+	auto const& graph = _p->observers;
+	if (!_p->precomputed)
+	{
+		auto observer = graph.find(hash);
+		if (!observer) return std::nullopt;
+		return (*observer)->value();
+	}
+	auto slot = graph.slot(hash);
+	if (!slot || !_p->_current_index) return std::nullopt;
+	return _p->features[(_p->_current_index - 1) * graph.size() + *slot];
+}
+
+
+//============================================================================
+bool
+Asset::observers_precomputed() const noexcept
+{
+	return _p->precomputed;
+}
+
+
+//============================================================================
+size_t
+Asset::feature_mismatches() const noexcept
+{
+	return _p->feature_mismatches;
+}
+
+
+//============================================================================
+bool
+Asset::precompute_observers(bool validate) noexcept
+{
+	// live rows are not known ahead of time and observers that write outside the asset must step with it
+	auto& graph = _p->observers;
+	if (is_live() || graph.empty() || !graph.batchable()) return false;
+
+	// replay the whole panel through the graph in one pass, the asset is streaming on every row
+	// it replays and the replay is not part of any step so it stays out of the profile
+	auto position = cursor();
+	auto profile = std::exchange(_p->_observer_profile, nullptr);
+	_p->precomputed = false;
+	reset();
+	_state = AssetState::STREAMING;
+	auto width = graph.size();
+	_p->features.resize(_p->_rows * width);
+	auto out = _p->features.data();
+	for (size_t row = 0; row < _p->_rows; row++)
+	{
+		advance();
+		for (size_t slot = 0; slot < width; slot++) *out++ = graph.node(slot).value();
+	}
+	_p->_observer_profile = profile;
+	_p->precomputed = true;
+	_p->validate_features = validate;
+	_p->feature_mismatches = 0;
+	reset();
+	restore(position);
+	return true;
+}
+
+
+//============================================================================
+void
+Asset::check_features() noexcept
+{
+	auto const& graph = _p->observers;
+	_p->observers.step();
+	auto width = graph.size();
+	auto expected = _p->features.data() + (_p->_current_index - 1) * width;
+	for (size_t slot = 0; slot < width; slot++)
+	{
+		auto v = graph.node(slot).value();
+		if (v != expected[slot] && !(std::isnan(v) && std::isnan(expected[slot]))) _p->feature_mismatches++;
+	}
 }
 
 
@@ -215,11 +494,13 @@ Asset::get_pct_change(size_t column, size_t offset, size_t shift) const noexcept
 		return 0.0;
 	}
 #endif
-	auto current_idx = column - _p->_cols;
-	auto prev_idx =  column - _p->_cols - offset * _p->_cols;
-	current_idx -= shift * _p->_cols;
-	prev_idx -= shift * _p->_cols;
-	return (*(_p->_data_ptr + current_idx) - *(_p->_data_ptr + prev_idx)) / *(_p->_data_ptr + prev_idx);
+	auto cols = static_cast<std::ptrdiff_t>(_p->_cols);
+	auto current_idx = static_cast<std::ptrdiff_t>(column) - cols;
+	auto prev_idx = current_idx - static_cast<std::ptrdiff_t>(offset) * cols;
+	current_idx -= static_cast<std::ptrdiff_t>(shift) * cols;
+	prev_idx -= static_cast<std::ptrdiff_t>(shift) * cols;
+	auto prev = _p->read(prev_idx);
+	return (_p->read(current_idx) - prev) / prev;
 }
 
 //============================================================================
@@ -232,11 +513,11 @@ Asset::get_market_price(bool is_close) const noexcept
 	}
 	if (is_close)
 	{
-		return *(_p->_data_ptr + _p->_close_index - _p->_cols);
+		return _p->read(static_cast<std::ptrdiff_t>(_p->_close_index) - static_cast<std::ptrdiff_t>(_p->_cols));
 	}
 	else 
 	{
-		return *(_p->_data_ptr + _p->_open_index - _p->_cols);
+		return _p->read(static_cast<std::ptrdiff_t>(_p->_open_index) - static_cast<std::ptrdiff_t>(_p->_cols));
 	}
 }
 
@@ -258,8 +539,11 @@ std::optional<double> Asset::get_asset_feature(size_t column, int index) const n
 		return std::nullopt;
 	}
 #endif
-	size_t index_offset = (index == 0) ? 0 : static_cast<size_t>(std::abs(index) * _p->_cols);
-	return *(_p->_data_ptr + column - _p->_cols - index_offset);
+	// the index counts rows back from the current one whatever its sign, a positive index must
+	// never read ahead of the current row in a release build
+	auto cols = static_cast<std::ptrdiff_t>(_p->_cols);
+	auto index_offset = static_cast<std::ptrdiff_t>(std::abs(index)) * cols;
+	return _p->read(static_cast<std::ptrdiff_t>(column) - cols - index_offset);
 }
 
 
@@ -274,16 +558,37 @@ std::optional<size_t> Asset::get_streaming_index() const noexcept
 }
 
 //============================================================================
-std::vector<long long> const& Asset::get_dt_index() const noexcept
+std::span<long long const> Asset::get_dt_index() const noexcept
+{
+	return _p->_dt_view;
+}
+
+
+//============================================================================
+std::span<double const> Asset::get_data() const noexcept
 {
-	return _p->_dt_index;
+	return _p->_data_view;
 }
 
 
 //============================================================================
-std::vector<double> const& Asset::get_data() const noexcept
+std::span<float const> Asset::get_data32() const noexcept
 {
-	return _p->_data;
+	return _p->_data32_view;
+}
+
+
+//============================================================================
+StoragePrecision Asset::get_precision() const noexcept
+{
+	return _p->_precision;
+}
+
+
+//============================================================================
+size_t Asset::get_data_bytes() const noexcept
+{
+	return _p->_data_view.size_bytes() + _p->_data32_view.size_bytes();
 }
 
 
@@ -295,6 +600,14 @@ Asset::get_close_column() const noexcept
 }
 
 
+//============================================================================
+FileLoadStats const&
+Asset::get_load_stats() const noexcept
+{
+	return _p->_load_stats;
+}
+
+
 //============================================================================
 std::optional<std::vector<double>>
 Asset::get_column(std::string const& column_name) const noexcept
@@ -309,7 +622,7 @@ Asset::get_column(std::string const& column_name) const noexcept
 	// loop over row major data in extract the column
 	for (size_t row = 0; row < _p->_rows; row++)
 	{
-		col.push_back(_p->_data[_p->get_index(row, col_index)]);
+		col.push_back(_p->at(_p->get_index(row, col_index)));
 	}
 	return col;
 }
@@ -345,6 +658,13 @@ size_t Asset::get_close_index() const noexcept
 }
 
 
+//============================================================================
+size_t Asset::get_open_index() const noexcept
+{
+	return _p->_open_index;
+}
+
+
 //============================================================================
 std::expected<UniquePtr<Asset>, AgisException>
 AssetFactory::create_asset(
@@ -352,15 +672,64 @@ AssetFactory::create_asset(
 	std::string source
 )
 {
-	auto asset = new AssetPrivate();
+	return create_asset(std::move(asset_name), std::move(source), _asset_counter++);
+}
+
+
+//============================================================================
+std::expected<UniquePtr<Asset>, AgisException>
+AssetFactory::create_asset(
+	std::string asset_name,
+	std::string source,
+	size_t asset_index
+)
+{
+	auto asset = std::make_unique<AssetPrivate>();
 	AGIS_ASSIGN_OR_RETURN(file_type, Agis::get_file_type(source));
 	switch (file_type)
 	{
 	case FileType::CSV:
-		AGIS_ASSIGN_OR_RETURN(res, asset->load_csv(source, _dt_format));
+#ifdef AGIS_CSV_STREAM_LOADER
+		AGIS_ASSIGN_OR_RETURN(res, asset->load_csv_stream(source, _dt_format));
+#else
+		AGIS_ASSIGN_OR_RETURN(res, asset->load_csv(source, _dt_parser, _window));
+#endif
 		break;
 	}
-	auto m = std::make_unique<Asset>(asset, asset_name, _asset_counter++);
+	auto m = std::make_unique<Asset>(asset.release(), asset_name, asset_index);
+	m->_dt_format = _dt_format;
+	return m;
+}
+
+
+//============================================================================
+std::expected<UniquePtr<Asset>, AgisException>
+AssetFactory::create_asset(
+	std::string asset_name,
+	SharedPtr<MemoryMappedFile> mapping,
+	AssetCacheEntry const& entry,
+	std::vector<std::string> const& columns,
+	size_t asset_index)
+{
+	auto asset = std::make_unique<AssetPrivate>();
+	AGIS_ASSIGN_OR_RETURN(res, asset->load_cache(std::move(mapping), entry, columns));
+	auto m = std::make_unique<Asset>(asset.release(), asset_name, asset_index);
+	m->_dt_format = _dt_format;
+	return m;
+}
+
+
+//============================================================================
+std::expected<UniquePtr<Asset>, AgisException>
+AssetFactory::create_asset(
+	AssetPanel&& panel,
+	std::vector<std::string> const& columns,
+	size_t asset_index)
+{
+	auto asset = std::make_unique<AssetPrivate>();
+	auto asset_name = panel.asset_id;
+	AGIS_ASSIGN_OR_RETURN(res, asset->load_panel(std::move(panel), columns));
+	auto m = std::make_unique<Asset>(asset.release(), asset_name, asset_index);
 	m->_dt_format = _dt_format;
 	return m;
 }
@@ -377,7 +746,7 @@ AssetFactory::create_asset(
 	H5::DataSpace& dataspaceIndex)
 {
 	auto asset = new AssetPrivate();
-	AGIS_ASSIGN_OR_RETURN(res, asset->load_h5(dataset, dataspace, datasetIndex, dataspaceIndex));
+	AGIS_ASSIGN_OR_RETURN(res, asset->load_h5(dataset, dataspace, datasetIndex, dataspaceIndex, _window));
 	auto m = std::make_unique<Asset>(asset, asset_name, _asset_counter++);
 	m->_dt_format = _dt_format;
 	return m;
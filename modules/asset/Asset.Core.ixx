@@ -19,7 +19,13 @@ import <optional>;
 import <span>;
 
 import AgisError;
+import AgisFileUtils;
+import AgisMemoryMap;
 import AgisPointersModule;
+import AssetCacheModule;
+import AgisTimeUtils;
+import AgisTypes;
+import AgisProfiler;
 
 namespace Agis
 {
@@ -36,6 +42,17 @@ export enum AssetState: uint8_t
 class AssetPrivate;
 class AssetFactory;
 
+
+//============================================================================
+/// <summary>
+/// Position of an asset within its own dt index, enough to put the asset back where it was
+/// </summary>
+export struct AssetCursor
+{
+	size_t current_index = 0;
+	AssetState state = AssetState::PENDING;
+};
+
 //============================================================================
 export class Asset
 {
@@ -51,27 +68,66 @@ public:
 	AssetState get_state() const noexcept { return _state;}
 	std::optional<double> get_pct_change(size_t column, size_t offset, size_t shift = 0) const noexcept;
 	std::optional<double> get_market_price(bool is_close) const noexcept;
-	std::optional<double> get_asset_feature(size_t column, int index) const noexcept;
+	AGIS_API std::optional<double> get_asset_feature(size_t column, int index) const noexcept;
 	std::string const& get_dt_format() const noexcept { return _dt_format; }
 	size_t get_current_index() const noexcept;
-	StridedPointer<double const> get_close_span() const noexcept;
+	StridedColumn get_close_span() const noexcept;
 
 	bool encloses(Asset const& other) const noexcept;
 	std::optional<size_t> get_enclosing_index(Asset const& other) const noexcept;
-	void add_observer(UniquePtr<AssetObserver> observer) noexcept;
-	std::optional<AssetObserver const *> get_observer(size_t hash) const noexcept;
+
+	/// <summary>
+	/// Add observer to the asset's observer graph, returns the node that computes it. Observers and
+	/// inputs identical to ones already registered share the existing nodes.
+	/// </summary>
+	AssetObserver const* add_observer(UniquePtr<AssetObserver> observer) noexcept;
+
+	/// <summary>
+	/// Remove observer nodes returned by add_observer that no other observer takes as input
+	/// </summary>
+	void remove_observers(std::span<AssetObserver const* const> nodes) noexcept;
+
+	/// <summary>
+	/// Observer node with hash. Its own state is not stepped while the asset's observers are
+	/// precomputed, read its value through get_observer_value.
+	/// </summary>
+	AGIS_API std::optional<AssetObserver const *> get_observer(size_t hash) const noexcept;
+
+	/// <summary>
+	/// Number of unique observer nodes stepped on every row of the asset
+	/// </summary>
+	AGIS_API size_t observer_count() const noexcept;
+
+	/// <summary>
+	/// Value of the observer with hash as of the current row, read from the precomputed series when
+	/// the asset has one and from the observer itself otherwise
+	/// </summary>
+	AGIS_API std::optional<double> get_observer_value(size_t hash) const noexcept;
+	AGIS_API bool observers_precomputed() const noexcept;
+
+	/// <summary>
+	/// Rows on which a validated precomputed observer value differed from the incremental one
+	/// </summary>
+	AGIS_API size_t feature_mismatches() const noexcept;
 
 	inline bool is_streaming() const noexcept 
 	{
 		return _state == AssetState::STREAMING || _state == AssetState::LAST;
 	}
+	bool is_live() const noexcept;
 	AGIS_API size_t get_close_index() const noexcept;
+	AGIS_API size_t get_open_index() const noexcept;
 	AGIS_API std::optional<std::vector<double>> get_column(std::string const& column_name) const noexcept;
 	AGIS_API std::optional<size_t> get_streaming_index() const noexcept;
-	AGIS_API std::vector<long long> const& get_dt_index() const noexcept;
+	AGIS_API std::optional<size_t> get_aligned_row(size_t exchange_index) const noexcept;
+	AGIS_API std::span<long long const> get_dt_index() const noexcept;
 	AGIS_API std::vector<std::string> get_column_names() const noexcept;
-	AGIS_API std::vector<double> const& get_data() const noexcept;
+	AGIS_API std::span<double const> get_data() const noexcept;
+	AGIS_API std::span<float const> get_data32() const noexcept;
+	AGIS_API StoragePrecision get_precision() const noexcept;
+	AGIS_API size_t get_data_bytes() const noexcept;
 	AGIS_API std::string const& get_close_column() const noexcept;
+	AGIS_API FileLoadStats const& get_load_stats() const noexcept;
 	AGIS_API std::string const& get_id() const noexcept { return _asset_id; }
 
 	// delete copy constructor and assignment operator
@@ -80,10 +136,21 @@ public:
 	Asset(AssetPrivate* asset, std::string asset_id, size_t asset_index);
 
 private:
-	double* get_data_ptr() const noexcept;
+	double const* get_data_ptr() const noexcept;
 	void reset() noexcept;
-	AssetState step(long long global_time) noexcept;
+	AssetState step(long long global_time, size_t exchange_index) noexcept;
+	void align(std::span<long long const> exchange_dt_index) noexcept;
 	void advance() noexcept;
+	AssetCursor cursor() const noexcept;
+	void restore(AssetCursor const& cursor) noexcept;
+	void set_observer_profile(PhaseCounter* counter) noexcept;
+	bool precompute_observers(bool validate) noexcept;
+	void drop_features() noexcept;
+	void check_features() noexcept;
+	std::expected<bool, AgisException> enable_live(size_t capacity) noexcept;
+	std::expected<bool, AgisException> narrow() noexcept;
+	UniquePtr<Asset> fork(std::span<long long const> exchange_dt_index) const noexcept;
+	std::expected<bool, AgisException> append(long long dt, std::span<double const> values) noexcept;
 
 	size_t _asset_index;
 	std::string _asset_id;
@@ -99,11 +166,13 @@ export class AssetFactory
 public:
 	AssetFactory(
 		std::string dt_format,
-		std::string exchange_id
-	) 
+		std::string exchange_id,
+		std::optional<LoadWindow> window = std::nullopt
+	) : _dt_parser(dt_format)
 	{
 		_exchange_id = exchange_id;
 		_dt_format = dt_format;
+		_window = std::move(window);
 	}
 
 	std::expected<UniquePtr<Asset>, AgisException> create_asset(
@@ -111,6 +180,39 @@ public:
 		std::string source
 	);
 
+	std::expected<UniquePtr<Asset>, AgisException> create_asset(
+		std::string asset_name,
+		std::string source,
+		size_t asset_index
+	);
+
+	/// <summary>
+	/// Reserve a contiguous block of n asset indices so that assets can be created concurrently
+	/// while still receiving a deterministic index. Returns the first index of the block.
+	/// </summary>
+	size_t reserve_indices(size_t n) noexcept { return _asset_counter.fetch_add(n); }
+
+	/// <summary>
+	/// Create an asset whose dt index and data are views into a mapped exchange cache.
+	/// The asset holds a reference to the mapping which is shared by every asset of the exchange.
+	/// </summary>
+	std::expected<UniquePtr<Asset>, AgisException> create_asset(
+		std::string asset_name,
+		SharedPtr<MemoryMappedFile> mapping,
+		AssetCacheEntry const& entry,
+		std::vector<std::string> const& columns,
+		size_t asset_index
+	);
+
+	/// <summary>
+	/// Create an asset that takes ownership of a panel held in memory
+	/// </summary>
+	std::expected<UniquePtr<Asset>, AgisException> create_asset(
+		AssetPanel&& panel,
+		std::vector<std::string> const& columns,
+		size_t asset_index
+	);
+
 	std::expected<UniquePtr<Asset>, AgisException> create_asset(
 		std::string asset_name,
 		std::string source,
@@ -124,6 +226,16 @@ private:
 	std::atomic<size_t> _asset_counter = 0;
 	std::string _dt_format;
 	std::string _exchange_id;
+
+	/// <summary>
+	/// Parser compiled from the exchange's dt_format, shared by every asset the factory loads
+	/// </summary>
+	DateTimeParser _dt_parser;
+
+	/// <summary>
+	/// Optional row and column restriction applied to every asset the factory loads from source
+	/// </summary>
+	std::optional<LoadWindow> _window;
 };
 
 }
\ No newline at end of file
@@ -4,15 +4,77 @@ module;
 #include <fstream>
 #include <unordered_set>
 #include <algorithm>
+#include <bit>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <numeric>
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define AGIS_SSE2
+#endif
 
 module AssetPrivateModule;
 
 import AgisTimeUtils;
+import AgisMemoryMap;
+import AgisReservedBuffer;
 
 namespace Agis
 {
 
 
+//============================================================================
+size_t
+count_newlines(char const* p, char const* end) noexcept
+{
+	size_t count = 0;
+#ifdef AGIS_SSE2
+	// compare 16 bytes at a time and pop count the resulting byte mask
+	__m128i const newline = _mm_set1_epi8('\n');
+	for (; p + 16 <= end; p += 16)
+	{
+		__m128i chunk = _mm_loadu_si128(reinterpret_cast<__m128i const*>(p));
+		auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline)));
+		count += std::popcount(mask);
+	}
+#endif
+	return count + std::count(p, end, '\n');
+}
+
+
+//============================================================================
+char const*
+find_newline(char const* p, char const* end) noexcept
+{
+#ifdef AGIS_SSE2
+	__m128i const newline = _mm_set1_epi8('\n');
+	for (; p + 16 <= end; p += 16)
+	{
+		__m128i chunk = _mm_loadu_si128(reinterpret_cast<__m128i const*>(p));
+		auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline)));
+		if (mask) return p + std::countr_zero(mask);
+	}
+#endif
+	for (; p < end; ++p)
+	{
+		if (*p == '\n') return p;
+	}
+	return end;
+}
+
+
+//============================================================================
+inline char const*
+skip_blank(char const* p, char const* end) noexcept
+{
+	while (p < end && (*p == ' ' || *p == '\t')) ++p;
+	return p;
+}
+
+
 //============================================================================
 size_t
 AssetPrivate::get_index(size_t row, size_t col) {
@@ -67,13 +129,213 @@ AssetPrivate::validate_headers()
 	return true;
 }
 
+//============================================================================
+std::expected<bool, AgisException>
+AssetPrivate::parse_csv_headers(std::string_view line)
+{
+	// skip the first column (date)
+	auto comma = line.find(',');
+	if (comma == std::string_view::npos)
+	{
+		return std::unexpected(AgisException("Could not parse headers"));
+	}
+	line.remove_prefix(comma + 1);
+	size_t column_index = 0;
+	while (true)
+	{
+		comma = line.find(',');
+		auto column_name = line.substr(0, comma);
+		while (!column_name.empty() && (column_name.front() == ' ' || column_name.front() == '\t'))
+			column_name.remove_prefix(1);
+		while (!column_name.empty() && (column_name.back() == ' ' || column_name.back() == '\t'))
+			column_name.remove_suffix(1);
+		this->_headers[std::string(column_name)] = column_index;
+		column_index++;
+		if (comma == std::string_view::npos) break;
+		line.remove_prefix(comma + 1);
+	}
+	return true;
+}
+
+
+//============================================================================
+/// <summary>
+/// Restrict the headers to the requested columns plus open and close. Returns the source
+/// column index of every kept column in ascending order and renumbers the headers to their
+/// position in the projected row.
+/// </summary>
+std::expected<std::vector<size_t>, AgisException>
+AssetPrivate::project_headers(std::vector<std::string> const& columns)
+{
+	for (auto const& column : columns)
+	{
+		if (this->_headers.find(column) == this->_headers.end())
+		{
+			return std::unexpected(AgisException("Could not find column " + column));
+		}
+	}
+	std::vector<size_t> source_columns;
+	for (auto const& [name, index] : this->_headers)
+	{
+		auto lower = name;
+		std::transform(
+			lower.begin(),
+			lower.end(),
+			lower.begin(),
+			[](unsigned char c) { return std::tolower(c); });
+		if (lower == "open" || lower == "close" ||
+			std::find(columns.begin(), columns.end(), name) != columns.end())
+		{
+			source_columns.push_back(index);
+		}
+	}
+	std::sort(source_columns.begin(), source_columns.end());
+
+	std::unordered_map<std::string, size_t> projected;
+	for (auto const& [name, index] : this->_headers)
+	{
+		auto it = std::lower_bound(source_columns.begin(), source_columns.end(), index);
+		if (it != source_columns.end() && *it == index)
+		{
+			projected[name] = static_cast<size_t>(std::distance(source_columns.begin(), it));
+		}
+	}
+	this->_headers = std::move(projected);
+	return source_columns;
+}
+
+
 //============================================================================
 std::expected<bool, AgisException>
 AssetPrivate::load_csv(
+	std::string filename,
+	DateTimeParser const& dt_parser,
+	std::optional<LoadWindow> const& window
+	)
+{
+	auto start = std::chrono::steady_clock::now();
+	AGIS_ASSIGN_OR_RETURN(file, MemoryMappedFile::open(filename));
+	char const* p = file->data();
+	char const* end = file->end();
+	if (!p)
+	{
+		return std::unexpected(AgisException("Could not parse headers"));
+	}
+
+	// upper bound on the row count, the header is not a row and the last line
+	// may not be terminated by a new line
+	size_t line_count = count_newlines(p, end);
+	if (*(end - 1) != '\n') line_count++;
+	this->_rows = line_count - 1;
+
+	// parse headers
+	char const* line_end = find_newline(p, end);
+	char const* line_last = (line_end > p && *(line_end - 1) == '\r') ? line_end - 1 : line_end;
+	AGIS_ASSIGN_OR_RETURN(headers_res, this->parse_csv_headers(std::string_view(p, line_last - p)));
+
+	// map every column in the file to its slot in the projected row, npos for skipped columns
+	size_t source_cols = this->_headers.size();
+	std::vector<size_t> col_map(source_cols);
+	std::iota(col_map.begin(), col_map.end(), size_t(0));
+	if (window && window->columns)
+	{
+		AGIS_ASSIGN_OR_RETURN(source_columns, this->project_headers(*window->columns));
+		std::fill(col_map.begin(), col_map.end(), std::string::npos);
+		for (size_t i = 0; i < source_columns.size(); i++)
+		{
+			col_map[source_columns[i]] = i;
+		}
+	}
+	AGIS_ASSIGN_OR_RETURN(res, this->validate_headers());
+	this->_cols = this->_headers.size();
+	this->_data.resize(this->_rows * this->_cols, 0);
+	this->_dt_index.resize(this->_rows);
+	p = (line_end < end) ? line_end + 1 : end;
+
+	size_t row_counter = 0;
+	double* row_ptr = this->_data.data();
+	double skipped_value;
+	while (p < end)
+	{
+		line_end = find_newline(p, end);
+		line_last = (line_end > p && *(line_end - 1) == '\r') ? line_end - 1 : line_end;
+		// skip blank lines
+		if (line_last == p)
+		{
+			p = (line_end < end) ? line_end + 1 : end;
+			continue;
+		}
+
+		// first column is datetime
+		auto date_end = static_cast<char const*>(std::memchr(p, ',', line_last - p));
+		if (!date_end)
+		{
+			return std::unexpected(AgisException("Missing columns on row " + std::to_string(row_counter) + " of " + filename));
+		}
+		AGIS_ASSIGN_OR_RETURN(epoch, dt_parser.parse(std::string_view(p, date_end - p)));
+		// rows are sorted on datetime so nothing after the end of the window is read
+		if (window && window->after_end(epoch)) break;
+		if (window && window->before_start(epoch))
+		{
+			p = (line_end < end) ? line_end + 1 : end;
+			continue;
+		}
+		this->_dt_index[row_counter] = epoch;
+
+		// parse values directly into the row major data buffer
+		char const* field = date_end + 1;
+		for (size_t col_idx = 0; col_idx < source_cols; col_idx++)
+		{
+			field = skip_blank(field, line_last);
+			double* out = col_map[col_idx] == std::string::npos ? &skipped_value : row_ptr + col_map[col_idx];
+			auto [ptr, ec] = std::from_chars(field, line_last, *out);
+			if (ec != std::errc())
+			{
+				return std::unexpected(AgisException("Failed to parse value on row " + std::to_string(row_counter) + " of " + filename));
+			}
+			field = skip_blank(ptr, line_last);
+			if (col_idx + 1 < source_cols)
+			{
+				if (field == line_last || *field != ',')
+				{
+					return std::unexpected(AgisException("Missing columns on row " + std::to_string(row_counter) + " of " + filename));
+				}
+				field++;
+			}
+		}
+		if (field != line_last)
+		{
+			return std::unexpected(AgisException("Too many columns on row " + std::to_string(row_counter) + " of " + filename));
+		}
+		row_ptr += this->_cols;
+		row_counter++;
+		p = (line_end < end) ? line_end + 1 : end;
+	}
+
+	// trailing blank lines and rows outside of the load window were counted in the upper bound
+	if (row_counter < this->_rows)
+	{
+		this->_rows = row_counter;
+		this->_data.resize(this->_rows * this->_cols);
+		this->_dt_index.resize(this->_rows);
+		this->_data.shrink_to_fit();
+		this->_dt_index.shrink_to_fit();
+	}
+	_load_stats.bytes = file->size();
+	_load_stats.rows = this->_rows;
+	_load_stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return true;
+}
+
+
+//============================================================================
+std::expected<bool, AgisException>
+AssetPrivate::load_csv_stream(
 	std::string filename,
 	std::string dt_format
 	)
 {
+	auto start = std::chrono::steady_clock::now();
 	std::ifstream file(filename);
 	if (!file.is_open())
 	{
@@ -134,18 +396,63 @@ AssetPrivate::load_csv(
 		}
 		row_counter++;
 	}
-
+	_load_stats.bytes = static_cast<size_t>(std::filesystem::file_size(filename));
+	_load_stats.rows = _rows;
+	_load_stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 	return true;
 }
 
 
+//============================================================================
+/// <summary>
+/// Read the single datetime value at row of an h5 datetime dataset
+/// </summary>
+long long
+h5_read_dt(H5::DataSet& datasetIndex, H5::DataSpace& dataspaceIndex, hsize_t row)
+{
+	int rank = dataspaceIndex.getSimpleExtentNdims();
+	std::vector<hsize_t> offset(rank, 0);
+	std::vector<hsize_t> count(rank, 1);
+	offset[0] = row;
+	dataspaceIndex.selectHyperslab(H5S_SELECT_SET, count.data(), offset.data());
+	hsize_t one = 1;
+	H5::DataSpace memspace(1, &one);
+	long long value = 0;
+	datasetIndex.read(&value, H5::PredType::NATIVE_INT64, memspace, dataspaceIndex);
+	return value;
+}
+
+
+//============================================================================
+/// <summary>
+/// Binary search a sorted h5 datetime dataset for the first row in [0, rows) for which
+/// pred is false, reading one value per probe instead of the whole dataset
+/// </summary>
+template <typename Pred>
+hsize_t
+h5_partition_point(H5::DataSet& datasetIndex, H5::DataSpace& dataspaceIndex, hsize_t rows, Pred pred)
+{
+	hsize_t lo = 0;
+	hsize_t hi = rows;
+	while (lo < hi)
+	{
+		hsize_t mid = lo + (hi - lo) / 2;
+		if (pred(h5_read_dt(datasetIndex, dataspaceIndex, mid))) lo = mid + 1;
+		else hi = mid;
+	}
+	return lo;
+}
+
+
 //============================================================================
 std::expected<bool, AgisException> AssetPrivate::load_h5(
 	H5::DataSet& dataset,
 	H5::DataSpace& dataspace,
 	H5::DataSet& datasetIndex,
-	H5::DataSpace& dataspaceIndex)
+	H5::DataSpace& dataspaceIndex,
+	std::optional<LoadWindow> const& window)
 {
+	auto start = std::chrono::steady_clock::now();
 	// Get the number of attributes associated with the dataset
 	int numAttrs = dataset.getNumAttrs();
 	// Iterate through the attributes to find the column names
@@ -163,20 +470,283 @@ std::expected<bool, AgisException> AssetPrivate::load_h5(
 			this->_headers[attrValue] = static_cast<size_t>(i);
 		}
 	}
-	AGIS_ASSIGN_OR_RETURN(res, this->validate_headers());
 	// Get the number of rows and columns from the dataspace
 	int numDims = dataspace.getSimpleExtentNdims();
 	std::vector<hsize_t> dims(numDims);
 	dataspace.getSimpleExtentDims(dims.data(), nullptr);
-	_rows = dims[0];
-	_cols = dims[1];
-	// Allocate memory for the column-major array
-	_data.resize(_rows * _cols, 0);
-	dataset.read(_data.data(), H5::PredType::NATIVE_DOUBLE, dataspace);
+	hsize_t source_rows = dims[0];
+	hsize_t source_cols = dims[1];
 
-	// Allocate memory for the array to hold the data
+	// project the columns before validating so the open and close indices refer to the loaded row
+	std::vector<size_t> source_columns;
+	if (window && window->columns)
+	{
+		AGIS_ASSIGN_OR_RETURN(projected, this->project_headers(*window->columns));
+		source_columns = std::move(projected);
+	}
+	else
+	{
+		source_columns.resize(source_cols);
+		std::iota(source_columns.begin(), source_columns.end(), size_t(0));
+	}
+	AGIS_ASSIGN_OR_RETURN(res, this->validate_headers());
+
+	// binary search the datetime dataset for the rows inside of the window
+	hsize_t row_begin = 0;
+	hsize_t row_end = source_rows;
+	if (window && window->start)
+	{
+		row_begin = h5_partition_point(datasetIndex, dataspaceIndex, source_rows,
+			[&window](long long dt) { return window->before_start(dt); });
+	}
+	if (window && window->end)
+	{
+		row_end = h5_partition_point(datasetIndex, dataspaceIndex, source_rows,
+			[&window](long long dt) { return !window->after_end(dt); });
+	}
+	_rows = row_end > row_begin ? row_end - row_begin : 0;
+	_cols = source_columns.size();
+	_data.resize(_rows * _cols, 0);
 	_dt_index.resize(_rows, 0);
-	datasetIndex.read(_dt_index.data(), H5::PredType::NATIVE_INT64, dataspaceIndex);
+	if (!_rows) return true;
+
+	// select the window rows of every loaded column, h5 hands the selection back in row major
+	// order so the memory space is the dense projected block
+	if (_cols == source_cols)
+	{
+		hsize_t offset[2] = { row_begin, 0 };
+		hsize_t count[2] = { _rows, source_cols };
+		dataspace.selectHyperslab(H5S_SELECT_SET, count, offset);
+	}
+	else
+	{
+		dataspace.selectNone();
+		for (auto column : source_columns)
+		{
+			hsize_t offset[2] = { row_begin, column };
+			hsize_t count[2] = { _rows, 1 };
+			dataspace.selectHyperslab(H5S_SELECT_OR, count, offset);
+		}
+	}
+	hsize_t mem_dims[2] = { _rows, _cols };
+	H5::DataSpace memspace(2, mem_dims);
+	dataset.read(_data.data(), H5::PredType::NATIVE_DOUBLE, memspace, dataspace);
+
+	int index_rank = dataspaceIndex.getSimpleExtentNdims();
+	std::vector<hsize_t> index_offset(index_rank, 0);
+	std::vector<hsize_t> index_count(index_rank, 1);
+	index_offset[0] = row_begin;
+	index_count[0] = _rows;
+	dataspaceIndex.selectHyperslab(H5S_SELECT_SET, index_count.data(), index_offset.data());
+	hsize_t index_dims = _rows;
+	H5::DataSpace index_memspace(1, &index_dims);
+	datasetIndex.read(_dt_index.data(), H5::PredType::NATIVE_INT64, index_memspace, dataspaceIndex);
+
+	_load_stats.bytes = _rows * (_cols * sizeof(double) + sizeof(long long));
+	_load_stats.rows = _rows;
+	_load_stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return true;
+}
+
+
+//============================================================================
+std::expected<bool, AgisException>
+AssetPrivate::load_cache(
+	SharedPtr<MemoryMappedFile> mapping,
+	AssetCacheEntry const& entry,
+	std::vector<std::string> const& columns)
+{
+	if (entry.dt_offset % alignof(long long) || entry.data_offset % alignof(double) ||
+		!asset_cache_range_fits(entry.dt_offset, entry.rows, sizeof(long long), mapping->size()) ||
+		!asset_cache_range_fits(0, entry.cols, sizeof(double), mapping->size()) ||
+		!asset_cache_range_fits(entry.data_offset, entry.rows, entry.cols * sizeof(double), mapping->size()))
+	{
+		return std::unexpected(AgisException("Corrupt cache entry in " + mapping->path()));
+	}
+	// rows are entry.cols wide and indexed by the header's columns, the two must agree
+	if (entry.cols != columns.size())
+	{
+		return std::unexpected(AgisException("Cache entry column count does not match its header in " + mapping->path()));
+	}
+	if (entry.open_index >= columns.size() || entry.close_index >= columns.size())
+	{
+		return std::unexpected(AgisException("Cache entry column index out of range in " + mapping->path()));
+	}
+	_rows = entry.rows;
+	_cols = entry.cols;
+	_open_index = entry.open_index;
+	_close_index = entry.close_index;
+	_close_column = columns[_close_index];
+	for (size_t i = 0; i < columns.size(); i++)
+	{
+		_headers[columns[i]] = i;
+	}
+
+	// the views point straight into the mapping, nothing is copied out of the cache
+	auto base = mapping->data();
+	_dt_view = std::span<long long const>(
+		reinterpret_cast<long long const*>(base + entry.dt_offset), _rows
+	);
+	_data_view = std::span<double const>(
+		reinterpret_cast<double const*>(base + entry.data_offset), _rows * _cols
+	);
+	_mapping = std::move(mapping);
+	_load_stats.bytes = _rows * sizeof(long long) + _rows * _cols * sizeof(double);
+	_load_stats.rows = _rows;
+	return true;
+}
+
+
+//============================================================================
+std::expected<bool, AgisException>
+AssetPrivate::load_panel(AssetPanel&& panel, std::vector<std::string> const& columns)
+{
+	auto start = std::chrono::steady_clock::now();
+	// the asset steps against its last row, a panel without rows has none
+	if (panel.dt_index.empty())
+	{
+		return std::unexpected(AgisException("Panel of " + panel.asset_id + " has no rows"));
+	}
+	if (panel.data.size() != panel.dt_index.size() * columns.size())
+	{
+		return std::unexpected(AgisException("Panel of " + panel.asset_id + " does not match its dt index and columns"));
+	}
+	if (std::adjacent_find(panel.dt_index.begin(), panel.dt_index.end(), std::greater_equal<long long>()) != panel.dt_index.end())
+	{
+		return std::unexpected(AgisException("Dt index of " + panel.asset_id + " is not strictly increasing"));
+	}
+	// columns are matched case insensitively like csv headers, the first match wins
+	auto lower = [](std::string column) {
+		std::transform(column.begin(), column.end(), column.begin(), [](unsigned char c) { return std::tolower(c); });
+		return column;
+	};
+	std::optional<size_t> open_index, close_index;
+	for (size_t i = 0; i < columns.size(); i++)
+	{
+		_headers[columns[i]] = i;
+		auto column = lower(columns[i]);
+		if (column == "open" && !open_index) open_index = i;
+		if (column == "close" && !close_index) close_index = i;
+	}
+	if (!open_index || !close_index)
+	{
+		return std::unexpected(AgisException("Could not find header"));
+	}
+	_open_index = *open_index;
+	_close_index = *close_index;
+	_close_column = columns[_close_index];
+	_rows = panel.dt_index.size();
+	_cols = columns.size();
+	_dt_index = std::move(panel.dt_index);
+	_data = std::move(panel.data);
+	_load_stats.bytes = _rows * sizeof(long long) + _data.size() * sizeof(double);
+	_load_stats.rows = _rows;
+	_load_stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return true;
+}
+
+
+//============================================================================
+void
+AssetPrivate::bind_owned_storage() noexcept
+{
+	_dt_view = _dt_index;
+	_data_view = _data;
+}
+
+
+//============================================================================
+/// <summary>
+/// Convert the panel to float and release the owned double storage. A mapped panel is left to
+/// the page cache, the mapping is kept since the dt index still points into it.
+/// </summary>
+std::expected<bool, AgisException>
+AssetPrivate::narrow()
+{
+	if (_precision == StoragePrecision::FLOAT32) return true;
+	if (_live_dt)
+	{
+		return std::unexpected(AgisException("Live assets can not be stored as float"));
+	}
+	_data32.resize(_data_view.size());
+	std::transform(_data_view.begin(), _data_view.end(), _data32.begin(),
+		[](double v) { return static_cast<float>(v); });
+	_data.clear();
+	_data.shrink_to_fit();
+	_data_view = {};
+	_data_ptr = nullptr;
+	_data32_view = _data32;
+	_data32_ptr = _data32.data() + _current_index * _cols;
+	_precision = StoragePrecision::FLOAT32;
+	return true;
+}
+
+
+//============================================================================
+/// <summary>
+/// Move the asset's storage into reserved buffers that can take up to capacity rows in total.
+/// Appending to the buffers never moves them, so pointers and spans handed out after this call
+/// stay valid as live bars arrive.
+/// </summary>
+std::expected<bool, AgisException>
+AssetPrivate::enable_live(size_t capacity)
+{
+	if (_live_dt) return true;
+	if (_precision != StoragePrecision::FLOAT64)
+	{
+		return std::unexpected(AgisException("Live assets must be stored as double"));
+	}
+	if (capacity < _rows)
+	{
+		return std::unexpected(AgisException("Live capacity is smaller than the loaded rows"));
+	}
+	AGIS_ASSIGN_OR_RETURN(live_dt, ReservedBuffer<long long>::create(capacity));
+	AGIS_ASSIGN_OR_RETURN(live_data, ReservedBuffer<double>::create(capacity * _cols));
+	AGIS_ASSIGN_OR_RETURN(dt_res, live_dt->append(_dt_view.data(), _dt_view.size()));
+	AGIS_ASSIGN_OR_RETURN(data_res, live_data->append(_data_view.data(), _data_view.size()));
+	_live_dt = std::move(live_dt);
+	_live_data = std::move(live_data);
+	_dt_view = std::span<long long const>(_live_dt->data(), _live_dt->size());
+	_data_view = std::span<double const>(_live_data->data(), _live_data->size());
+	_data_ptr = _live_data->data() + _current_index * _cols;
+
+	// the history now lives in the reserved buffers
+	_dt_index.clear();
+	_dt_index.shrink_to_fit();
+	_data.clear();
+	_data.shrink_to_fit();
+	_mapping.reset();
+	_alignment = RowAlignment();
+	return true;
+}
+
+
+//============================================================================
+std::expected<bool, AgisException>
+AssetPrivate::append(long long dt, std::span<double const> values)
+{
+	if (!_live_dt)
+	{
+		return std::unexpected(AgisException("Asset is not live"));
+	}
+	if (values.size() != _cols)
+	{
+		return std::unexpected(AgisException("Expected " + std::to_string(_cols) + " values, got " + std::to_string(values.size())));
+	}
+	if (_rows && dt <= _dt_view.back())
+	{
+		return std::unexpected(AgisException("Bar at " + std::to_string(dt) + " is not after the last bar"));
+	}
+	// capacity is checked on both buffers before either is written so a failed append leaves no partial row
+	if (_live_dt->size() + 1 > _live_dt->capacity())
+	{
+		return std::unexpected(AgisException("Live capacity of " + std::to_string(_live_dt->capacity()) + " rows exceeded"));
+	}
+	AGIS_ASSIGN_OR_RETURN(data_res, _live_data->append(values.data(), values.size()));
+	AGIS_ASSIGN_OR_RETURN(dt_res, _live_dt->append(&dt, 1));
+	_rows++;
+	_dt_view = std::span<long long const>(_live_dt->data(), _rows);
+	_data_view = std::span<double const>(_live_data->data(), _rows * _cols);
 	return true;
 }
 
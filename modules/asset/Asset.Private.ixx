@@ -9,10 +9,21 @@ import <vector>;
 import <unordered_map>;
 import <expected>;
 import <string>;
+import <string_view>;
+import <span>;
+import <optional>;
 
 
 import AgisError;
+import AgisTypes;
+import AgisFileUtils;
+import AgisMemoryMap;
+import AgisReservedBuffer;
+import AgisAlignment;
+import AssetCacheModule;
+import AgisTimeUtils;
 import AssetObserverModule;
+import AgisProfiler;
 
 namespace Agis 
 {
@@ -28,21 +39,87 @@ export struct AssetPrivate
 	size_t _current_index = 0;
 	std::vector<long long> _dt_index;
 	std::vector<double> _data;
-	double* _data_ptr;
+	std::span<long long const> _dt_view;
+	std::span<double const> _data_view;
+	SharedPtr<MemoryMappedFile> _mapping;
+	UniquePtr<ReservedBuffer<long long>> _live_dt;
+	UniquePtr<ReservedBuffer<double>> _live_data;
+	double const* _data_ptr;
+	StoragePrecision _precision = StoragePrecision::FLOAT64;
+	std::vector<float> _data32;
+	std::span<float const> _data32_view;
+	float const* _data32_ptr = nullptr;
+	/// <summary>
+	/// Rows of the asset against the dt index of its exchange, empty until the exchange is built
+	/// and for live assets whose exchange index still grows
+	/// </summary>
+	RowAlignment _alignment;
 	std::unordered_map<std::string, size_t> _headers;
-	ankerl::unordered_dense::map<size_t, UniquePtr<AssetObserver>> observers;
+	/// <summary>
+	/// Unique observers of the asset in the order they are stepped
+	/// </summary>
+	ObserverGraph observers;
+	/// <summary>
+	/// Value of every observer node after each row, [row][graph slot], filled ahead of the run by
+	/// Asset::precompute_observers. While set the graph is not stepped unless the values are validated.
+	/// </summary>
+	std::vector<double> features;
+	bool precomputed = false;
+	bool validate_features = false;
+	size_t feature_mismatches = 0;
+	/// <summary>
+	/// Observer counter of the exchange while it is being profiled, observer updates are timed into it
+	/// </summary>
+	PhaseCounter* _observer_profile = nullptr;
+	FileLoadStats _load_stats;
 
 	size_t get_index(size_t row, size_t col);
 	std::expected<bool, AgisException> validate_headers();
-	std::expected<bool, AgisException> load_csv(std::string filename, std::string dt_format);
+	std::expected<bool, AgisException> parse_csv_headers(std::string_view line);
+	std::expected<std::vector<size_t>, AgisException> project_headers(std::vector<std::string> const& columns);
+	std::expected<bool, AgisException> load_csv(
+		std::string filename,
+		DateTimeParser const& dt_parser,
+		std::optional<LoadWindow> const& window = std::nullopt
+	);
+	std::expected<bool, AgisException> load_csv_stream(std::string filename, std::string dt_format);
+	std::expected<bool, AgisException> load_cache(
+		SharedPtr<MemoryMappedFile> mapping,
+		AssetCacheEntry const& entry,
+		std::vector<std::string> const& columns
+	);
+	std::expected<bool, AgisException> load_panel(AssetPanel&& panel, std::vector<std::string> const& columns);
+	void bind_owned_storage() noexcept;
+	std::expected<bool, AgisException> narrow();
+	std::expected<bool, AgisException> enable_live(size_t capacity);
+	std::expected<bool, AgisException> append(long long dt, std::span<double const> values);
 	std::expected<bool, AgisException> load_h5(
 		H5::DataSet& dataset,
 		H5::DataSpace& dataspace,
 		H5::DataSet& datasetIndex,
-		H5::DataSpace& dataspaceIndex
+		H5::DataSpace& dataspaceIndex,
+		std::optional<LoadWindow> const& window = std::nullopt
 	);
 
 
+	/// <summary>
+	/// Value at offset from the current row pointer, widened to double for float panels
+	/// </summary>
+	inline double read(std::ptrdiff_t offset) const noexcept
+	{
+		if (_data32_ptr) return static_cast<double>(_data32_ptr[offset]);
+		return _data_ptr[offset];
+	}
+
+	/// <summary>
+	/// Value at a row major index into the panel, widened to double for float panels
+	/// </summary>
+	inline double at(size_t index) const noexcept
+	{
+		if (_precision == StoragePrecision::FLOAT32) return static_cast<double>(_data32_view[index]);
+		return _data_view[index];
+	}
+
 	~AssetPrivate();
 	AssetPrivate()
 	{
@@ -1,3 +1,8 @@
+module;
+
+#include <algorithm>
+#include <cmath>
+
 module AssetObserverModule;
 
 import AssetModule;
@@ -12,7 +17,17 @@ std::unordered_map<std::string, ObserverType> observer_type_map = {
 	{"Sum", ObserverType::Sum},
 	{"Variance", ObserverType::Variance},
 	{"Covariance", ObserverType::Covariance},
-	{"Correlation", ObserverType::Correlation}
+	{"Correlation", ObserverType::Correlation},
+	{"TsMax", ObserverType::TsMax},
+	{"TsArgMax", ObserverType::TsArgMax},
+	{"TsMin", ObserverType::TsMin},
+	{"TsArgMin", ObserverType::TsArgMin},
+	{"Mean", ObserverType::Mean},
+	{"StdDev", ObserverType::StdDev},
+	{"ZScore", ObserverType::ZScore},
+	{"Ema", ObserverType::Ema},
+	{"Beta", ObserverType::Beta},
+	{"Slope", ObserverType::Slope}
 };
 
 
@@ -25,90 +40,200 @@ AssetObserver::AssetObserver(Asset const& asset, ObserverType t)
 
 
 //============================================================================
-SumObserver::SumObserver(Asset const& asset, size_t lockback, UniquePtr<AssetObserver> input)
-	: AssetObserver(asset, ObserverType::Sum), _lookback(lockback), _input(std::move(input)), _sum(0.0)
+void
+AssetObserver::add_input(UniquePtr<AssetObserver> input) noexcept
 {
-	this->on_reset();
+	_inputs.push_back(input.get());
+	_owned_inputs.push_back(std::move(input));
 }
 
 
 //============================================================================
-void
-SumObserver::on_step() noexcept
+size_t
+AssetObserver::hash_with_inputs(std::initializer_list<size_t> params) const noexcept
+{
+	auto hash = observer_hash_combine(0, static_cast<size_t>(_type));
+	for (auto param : params) hash = observer_hash_combine(hash, param);
+	for (auto input : _inputs) hash = observer_hash_combine(hash, input->hash());
+	return hash;
+}
+
+
+//============================================================================
+AssetObserver*
+ObserverGraph::insert(UniquePtr<AssetObserver> observer) noexcept
 {
-	/*
-	_input->on_step();
-	auto v = _input->value();
-	if (_input->type() != ObserverType::Read)
+	// the hash only depends on the structure so a duplicate is found before its inputs are touched
+	auto hash = observer->hash();
+	auto itr = _index.find(hash);
+	if (itr != _index.end()) return _nodes[itr->second].get();
+
+	// inputs go in ahead of the observer, which keeps the node list topologically sorted
+	for (size_t i = 0; i < observer->_inputs.size(); i++)
 	{
-		// if add the end of the lookback period then remove the oldest value
-		_buffer[_current_index] = v;
-		auto next_index = (_current_index + 1) % _lookback;
-		if (_count >= _lookback - 1)
-		{
-			_sum -= _buffer[next_index];
-		}
+		observer->_inputs[i] = insert(std::move(observer->_owned_inputs[i]));
 	}
-	else if (_count >= _lookback - 1)
+	observer->_owned_inputs.clear();
+	auto node = observer.get();
+	_index.emplace(hash, _nodes.size());
+	_nodes.push_back(std::move(observer));
+	return node;
+}
+
+
+//============================================================================
+std::optional<AssetObserver const*>
+ObserverGraph::find(size_t hash) const noexcept
+{
+	auto itr = _index.find(hash);
+	if (itr == _index.end()) return std::nullopt;
+	return _nodes[itr->second].get();
+}
+
+
+//============================================================================
+size_t
+ObserverGraph::erase(std::span<AssetObserver const* const> nodes) noexcept
+{
+	std::vector<AssetObserver const*> sorted(nodes.begin(), nodes.end());
+	std::sort(sorted.begin(), sorted.end());
+	auto removed = std::erase_if(_nodes, [&](UniquePtr<AssetObserver> const& node) {
+		return std::binary_search(sorted.begin(), sorted.end(), node.get());
+	});
+	if (!removed) return 0;
+
+	// the nodes that stay keep their order, only their slots move
+	_index.clear();
+	for (size_t slot = 0; slot < _nodes.size(); slot++) _index.emplace(_nodes[slot]->hash(), slot);
+	return removed;
+}
+
+
+//============================================================================
+RollingMoments::RollingMoments(size_t lookback)
+	: _lookback(std::max<size_t>(lookback, 1)), _x_buffer(_lookback), _y_buffer(_lookback)
+{
+}
+
+
+//============================================================================
+void
+RollingMoments::add(double x, double y) noexcept
+{
+	_size++;
+	auto n = static_cast<double>(_size);
+	auto dx = x - _mean_x;
+	auto dy = y - _mean_y;
+	_mean_x += dx / n;
+	_mean_y += dy / n;
+	_m2_x += dx * (x - _mean_x);
+	_m2_y += dy * (y - _mean_y);
+	_c_xy += dx * (y - _mean_y);
+}
+
+
+//============================================================================
+void
+RollingMoments::remove(double x, double y) noexcept
+{
+	// the exact inverse of add, taken against the mean the window has without the pair
+	_size--;
+	if (!_size)
 	{
-		auto row = -1 * static_cast<int>(_lookback);
-		auto p = static_cast<AssetReadObserver*>(_input.get());
-		_sum -= _input->asset().get_asset_feature(p->column(), row).value();
+		_mean_x = _mean_y = _m2_x = _m2_y = _c_xy = 0.0;
+		return;
 	}
-	_sum += v;
-	_count++;
-	*/
+	auto n = static_cast<double>(_size);
+	auto dx = x - _mean_x;
+	auto dy = y - _mean_y;
+	_mean_x -= dx / n;
+	_mean_y -= dy / n;
+	_m2_x -= dx * (x - _mean_x);
+	_m2_y -= dy * (y - _mean_y);
+	_c_xy -= dx * (y - _mean_y);
 }
 
 
 //============================================================================
 void
-SumObserver::on_reset() noexcept
+RollingMoments::push(double x, double y) noexcept
 {
-	_input->on_reset();
-	if (_input->type() != ObserverType::Read)
+	// the ring is full once size reaches the lookback, head is then the oldest pair
+	auto slot = _head;
+	if (_size == _lookback) remove(_x_buffer[slot], _y_buffer[slot]);
+	_x_buffer[slot] = x;
+	_y_buffer[slot] = y;
+	_head = slot + 1 == _lookback ? 0 : slot + 1;
+	add(x, y);
+	// rounding in the updates random walks, an exact pass once per lap of the ring bounds it at O(1) amortized
+	if (!_head && _size == _lookback) recompute();
+}
+
+
+//============================================================================
+void
+RollingMoments::recompute() noexcept
+{
+	auto n = static_cast<double>(_size);
+	double sum_x = 0.0;
+	double sum_y = 0.0;
+	for (size_t i = 0; i < _size; i++)
 	{
-		_buffer.clear();
-		_buffer.resize(_lookback, 0.0f);
+		sum_x += _x_buffer[i];
+		sum_y += _y_buffer[i];
 	}
-	else if (_buffer.capacity())
+	_mean_x = sum_x / n;
+	_mean_y = sum_y / n;
+	_m2_x = _m2_y = _c_xy = 0.0;
+	for (size_t i = 0; i < _size; i++)
 	{
-		_buffer.clear();
-		_buffer.shrink_to_fit();
+		auto dx = _x_buffer[i] - _mean_x;
+		auto dy = _y_buffer[i] - _mean_y;
+		_m2_x += dx * dx;
+		_m2_y += dy * dy;
+		_c_xy += dx * dy;
 	}
-	_sum = 0.0f;
-	_count = 0;
-	_current_index = 0;
 }
 
 
 //============================================================================
-TsMaxObserver::TsMaxObserver(Asset const& asset, size_t lookback, UniquePtr<AssetObserver> input)
-	: AssetObserver(asset, ObserverType::TsArgMinMax), _lookback(lookback), _input(std::move(input)), _max(0.0)
+void
+RollingMoments::reset() noexcept
 {
+	_head = _size = 0;
+	_mean_x = _mean_y = _m2_x = _m2_y = _c_xy = 0.0;
+}
+
+
+//============================================================================
+SumObserver::SumObserver(Asset const& asset, size_t lookback, UniquePtr<AssetObserver> input)
+	: AssetObserver(asset, ObserverType::Sum), _lookback(std::max<size_t>(lookback, 1))
+{
+	add_input(std::move(input));
 	this->on_reset();
 }
 
 
 //============================================================================
 void
-TsMaxObserver::on_step() noexcept
+SumObserver::add(double v) noexcept
 {
-	_input->on_step();
-	auto v = _input->value();
-	if (v > _max)
-	{
-		_max = v;
-		_max_index = _current_index;
-	}
-	else if (_count >= _lookback - 1)
-	{
-		if (_current_index == _max_index)
-		{
-			_max = *std::max_element(_buffer.begin(), _buffer.end());
-		}
-	}
+	auto t = _sum + v;
+	if (std::abs(_sum) >= std::abs(v)) _compensation += (_sum - t) + v;
+	else _compensation += (v - t) + _sum;
+	_sum = t;
+}
+
+
+//============================================================================
+void
+SumObserver::on_step() noexcept
+{
+	// once the window is full the slot about to be written holds the value leaving it
+	auto v = input(0).value();
+	if (_count >= _lookback) add(-_buffer[_current_index]);
 	_buffer[_current_index] = v;
+	add(v);
 	_current_index = (_current_index + 1) % _lookback;
 	_count++;
 }
@@ -116,87 +241,129 @@ TsMaxObserver::on_step() noexcept
 
 //============================================================================
 void
-TsMaxObserver::on_reset() noexcept
+SumObserver::on_reset() noexcept
 {
-	_input->on_reset();
-	if (!_buffer.size())
-	{
-		_buffer.resize(_lookback, 0.0f);
-	}
-	else
-	{
-		std::fill(_buffer.begin(), _buffer.end(), 0.0f);
-	}
-	_max = 0.0f;
+	_buffer.assign(_lookback, 0.0);
+	_sum = 0.0;
+	_compensation = 0.0;
 	_count = 0;
 	_current_index = 0;
 }
 
 
 //============================================================================
-TsArgMaxObserver::TsArgMaxObserver(
-	Asset const& asset, size_t lookback, UniquePtr<AssetObserver> input)
-	: 
-	AssetObserver(asset, ObserverType::TsArgMinMax),
-	_lookback(lookback),
-	_input(std::move(input)),
-	_arg_index(0)
+size_t
+SumObserver::hash() const noexcept
+{
+	return hash_with_inputs({ _lookback });
+}
+
+
+//============================================================================
+MomentsObserver::MomentsObserver(
+	Asset const& asset, ObserverType type, size_t lookback, UniquePtr<AssetObserver> input)
+	: AssetObserver(asset, type), _moments(lookback)
 {
+	add_input(std::move(input));
 }
 
 
 //============================================================================
 void
-TsArgMaxObserver::on_step() noexcept
+MomentsObserver::on_step() noexcept
 {
-	_input->on_step();
-	auto v = _input->value();
-	if (v > _arg_value)
-	{
-		_arg_value = v;
-		_arg_index = _current_index;
-	}
-	else if (_count >= _lookback - 1)
-	{
-		// test if value about to be removed is the maximum value
-		if (_current_index == _arg_index)
-		{
-			auto iter = std::max_element(_buffer.begin(), _buffer.end());
-			_arg_value = *iter;
-			_arg_index = _current_index + std::distance(_buffer.begin(), iter);
-		}
-	}
-	_buffer[_current_index] = v;
-	_current_index = (_current_index + 1) % _lookback;
-	_count++;
+	_last = input(0).value();
+	if (std::isfinite(_last)) _moments.push(_last);
 }
 
 
 //============================================================================
 void
-TsArgMaxObserver::on_reset() noexcept
+MomentsObserver::on_reset() noexcept
 {
-	_input->on_reset();
-	if (!_buffer.size())
-	{
-		_buffer.resize(_lookback, 0.0f);
-	}
-	else
-	{
-		std::fill(_buffer.begin(), _buffer.end(), 0.0f);
-	}
-	_arg_value = 0.0f;
-	_count = 0;
-	_current_index = 0;
+	_moments.reset();
+	_last = 0.0;
+}
+
+
+//============================================================================
+size_t
+MomentsObserver::hash() const noexcept
+{
+	return hash_with_inputs({ _moments.lookback() });
 }
 
 
 //============================================================================
-size_t TsArgMaxObserver::hash() const noexcept 
+EmaObserver::EmaObserver(Asset const& asset, size_t lookback, UniquePtr<AssetObserver> input)
+	: AssetObserver(asset, ObserverType::Ema),
+	_lookback(std::max<size_t>(lookback, 1)),
+	_alpha(2.0 / (_lookback + 1.0))
 {
-	std::hash<size_t> type_hash = std::hash<size_t>();
-	std::hash<size_t> lookback_hash = std::hash<size_t>();
-	return type_hash(static_cast<size_t>(this->_type)) ^ lookback_hash(this->_lookback);
+	add_input(std::move(input));
+}
+
+
+//============================================================================
+void
+EmaObserver::on_step() noexcept
+{
+	auto v = input(0).value();
+	if (!std::isfinite(v)) return;
+	_ema = _seeded ? _ema + _alpha * (v - _ema) : v;
+	_seeded = true;
+}
+
+
+//============================================================================
+void
+EmaObserver::on_reset() noexcept
+{
+	_seeded = false;
+	_ema = 0.0;
+}
+
+
+//============================================================================
+size_t
+EmaObserver::hash() const noexcept
+{
+	return hash_with_inputs({ _lookback });
+}
+
+
+//============================================================================
+TsExtremumObserver::TsExtremumObserver(
+	Asset const& asset, ObserverType type, size_t lookback, UniquePtr<AssetObserver> input)
+	: AssetObserver(asset, type),
+	_window(lookback),
+	_sign(type == ObserverType::TsMin || type == ObserverType::TsArgMin ? -1.0 : 1.0)
+{
+	add_input(std::move(input));
+}
+
+
+//============================================================================
+void
+TsExtremumObserver::on_step() noexcept
+{
+	_window.push(_sign * input(0).value());
+}
+
+
+//============================================================================
+void
+TsExtremumObserver::on_reset() noexcept
+{
+	_window.reset();
+}
+
+
+//============================================================================
+size_t
+TsExtremumObserver::hash() const noexcept
+{
+	return hash_with_inputs({ _window.lookback() });
 }
 
 
@@ -256,9 +423,7 @@ void ReturnsVarianceObserver::on_reset() noexcept
 size_t
 ReturnsVarianceObserver::hash() const noexcept
 {
-	std::hash<size_t> type_hash = std::hash<size_t>();
-	std::hash<size_t> lookback_hash = std::hash<size_t>();
-	return type_hash(static_cast<size_t>(this->_type)) ^ lookback_hash(this->_lookback);
+	return hash_with_inputs({ _lookback });
 }
 
 
@@ -333,10 +498,7 @@ ReturnsCovarianceObserver::on_step() noexcept
 
 size_t ReturnsCovarianceObserver::hash() const noexcept
 {
-	std::hash<size_t> type_hash = std::hash<size_t>();
-	std::hash<size_t> child_hash = std::hash<size_t>();
-	std::hash<size_t> lookback_hash = std::hash<size_t>();
-	return type_hash(static_cast<size_t>(this->_type)) ^ child_hash(this->_child.get_index()) ^ lookback_hash(this->_lookback);
+	return hash_with_inputs({ _child.get_index(), _lookback, _step_size });
 }
 
 
@@ -374,9 +536,7 @@ AssetReadObserver::on_step() noexcept
 size_t
 AssetReadObserver::hash() const noexcept 
 {
-	std::hash<size_t> type_hash = std::hash<size_t>();
-	std::hash<size_t> col_hash = std::hash<size_t>();
-	return type_hash(static_cast<size_t>(this->_type)) ^ col_hash(this->_column);
+	return hash_with_inputs({ _column });
 }
 
 
@@ -390,66 +550,92 @@ ReturnsCovarianceObserver::set_pointers(double* upper_triangular_, double* lower
 
 
 //============================================================================
-CorrelationObserver::CorrelationObserver(
-	Asset const& parent,
+CoMomentsObserver::CoMomentsObserver(
+	Asset const& asset,
+	ObserverType type,
 	size_t lookback,
 	UniquePtr<AssetObserver> x_input,
 	UniquePtr<AssetObserver> y_input
-)	: AssetObserver(parent, ObserverType::Correlation), _lookback(lookback), _x_input(std::move(x_input)), _y_input(std::move(y_input))
+)	: AssetObserver(asset, type), _moments(std::max<size_t>(lookback, 2))
 {
-	if (_x_input->type() != ObserverType::Read)
-	{
-		_x_buffer.resize(_lookback, 0.0f);
-	}
-	if (_y_input->type() != ObserverType::Read)
-	{
-		_y_buffer.resize(_lookback, 0.0f);
-	}
+	add_input(std::move(x_input));
+	if (y_input) add_input(std::move(y_input));
 }
 
 
 //============================================================================
 void
-CorrelationObserver::on_reset() noexcept
+CoMomentsObserver::on_step() noexcept
 {
-	_sum_x = _sum_y = _sum_xy = _sum_x_squared = _sum_y_squared = 0.0;
-	_current_index = _count = 0;
-	_x_input->on_reset();
-	_y_input->on_reset();
-	if (_x_input->type() != ObserverType::Read)
+	if (inputs().size() == 2)
 	{
-		std::fill(_x_buffer.begin(), _x_buffer.end(), 0.0f);
+		auto x = input(0).value();
+		auto y = input(1).value();
+		if (std::isfinite(x) && std::isfinite(y)) _moments.push(x, y);
+		return;
 	}
-	else if (_x_buffer.capacity())
+	// rows are counted even when skipped so that a gap stretches the time axis of the fit
+	auto v = input(0).value();
+	if (std::isfinite(v)) _moments.push(static_cast<double>(_row), v);
+	_row++;
+}
+
+
+//============================================================================
+void
+CoMomentsObserver::on_reset() noexcept
+{
+	_moments.reset();
+	_row = 0;
+}
+
+
+//============================================================================
+size_t
+CoMomentsObserver::hash() const noexcept
+{
+	return hash_with_inputs({ _moments.lookback() });
+}
+
+
+//============================================================================
+std::expected<UniquePtr<AssetObserver>, AgisException>
+create_rolling_observer(
+	std::string const& type,
+	Asset const& asset,
+	size_t lookback,
+	std::vector<UniquePtr<AssetObserver>> inputs
+) noexcept
+{
+	auto itr = observer_type_map.find(type);
+	if (itr == observer_type_map.end())
 	{
-		_x_buffer.clear();
-		_x_buffer.shrink_to_fit();
+		return std::unexpected(AgisException("Unknown observer type: " + type));
 	}
-	if (_y_input->type() != ObserverType::Read)
+	bool pair = itr->second == ObserverType::Correlation || itr->second == ObserverType::Beta;
+	if (inputs.size() != (pair ? 2 : 1) || std::find(inputs.begin(), inputs.end(), nullptr) != inputs.end())
 	{
-		std::fill(_y_buffer.begin(), _y_buffer.end(), 0.0f);
+		return std::unexpected(AgisException("Observer " + type + " takes " + (pair ? "two inputs" : "one input")));
 	}
-	else if (_y_buffer.capacity())
+	auto& x = inputs[0];
+	switch (itr->second)
 	{
-		_y_buffer.clear();
-		_y_buffer.shrink_to_fit();
+		case ObserverType::Sum: return std::make_unique<SumObserver>(asset, lookback, std::move(x));
+		case ObserverType::Mean: return std::make_unique<MeanObserver>(asset, lookback, std::move(x));
+		case ObserverType::Variance: return std::make_unique<VarianceObserver>(asset, lookback, std::move(x));
+		case ObserverType::StdDev: return std::make_unique<StdDevObserver>(asset, lookback, std::move(x));
+		case ObserverType::ZScore: return std::make_unique<ZScoreObserver>(asset, lookback, std::move(x));
+		case ObserverType::Ema: return std::make_unique<EmaObserver>(asset, lookback, std::move(x));
+		case ObserverType::Slope: return std::make_unique<SlopeObserver>(asset, lookback, std::move(x));
+		case ObserverType::TsMax: return std::make_unique<TsMaxObserver>(asset, lookback, std::move(x));
+		case ObserverType::TsMin: return std::make_unique<TsMinObserver>(asset, lookback, std::move(x));
+		case ObserverType::TsArgMax: return std::make_unique<TsArgMaxObserver>(asset, lookback, std::move(x));
+		case ObserverType::TsArgMin: return std::make_unique<TsArgMinObserver>(asset, lookback, std::move(x));
+		case ObserverType::Correlation: return std::make_unique<CorrelationObserver>(asset, lookback, std::move(x), std::move(inputs[1]));
+		case ObserverType::Beta: return std::make_unique<BetaObserver>(asset, lookback, std::move(x), std::move(inputs[1]));
+		default: break;
 	}
-}
-
-
-//============================================================================
-void
-CorrelationObserver::on_step() noexcept
-{
-	_x_input->on_step();
-	_y_input->on_step();
-	auto x = _x_input->value();
-	auto y = _y_input->value();
-	_sum_x += x;
-	_sum_y += y;
-	_sum_xy += x * y;
-	_sum_x_squared += x * x;
-	_sum_y_squared += y * y;
+	return std::unexpected(AgisException("Observer " + type + " is not a rolling observer"));
 }
 
 
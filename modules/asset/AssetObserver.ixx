@@ -8,15 +8,25 @@ module;
 #endif
 
 #include "AgisDeclare.h"
+#include <ankerl/unordered_dense.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
 
 export module AssetObserverModule;
 
+import <expected>;
+import <initializer_list>;
+import <optional>;
 import <span>;
 import <string>;
 import <variant>;
 import <vector>;
 import <unordered_map>;
+import <utility>;
 
+import AgisError;
 import AgisPointersModule;
 
 namespace Agis
@@ -30,7 +40,15 @@ export enum ObserverType : uint16_t
 	Sum,
 	Correlation,
 	TsMax,
-	TsArgMinMax
+	TsArgMax,
+	TsMin,
+	TsArgMin,
+	Mean,
+	StdDev,
+	ZScore,
+	Ema,
+	Beta,
+	Slope
 };
 
 
@@ -38,8 +56,28 @@ extern AGIS_API std::unordered_map<std::string, ObserverType> observer_type_map;
 
 
 //============================================================================
+/// <summary>
+/// Mix value into a running observer hash
+/// </summary>
+export constexpr size_t observer_hash_combine(size_t seed, size_t value) noexcept
+{
+	uint64_t x = seed ^ (value + 0x9E3779B97F4A7C15ull + (seed << 6) + (seed >> 2));
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+	return static_cast<size_t>(x ^ (x >> 31));
+}
+
+
+//============================================================================
+/// <summary>
+/// Node of the observer graph of an asset. An observer reads the values of its inputs and never
+/// steps them itself, the graph steps every node once per row with inputs ahead of their readers.
+/// hash() is structural: the type, the parameters and the hashes of the inputs, so two observers
+/// with the same hash compute the same series and the graph keeps only one of them.
+/// </summary>
 export class AssetObserver
 {
+	friend class ObserverGraph;
 public:
 	AGIS_API AssetObserver(Asset const& asset, ObserverType t);
 	virtual ~AssetObserver() = default;
@@ -49,34 +87,254 @@ public:
 	virtual size_t hash() const noexcept = 0;
 	virtual double value() const noexcept = 0;
 
+	/// <summary>
+	/// True if the observer depends only on the rows of its asset and its inputs, so its whole series
+	/// can be computed ahead of the run
+	/// </summary>
+	virtual bool batchable() const noexcept { return true; }
+
 	ObserverType type() const noexcept { return _type; }
 	Asset const& asset() const { return _asset; }
+	std::span<AssetObserver* const> inputs() const noexcept { return _inputs; }
+
 protected:
+	/// <summary>
+	/// Take an input, the observer owns it until it joins a graph which may swap it for an identical
+	/// node that is already there
+	/// </summary>
+	AGIS_API void add_input(UniquePtr<AssetObserver> input) noexcept;
+	AssetObserver const& input(size_t i) const noexcept { return *_inputs[i]; }
+	AGIS_API size_t hash_with_inputs(std::initializer_list<size_t> params) const noexcept;
+
 	double const* _data_ptr;
 	Asset const& _asset;
 	ObserverType _type;
+
+private:
+	std::vector<AssetObserver*> _inputs;
+	std::vector<UniquePtr<AssetObserver>> _owned_inputs;
 };
 
 
 //============================================================================
-export class SumObserver : public AssetObserver
+/// <summary>
+/// The observers of one asset as a graph of unique nodes. Inserting an observer inserts its inputs
+/// first and merges every node with one already in the graph of the same structural hash, so the node
+/// list is in topological order and each distinct computation is stepped exactly once per row.
+/// </summary>
+export class ObserverGraph
 {
 public:
-	SumObserver(Asset const& asset, size_t lookback, UniquePtr<AssetObserver> input);
+	/// <summary>
+	/// Add observer and its inputs, returns the node that computes it which is an existing one if the
+	/// graph already held an identical observer
+	/// </summary>
+	AGIS_API AssetObserver* insert(UniquePtr<AssetObserver> observer) noexcept;
+	AGIS_API std::optional<AssetObserver const*> find(size_t hash) const noexcept;
+
+	/// <summary>
+	/// Remove nodes from the graph, none of them may be an input of a node that stays. Returns the
+	/// number of nodes removed.
+	/// </summary>
+	AGIS_API size_t erase(std::span<AssetObserver const* const> nodes) noexcept;
+
+	/// <summary>
+	/// Position of the node with hash in step order
+	/// </summary>
+	std::optional<size_t> slot(size_t hash) const noexcept
+	{
+		auto itr = _index.find(hash);
+		if (itr == _index.end()) return std::nullopt;
+		return itr->second;
+	}
+	AssetObserver const& node(size_t slot) const noexcept { return *_nodes[slot]; }
+	bool batchable() const noexcept
+	{
+		for (auto const& node : _nodes) if (!node->batchable()) return false;
+		return true;
+	}
+
+	void step() noexcept
+	{
+		for (auto& node : _nodes) node->on_step();
+	}
+
+	void reset() noexcept
+	{
+		for (auto& node : _nodes) node->on_reset();
+	}
+
+	size_t size() const noexcept { return _nodes.size(); }
+	bool empty() const noexcept { return _nodes.empty(); }
+
 private:
+	std::vector<UniquePtr<AssetObserver>> _nodes;
+	ankerl::unordered_dense::map<size_t, size_t> _index;
+};
+
 
+//============================================================================
+/// <summary>
+/// Mean, variance and co-moment of the last lookback pairs pushed. Each push removes the pair leaving
+/// the window and adds the new one with Welford's updates, so the moments stay centered on the window
+/// mean instead of being taken as a difference of large running sums, and every lap of the ring they
+/// are taken again exactly so rounding can not build up. Single series push y = 0.
+/// </summary>
+export class RollingMoments
+{
+public:
+	AGIS_API explicit RollingMoments(size_t lookback);
+	AGIS_API void push(double x, double y = 0.0) noexcept;
+	AGIS_API void reset() noexcept;
+
+	size_t size() const noexcept { return _size; }
+	size_t lookback() const noexcept { return _lookback; }
+	double mean_x() const noexcept { return _mean_x; }
+	double mean_y() const noexcept { return _mean_y; }
+
+	/// <summary>
+	/// Sample variances and covariance over the window, 0 until it holds two pairs
+	/// </summary>
+	double variance_x() const noexcept { return _size > 1 ? std::max(_m2_x, 0.0) / (_size - 1) : 0.0; }
+	double variance_y() const noexcept { return _size > 1 ? std::max(_m2_y, 0.0) / (_size - 1) : 0.0; }
+	double covariance() const noexcept { return _size > 1 ? _c_xy / (_size - 1) : 0.0; }
+
+private:
+	void add(double x, double y) noexcept;
+	void remove(double x, double y) noexcept;
+	void recompute() noexcept;
+
+	size_t _lookback;
+	size_t _head = 0;
+	size_t _size = 0;
+	double _mean_x = 0.0;
+	double _mean_y = 0.0;
+	double _m2_x = 0.0;
+	double _m2_y = 0.0;
+	double _c_xy = 0.0;
+	std::vector<double> _x_buffer;
+	std::vector<double> _y_buffer;
+};
+
+
+//============================================================================
+/// <summary>
+/// Rolling sum of the input over the last lookback rows with Neumaier compensation, the value
+/// leaving the window is subtracted through the same compensated add
+/// </summary>
+export class SumObserver : public AssetObserver
+{
+public:
+	AGIS_API SumObserver(Asset const& asset, size_t lookback, UniquePtr<AssetObserver> input);
 	void on_step() noexcept override;
 	void on_reset() noexcept override;
+	size_t warmup() const noexcept override { return _lookback; }
+	size_t hash() const noexcept override;
+	double value() const noexcept override { return _sum + _compensation; }
+
+private:
+	void add(double v) noexcept;
 
-	UniquePtr<AssetObserver> _input;
 	size_t _lookback;
 	size_t _current_index = 0;
 	size_t _count = 0;
 	double _sum = 0.0;
+	double _compensation = 0.0;
 	std::vector<double> _buffer;
 };
 
 
+//============================================================================
+/// <summary>
+/// Moments of the input over the last lookback rows. Rows where the input is not finite are
+/// skipped, the window holds the last lookback finite values.
+/// </summary>
+export class MomentsObserver : public AssetObserver
+{
+public:
+	void on_step() noexcept override;
+	void on_reset() noexcept override;
+	size_t warmup() const noexcept override { return _moments.lookback(); }
+	size_t hash() const noexcept override;
+
+protected:
+	AGIS_API MomentsObserver(Asset const& asset, ObserverType type, size_t lookback, UniquePtr<AssetObserver> input);
+
+	RollingMoments _moments;
+	double _last = 0.0;
+};
+
+
+//============================================================================
+export class MeanObserver : public MomentsObserver
+{
+public:
+	AGIS_API MeanObserver(Asset const& asset, size_t lookback, UniquePtr<AssetObserver> input)
+		: MomentsObserver(asset, ObserverType::Mean, lookback, std::move(input)) {}
+	double value() const noexcept override { return _moments.mean_x(); }
+};
+
+
+//============================================================================
+export class VarianceObserver : public MomentsObserver
+{
+public:
+	AGIS_API VarianceObserver(Asset const& asset, size_t lookback, UniquePtr<AssetObserver> input)
+		: MomentsObserver(asset, ObserverType::Variance, lookback, std::move(input)) {}
+	double value() const noexcept override { return _moments.variance_x(); }
+};
+
+
+//============================================================================
+export class StdDevObserver : public MomentsObserver
+{
+public:
+	AGIS_API StdDevObserver(Asset const& asset, size_t lookback, UniquePtr<AssetObserver> input)
+		: MomentsObserver(asset, ObserverType::StdDev, lookback, std::move(input)) {}
+	double value() const noexcept override { return std::sqrt(_moments.variance_x()); }
+};
+
+
+//============================================================================
+/// <summary>
+/// Distance of the current input from the window mean in window standard deviations, 0 while the
+/// window has no spread
+/// </summary>
+export class ZScoreObserver : public MomentsObserver
+{
+public:
+	AGIS_API ZScoreObserver(Asset const& asset, size_t lookback, UniquePtr<AssetObserver> input)
+		: MomentsObserver(asset, ObserverType::ZScore, lookback, std::move(input)) {}
+	double value() const noexcept override
+	{
+		auto stddev = std::sqrt(_moments.variance_x());
+		return stddev > 0.0 ? (_last - _moments.mean_x()) / stddev : 0.0;
+	}
+};
+
+
+//============================================================================
+/// <summary>
+/// Exponential moving average with alpha = 2 / (lookback + 1), seeded with the first finite input
+/// </summary>
+export class EmaObserver : public AssetObserver
+{
+public:
+	AGIS_API EmaObserver(Asset const& asset, size_t lookback, UniquePtr<AssetObserver> input);
+	void on_step() noexcept override;
+	void on_reset() noexcept override;
+	size_t warmup() const noexcept override { return _lookback; }
+	size_t hash() const noexcept override;
+	double value() const noexcept override { return _ema; }
+
+private:
+	size_t _lookback;
+	double _alpha;
+	bool _seeded = false;
+	double _ema = 0.0;
+};
+
+
 //============================================================================
 export class AssetReadObserver : public AssetObserver
 {
@@ -98,82 +356,230 @@ private:
 
 
 //============================================================================
-export class TsMaxObserver : public AssetObserver
+/// <summary>
+/// Maximum of the last lookback values pushed, kept as a monotonic deque in a fixed ring. The deque
+/// holds the rows that can still become the maximum in decreasing order of value, a push drops the
+/// row leaving the window from the front and every smaller value from the back, so each row is
+/// added and removed once and a push is O(1) amortized. Ties keep the earliest row. A NaN takes
+/// its row in the window but is never the maximum. Push negated values for a minimum.
+/// </summary>
+export class RollingExtremum
 {
 public:
-	TsMaxObserver(Asset const& asset, size_t lookback, UniquePtr<AssetObserver> input);
-	void on_step() noexcept override;
-	void on_reset() noexcept override;
-	size_t warmup() const noexcept override { return _lookback; }
-	double value() const noexcept override { return _max; }
+	explicit RollingExtremum(size_t lookback)
+		: _lookback(lookback ? lookback : 1), _rows(_lookback), _values(_lookback)
+	{
+	}
+
+	inline void push(double v) noexcept
+	{
+		if (_size && _rows[_head] + _lookback <= _count)
+		{
+			_head = wrap(_head + 1);
+			_size--;
+		}
+		if (!std::isnan(v))
+		{
+			while (_size && _values[wrap(_head + _size - 1)] < v) _size--;
+			auto slot = wrap(_head + _size);
+			_rows[slot] = _count;
+			_values[slot] = v;
+			_size++;
+		}
+		_count++;
+	}
+
+	void reset() noexcept { _head = _size = _count = 0; }
+
+	/// <summary>
+	/// Maximum of the window, NaN while the window holds no value
+	/// </summary>
+	double value() const noexcept { return _size ? _values[_head] : std::numeric_limits<double>::quiet_NaN(); }
+
+	/// <summary>
+	/// Rows since the maximum was pushed, 0 when it is the latest value, NaN while the window holds no value
+	/// </summary>
+	double age() const noexcept
+	{
+		return _size ? static_cast<double>(_count - 1 - _rows[_head]) : std::numeric_limits<double>::quiet_NaN();
+	}
+
+	size_t lookback() const noexcept { return _lookback; }
+	size_t count() const noexcept { return _count; }
 
 private:
-	UniquePtr<AssetObserver> _input;
+	size_t wrap(size_t i) const noexcept { return i >= _lookback ? i - _lookback : i; }
+
 	size_t _lookback;
-	size_t _current_index = 0;
-	size_t _max_index = 0;
+	size_t _head = 0;
+	size_t _size = 0;
 	size_t _count = 0;
-	double _max = 0.0;
-	std::vector<double> _buffer;
+	std::vector<size_t> _rows;
+	std::vector<double> _values;
 };
 
 
 //============================================================================
-export class TsArgMaxObserver : public AssetObserver
+/// <summary>
+/// Rolling extremum of the input over the last lookback rows. Minima track the maximum of the
+/// negated input. The arg observers report the number of rows since the extremum, 0 when it is
+/// the current row.
+/// </summary>
+export class TsExtremumObserver : public AssetObserver
 {
 public:
-	AGIS_API TsArgMaxObserver(
-		Asset const& asset,
-		size_t lookback,
-		UniquePtr<AssetObserver> input
-	);
 	void on_step() noexcept override;
 	void on_reset() noexcept override;
-	size_t warmup() const noexcept override { return _lookback; }
+	size_t warmup() const noexcept override { return _window.lookback(); }
 	size_t hash() const noexcept override;
-	double value() const noexcept override { return static_cast<double>(_arg_index); }
 
-private:
-	UniquePtr<AssetObserver> _input;
-	size_t _lookback;
-	size_t _current_index = 0;
-	size_t _count = 0;
-	size_t _arg_index = 0;
-	double _arg_value = 0.0f;
-	std::vector<double> _buffer;
+protected:
+	AGIS_API TsExtremumObserver(Asset const& asset, ObserverType type, size_t lookback, UniquePtr<AssetObserver> input);
+
+	RollingExtremum _window;
+	double _sign;
 };
 
 
 //============================================================================
-export class CorrelationObserver : public AssetObserver
+export class TsMaxObserver : public TsExtremumObserver
 {
 public:
-	CorrelationObserver(
-		Asset const& parent,
+	AGIS_API TsMaxObserver(Asset const& asset, size_t lookback, UniquePtr<AssetObserver> input)
+		: TsExtremumObserver(asset, ObserverType::TsMax, lookback, std::move(input)) {}
+	double value() const noexcept override { return _window.value(); }
+};
+
+
+//============================================================================
+export class TsMinObserver : public TsExtremumObserver
+{
+public:
+	AGIS_API TsMinObserver(Asset const& asset, size_t lookback, UniquePtr<AssetObserver> input)
+		: TsExtremumObserver(asset, ObserverType::TsMin, lookback, std::move(input)) {}
+	double value() const noexcept override { return -_window.value(); }
+};
+
+
+//============================================================================
+export class TsArgMaxObserver : public TsExtremumObserver
+{
+public:
+	AGIS_API TsArgMaxObserver(Asset const& asset, size_t lookback, UniquePtr<AssetObserver> input)
+		: TsExtremumObserver(asset, ObserverType::TsArgMax, lookback, std::move(input)) {}
+	double value() const noexcept override { return _window.age(); }
+};
+
+
+//============================================================================
+export class TsArgMinObserver : public TsExtremumObserver
+{
+public:
+	AGIS_API TsArgMinObserver(Asset const& asset, size_t lookback, UniquePtr<AssetObserver> input)
+		: TsExtremumObserver(asset, ObserverType::TsArgMin, lookback, std::move(input)) {}
+	double value() const noexcept override { return _window.age(); }
+};
+
+
+//============================================================================
+/// <summary>
+/// Co-moments of two series over the last lookback rows where both are finite. The pair observers
+/// push (x_input, y_input), the slope pushes (row, input) to regress the input on time.
+/// </summary>
+export class CoMomentsObserver : public AssetObserver
+{
+public:
+	void on_step() noexcept override;
+	void on_reset() noexcept override;
+	size_t warmup() const noexcept override { return _moments.lookback(); }
+	size_t hash() const noexcept override;
+
+protected:
+	AGIS_API CoMomentsObserver(
+		Asset const& asset,
+		ObserverType type,
 		size_t lookback,
 		UniquePtr<AssetObserver> x_input,
-		UniquePtr<AssetObserver> y_input
+		UniquePtr<AssetObserver> y_input = nullptr
 	);
-	void on_step() noexcept override;
-	void on_reset() noexcept override;
-	size_t warmup() const noexcept override { return _lookback; }
-	
-private:
-	UniquePtr<AssetObserver> _x_input;
-	UniquePtr<AssetObserver> _y_input;
-	size_t _lookback;
-	size_t _count = 0;
-	size_t _current_index = 0;
-	double _sum_x;
-	double _sum_y;
-	double _sum_xy;
-	double _sum_x_squared;
-	double _sum_y_squared;
-	std::vector<double> _x_buffer;
-	std::vector<double> _y_buffer;
+
+	RollingMoments _moments;
+	size_t _row = 0;
+};
+
+
+//============================================================================
+export class CorrelationObserver : public CoMomentsObserver
+{
+public:
+	AGIS_API CorrelationObserver(
+		Asset const& asset,
+		size_t lookback,
+		UniquePtr<AssetObserver> x_input,
+		UniquePtr<AssetObserver> y_input
+	) : CoMomentsObserver(asset, ObserverType::Correlation, lookback, std::move(x_input), std::move(y_input)) {}
+
+	double value() const noexcept override
+	{
+		auto var = _moments.variance_x() * _moments.variance_y();
+		return var > 0.0 ? _moments.covariance() / std::sqrt(var) : 0.0;
+	}
+};
+
+
+//============================================================================
+/// <summary>
+/// Beta of x_input on y_input, typically an asset's returns on a market's, cov(x, y) / var(y)
+/// </summary>
+export class BetaObserver : public CoMomentsObserver
+{
+public:
+	AGIS_API BetaObserver(
+		Asset const& asset,
+		size_t lookback,
+		UniquePtr<AssetObserver> x_input,
+		UniquePtr<AssetObserver> y_input
+	) : CoMomentsObserver(asset, ObserverType::Beta, lookback, std::move(x_input), std::move(y_input)) {}
+
+	double value() const noexcept override
+	{
+		auto var = _moments.variance_y();
+		return var > 0.0 ? _moments.covariance() / var : 0.0;
+	}
+};
+
+
+//============================================================================
+/// <summary>
+/// Least squares slope of the input against its row number, the change per row of the linear fit
+/// </summary>
+export class SlopeObserver : public CoMomentsObserver
+{
+public:
+	AGIS_API SlopeObserver(Asset const& asset, size_t lookback, UniquePtr<AssetObserver> input)
+		: CoMomentsObserver(asset, ObserverType::Slope, lookback, std::move(input)) {}
+
+	double value() const noexcept override
+	{
+		auto var = _moments.variance_x();
+		return var > 0.0 ? _moments.covariance() / var : 0.0;
+	}
 };
 
 
+//============================================================================
+/// <summary>
+/// Build a rolling observer by its name in observer_type_map. Pair observers take two inputs, the
+/// others one.
+/// </summary>
+export AGIS_API std::expected<UniquePtr<AssetObserver>, AgisException> create_rolling_observer(
+	std::string const& type,
+	Asset const& asset,
+	size_t lookback,
+	std::vector<UniquePtr<AssetObserver>> inputs
+) noexcept;
+
+
 //============================================================================
 export class ReturnsVarianceObserver : public AssetObserver
 {
@@ -184,10 +590,11 @@ public:
 	size_t warmup() const noexcept override { return _lookback; }
 	size_t hash() const noexcept override;
 	double value() const noexcept override { return _variance; }
+	bool batchable() const noexcept override { return false; }
 	void set_pointer(double* diagonal_ptr) { _diagnoal_ptr = diagonal_ptr; }
 
 private:
-	StridedPointer<double const> _span;
+	StridedColumn _span;
 	size_t _count = 0;
 	size_t _close_column_index;
 	size_t _lookback;
@@ -223,10 +630,11 @@ private:
 	size_t warmup() const noexcept override { return _lookback; }
 	size_t hash() const noexcept override;
 	double value() const noexcept override { return _covariance; }
+	bool batchable() const noexcept override { return false; }
 
 	Asset const& _child;
-	StridedPointer<double const> _enclosing_span;
-	StridedPointer<double const> _child_span;
+	StridedColumn _enclosing_span;
+	StridedColumn _child_span;
 	size_t _enclosing_span_start_index;
 	size_t _index = 0;
 	size_t _lookback;
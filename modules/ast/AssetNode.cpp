@@ -12,6 +12,7 @@ import AssetModule;
 import ExchangeModule;
 import ExchangeNode;
 import AssetObserverModule;
+import CrossSectionModule;
 
 #define AGIS_NAN std::numeric_limits<double>::quiet_NaN()
 
@@ -54,10 +55,29 @@ AssetObserverNode::AssetObserverNode(size_t observer_hash, SharedPtr<ExchangeNod
 std::optional<double>
 AssetObserverNode::evaluate(Asset const* asset) const noexcept
 {
-	return (*asset->get_observer(_observer_hash))->value();
+	return asset->get_observer_value(_observer_hash);
 }
 
 
+//==================================================================================================
+AssetWindowNode::AssetWindowNode(CrossSectionEngine const* engine, size_t slot, size_t exchange_offset, RollingStat stat) noexcept
+	: AssetLambdaNode(NodeType::AssetWindow),
+	_engine(engine),
+	_slot(slot),
+	_exchange_offset(exchange_offset),
+	_stat(stat)
+{
+	this->set_warmup(engine->lookback(slot));
+}
+
+
+//==================================================================================================
+std::optional<double>
+AssetWindowNode::evaluate(Asset const* asset) const noexcept
+{
+	return _engine->value(_slot, asset->get_index() - _exchange_offset, _stat);
+}
+
 
 //============================================================================
 std::optional<double>
@@ -14,6 +14,7 @@ import <string>;
 import <variant>;
 
 import BaseNode;
+import CrossSectionModule;
 
 namespace Agis
 {
@@ -73,7 +74,7 @@ private:
 export class AssetObserverNode final: public AssetLambdaNode
 {
 public:
-	AssetObserverNode(size_t observer_hash, SharedPtr<ExchangeNode> e);
+	AGIS_API AssetObserverNode(size_t observer_hash, SharedPtr<ExchangeNode> e);
 	AGIS_API ~AssetObserverNode() = default;
 
 	AGIS_API std::optional<double> evaluate(Asset const* asset) const noexcept override;
@@ -84,6 +85,26 @@ private:
 };
 
 
+//==================================================================================================
+/// <summary>
+/// Reads a rolling window statistic of the asset from its exchange's cross section engine
+/// </summary>
+export class AssetWindowNode final: public AssetLambdaNode
+{
+public:
+	AssetWindowNode(CrossSectionEngine const* engine, size_t slot, size_t exchange_offset, RollingStat stat) noexcept;
+	AGIS_API ~AssetWindowNode() = default;
+
+	AGIS_API std::optional<double> evaluate(Asset const* asset) const noexcept override;
+
+private:
+	CrossSectionEngine const* _engine;
+	size_t _slot;
+	size_t _exchange_offset;
+	RollingStat _stat;
+};
+
+
 //==================================================================================================
 export class AssetOpperationNode : public AssetLambdaNode
 {
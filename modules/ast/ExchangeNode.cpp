@@ -57,6 +57,16 @@ std::optional<UniquePtr<AssetLambdaReadNode>>
 }
 
 
+//==================================================================================================
+std::optional<UniquePtr<AssetWindowNode>>
+	ExchangeNode::create_asset_window_node(size_t slot, RollingStat stat) const noexcept
+{
+	auto engine = _exchange->get_cross_section();
+	if (!engine || slot >= engine->window_count()) return std::nullopt;
+	return std::make_unique<AssetWindowNode>(engine, slot, _exchange->get_index_offset(), stat);
+}
+
+
 //==================================================================================================
 std::expected<Eigen::VectorXd const*, AgisException>
 ExchangeViewNode::evaluate() noexcept
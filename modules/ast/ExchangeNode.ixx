@@ -18,6 +18,7 @@ import <expected>;
 
 import BaseNode;
 import AgisError;
+import CrossSectionModule;
 
 namespace Agis
 {
@@ -41,6 +42,11 @@ public:
 
 	AGIS_API std::optional<UniquePtr<AssetLambdaReadNode>> create_asset_lambda_read_node(std::string const&, int) const noexcept;
 
+	/// <summary>
+	/// Node reading stat of the window the exchange registered at slot, empty if there is no such window
+	/// </summary>
+	AGIS_API std::optional<UniquePtr<AssetWindowNode>> create_asset_window_node(size_t slot, RollingStat stat) const noexcept;
+
 private:
 	Exchange const* _exchange;
 
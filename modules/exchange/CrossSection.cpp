@@ -0,0 +1,285 @@
+module;
+
+#include <Eigen/Dense>
+#include "AgisDeclare.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+module CrossSectionModule;
+
+import AssetModule;
+import AgisTypes;
+
+namespace Agis
+{
+
+//============================================================================
+CrossSectionEngine::CrossSectionEngine(size_t asset_count)
+	: _asset_count(asset_count), _scratch(asset_count, 0.0)
+{
+}
+
+
+//============================================================================
+size_t
+CrossSectionEngine::add_window(size_t column, size_t lookback) noexcept
+{
+	lookback = std::max<size_t>(lookback, 1);
+	auto column_itr = std::find(_columns.begin(), _columns.end(), column);
+	auto column_slot = static_cast<size_t>(column_itr - _columns.begin());
+	for (size_t slot = 0; slot < _windows.size(); slot++)
+	{
+		if (_windows[slot].column_slot == column_slot && _windows[slot].lookback == lookback) return slot;
+	}
+	if (column_itr == _columns.end())
+	{
+		_columns.push_back(column);
+		_inputs.resize(_columns.size() * _asset_count, 0.0);
+	}
+	Window window;
+	window.column_slot = column_slot;
+	window.lookback = lookback;
+	window.counts.assign(_asset_count, 0);
+	window.means.assign(_asset_count, 0.0);
+	window.m2s.assign(_asset_count, 0.0);
+	window.ring.assign(lookback * _asset_count, 0.0);
+	_windows.push_back(std::move(window));
+	return _windows.size() - 1;
+}
+
+
+//============================================================================
+void
+CrossSectionEngine::gather(std::vector<UniquePtr<Asset>> const& assets, std::span<uint32_t const> advanced) noexcept
+{
+	constexpr auto nan = std::numeric_limits<double>::quiet_NaN();
+	for (size_t k = 0; k < _columns.size(); k++)
+	{
+		auto column = _columns[k];
+		auto inputs = _inputs.data() + k * _asset_count;
+		for (auto position : advanced)
+		{
+			inputs[position] = assets[position]->get_asset_feature(column, 0).value_or(nan);
+		}
+	}
+}
+
+
+//============================================================================
+void
+CrossSectionEngine::recompute(Window& window, size_t position) noexcept
+{
+	// the held values sit in ring rows 0 to size - 1, summed in ring order as RollingMoments does
+	auto size = std::min(window.counts[position], window.lookback);
+	double sum = 0.0;
+	for (size_t row = 0; row < size; row++) sum += window.ring[row * _asset_count + position];
+	auto mean = size ? sum / static_cast<double>(size) : 0.0;
+	double m2 = 0.0;
+	for (size_t row = 0; row < size; row++)
+	{
+		auto dx = window.ring[row * _asset_count + position] - mean;
+		m2 += dx * dx;
+	}
+	window.means[position] = mean;
+	window.m2s[position] = m2;
+}
+
+
+//============================================================================
+void
+CrossSectionEngine::push(Window& window, size_t position, double v) noexcept
+{
+	// the same updates as RollingMoments::push, the slot about to be written holds the value leaving
+	// a full window
+	auto count = window.counts[position];
+	auto size = std::min(count, window.lookback);
+	auto& slot = window.ring[(count % window.lookback) * _asset_count + position];
+	auto& mean = window.means[position];
+	auto& m2 = window.m2s[position];
+	if (size == window.lookback)
+	{
+		auto old = slot;
+		size--;
+		if (!size)
+		{
+			mean = m2 = 0.0;
+		}
+		else
+		{
+			auto dx = old - mean;
+			mean -= dx / static_cast<double>(size);
+			m2 -= dx * (old - mean);
+		}
+	}
+	slot = v;
+	size++;
+	auto dx = v - mean;
+	mean += dx / static_cast<double>(size);
+	m2 += dx * (v - mean);
+	window.counts[position] = ++count;
+	if (count % window.lookback == 0) recompute(window, position);
+}
+
+
+//============================================================================
+void
+CrossSectionEngine::step_aligned(Window& window) noexcept
+{
+	// every asset is on the same ring row, so the slot leaving the window is one contiguous row and
+	// the Welford updates of push run over all assets at once
+	using ArrayMap = Eigen::Map<Eigen::ArrayXd>;
+	auto n = static_cast<Eigen::Index>(_asset_count);
+	auto count = window.counts.front();
+	auto size = std::min(count, window.lookback);
+	Eigen::Map<Eigen::ArrayXd const> x(_inputs.data() + window.column_slot * _asset_count, n);
+	ArrayMap means(window.means.data(), n);
+	ArrayMap m2s(window.m2s.data(), n);
+	ArrayMap oldest(window.ring.data() + (count % window.lookback) * _asset_count, n);
+	ArrayMap dx(_scratch.data(), n);
+	if (size == window.lookback)
+	{
+		size--;
+		if (!size)
+		{
+			means.setZero();
+			m2s.setZero();
+		}
+		else
+		{
+			dx = oldest - means;
+			means -= dx / static_cast<double>(size);
+			m2s -= dx * (oldest - means);
+		}
+	}
+	oldest = x;
+	size++;
+	dx = x - means;
+	means += dx / static_cast<double>(size);
+	m2s += dx * (x - means);
+	count++;
+	std::fill(window.counts.begin(), window.counts.end(), count);
+	if (count % window.lookback) return;
+
+	// a full lap of the ring, take the moments again exactly in the same order as recompute
+	means.setZero();
+	for (size_t row = 0; row < window.lookback; row++)
+	{
+		means += ArrayMap(window.ring.data() + row * _asset_count, n);
+	}
+	means /= static_cast<double>(window.lookback);
+	m2s.setZero();
+	for (size_t row = 0; row < window.lookback; row++)
+	{
+		dx = ArrayMap(window.ring.data() + row * _asset_count, n) - means;
+		m2s += dx * dx;
+	}
+}
+
+
+//============================================================================
+void
+CrossSectionEngine::step_sparse(Window& window, std::span<uint32_t const> advanced) noexcept
+{
+	auto x = _inputs.data() + window.column_slot * _asset_count;
+	for (auto position : advanced)
+	{
+		auto v = x[position];
+		if (std::isfinite(v)) push(window, position, v);
+	}
+}
+
+
+//============================================================================
+void
+CrossSectionEngine::step(std::vector<UniquePtr<Asset>> const& assets, std::span<uint32_t const> advanced) noexcept
+{
+	if (advanced.empty() || _windows.empty()) return;
+	gather(assets, advanced);
+	bool dense = advanced.size() == _asset_count;
+	for (auto& window : _windows)
+	{
+		if (dense && !window.aligned)
+		{
+			// assets that listed late or skipped rows can line up again, check only when it could pay off
+			auto const& counts = window.counts;
+			window.aligned = std::all_of(counts.begin(), counts.end(), [&](size_t c) { return c == counts.front(); });
+		}
+		if (dense && window.aligned)
+		{
+			auto n = static_cast<Eigen::Index>(_asset_count);
+			Eigen::Map<Eigen::ArrayXd const> x(_inputs.data() + window.column_slot * _asset_count, n);
+			if (x.isFinite().all())
+			{
+				step_aligned(window);
+				continue;
+			}
+		}
+		window.aligned = false;
+		step_sparse(window, advanced);
+	}
+}
+
+
+//============================================================================
+void
+CrossSectionEngine::restore(std::vector<UniquePtr<Asset>> const& assets) noexcept
+{
+	// a window only depends on the last lookback finite values of its asset, read them back from the
+	// panel into the ring rows stepping would have put them in
+	reset();
+	for (size_t position = 0; position < _asset_count; position++)
+	{
+		auto const& asset = assets[position];
+		auto rows = asset->cursor().current_index;
+		auto cols = asset->columns();
+		auto data = asset->get_data();
+		auto data32 = asset->get_data32();
+		bool is_float = asset->get_precision() == StoragePrecision::FLOAT32;
+		for (auto& window : _windows)
+		{
+			auto column = _columns[window.column_slot];
+			auto read = [&](size_t row) {
+				auto index = row * cols + column;
+				return is_float ? static_cast<double>(data32[index]) : data[index];
+			};
+			size_t count = 0;
+			for (size_t row = 0; row < rows; row++)
+			{
+				if (std::isfinite(read(row))) count++;
+			}
+			auto taken = count;
+			for (auto row = rows; row-- > 0 && count - taken < window.lookback;)
+			{
+				auto v = read(row);
+				if (!std::isfinite(v)) continue;
+				taken--;
+				window.ring[(taken % window.lookback) * _asset_count + position] = v;
+			}
+			window.counts[position] = count;
+			recompute(window, position);
+		}
+	}
+	for (auto& window : _windows)
+	{
+		auto const& counts = window.counts;
+		window.aligned = std::all_of(counts.begin(), counts.end(), [&](size_t c) { return c == counts.front(); });
+	}
+}
+
+
+//============================================================================
+void
+CrossSectionEngine::reset() noexcept
+{
+	for (auto& window : _windows)
+	{
+		std::fill(window.counts.begin(), window.counts.end(), 0);
+		std::fill(window.means.begin(), window.means.end(), 0.0);
+		std::fill(window.m2s.begin(), window.m2s.end(), 0.0);
+		std::fill(window.ring.begin(), window.ring.end(), 0.0);
+		window.aligned = true;
+	}
+}
+
+}
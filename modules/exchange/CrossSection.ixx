@@ -0,0 +1,142 @@
+module;
+
+#pragma once
+#ifdef AGISCORE_EXPORTS
+#define AGIS_API __declspec(dllexport)
+#else
+#define AGIS_API __declspec(dllimport)
+#endif
+
+#include "AgisDeclare.h"
+#include <cmath>
+#include <cstdint>
+
+export module CrossSectionModule;
+
+import <optional>;
+import <span>;
+import <vector>;
+
+namespace Agis
+{
+
+//============================================================================
+/// <summary>
+/// Statistic read from a rolling window of the cross section engine
+/// </summary>
+export enum class RollingStat : uint8_t
+{
+	SUM,
+	MEAN,
+	VARIANCE,
+	STDDEV
+};
+
+
+//============================================================================
+/// <summary>
+/// Rolling windows over one column of every asset of an exchange, kept as struct of arrays. Each
+/// window holds the mean and centered sum of squares of all assets in two contiguous arrays and a
+/// ring of the last lookback values laid out [lookback][asset]. Values that are not finite are
+/// skipped, so a window holds the asset's last lookback finite values, and the moments follow the
+/// same Welford updates and once per lap exact pass as a MomentsObserver over the column. While
+/// every asset of a window has taken the same number of values, all assets share one ring row and
+/// a step is a single vectorized pass, once a missing row or a skipped value leaves some assets
+/// behind the window falls back to updating only the assets that printed.
+/// </summary>
+export class CrossSectionEngine
+{
+public:
+	AGIS_API explicit CrossSectionEngine(size_t asset_count);
+
+	/// <summary>
+	/// Add a window of lookback rows over column and return its slot, a window already registered
+	/// with the same column and lookback is shared
+	/// </summary>
+	AGIS_API size_t add_window(size_t column, size_t lookback) noexcept;
+
+	/// <summary>
+	/// Feed the current row of every asset that advanced on this exchange step, by asset position
+	/// </summary>
+	void step(std::vector<UniquePtr<Asset>> const& assets, std::span<uint32_t const> advanced) noexcept;
+
+	/// <summary>
+	/// Rebuild every window from the rows each asset has already stepped over, after its cursor moved
+	/// </summary>
+	void restore(std::vector<UniquePtr<Asset>> const& assets) noexcept;
+	void reset() noexcept;
+
+	/// <summary>
+	/// Statistic of the window at slot for the asset at position, over the finite values seen so far
+	/// up to the lookback. Empty until the window holds a value of the asset.
+	/// </summary>
+	inline std::optional<double> value(size_t slot, size_t position, RollingStat stat) const noexcept
+	{
+		auto const& window = _windows[slot];
+		auto count = window.counts[position];
+		if (!count) return std::nullopt;
+		auto n = static_cast<double>(count < window.lookback ? count : window.lookback);
+		auto mean = window.means[position];
+		switch (stat)
+		{
+			case RollingStat::SUM: return mean * n;
+			case RollingStat::MEAN: return mean;
+			default: break;
+		}
+		auto m2 = window.m2s[position];
+		auto variance = n > 1.0 && m2 > 0.0 ? m2 / (n - 1.0) : 0.0;
+		return stat == RollingStat::VARIANCE ? variance : std::sqrt(variance);
+	}
+
+	size_t lookback(size_t slot) const noexcept { return _windows[slot].lookback; }
+	size_t window_count() const noexcept { return _windows.size(); }
+	size_t asset_count() const noexcept { return _asset_count; }
+
+	/// <summary>
+	/// True while every window has taken the same number of values for every asset and steps take
+	/// the vectorized path
+	/// </summary>
+	bool aligned() const noexcept
+	{
+		for (auto const& window : _windows)
+		{
+			if (!window.aligned) return false;
+		}
+		return true;
+	}
+
+private:
+	struct Window
+	{
+		size_t column_slot;
+		size_t lookback;
+
+		/// <summary>
+		/// Finite values taken per asset since the last reset, the next one is written to ring row
+		/// count % lookback
+		/// </summary>
+		std::vector<size_t> counts;
+		std::vector<double> means;
+		std::vector<double> m2s;
+		std::vector<double> ring;
+		bool aligned = true;
+	};
+
+	void gather(std::vector<UniquePtr<Asset>> const& assets, std::span<uint32_t const> advanced) noexcept;
+	void step_aligned(Window& window) noexcept;
+	void step_sparse(Window& window, std::span<uint32_t const> advanced) noexcept;
+	void push(Window& window, size_t position, double v) noexcept;
+	void recompute(Window& window, size_t position) noexcept;
+
+	size_t _asset_count;
+	std::vector<Window> _windows;
+
+	/// <summary>
+	/// Distinct columns read by the windows and the current row of each, laid out [column][asset]
+	/// </summary>
+	std::vector<size_t> _columns;
+	std::vector<double> _inputs;
+	std::vector<double> _scratch;
+};
+
+}
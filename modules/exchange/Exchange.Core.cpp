@@ -4,6 +4,13 @@ module;
 #include "AgisMacros.h"
 #include "AgisDeclare.h"
 #include <ankerl/unordered_dense.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <tbb/task_group.h>
+#include <tbb/parallel_for.h>
 
 module ExchangeModule;
 
@@ -14,7 +21,11 @@ import PortfolioModule;
 import AssetModule;
 import AssetObserverModule;
 import AgisArrayUtils;
+import AgisMemoryMap;
+import AssetCacheModule;
 import OrderModule;
+import AgisProfiler;
+import CrossSectionModule;
 
 namespace fs = std::filesystem;
 
@@ -22,6 +33,11 @@ namespace fs = std::filesystem;
 namespace Agis
 {
 
+/// <summary>
+/// Number of assets above which Exchange::build merges the asset dt indices in parallel
+/// </summary>
+static constexpr size_t EXCHANGE_PARALLEL_BUILD_ASSETS = 1024;
+
 struct CovarianceMatrix
 {
 	CovarianceMatrix() {
@@ -32,6 +48,11 @@ struct CovarianceMatrix
 	Eigen::MatrixXd matrix;
 	size_t lookback;
 	size_t step_size;
+
+	/// <summary>
+	/// Observer nodes writing into the matrix, by asset position
+	/// </summary>
+	std::vector<std::vector<AssetObserver const*>> observers;
 };
 
 struct ExchangePrivate
@@ -45,17 +66,54 @@ struct ExchangePrivate
 	std::unordered_map<std::string, size_t> asset_index_map;
 	CovarianceMatrix covariance_matrix;
 	std::vector<std::unique_ptr<Order>> orders;
+	/// <summary>
+	/// Orders that left the open state in fill_orders, in the order they are routed to their portfolios
+	/// </summary>
+	std::vector<std::unique_ptr<Order>> completed_orders;
 
 	std::vector<long long> dt_index;
 	long long current_dt = 0;
 	size_t current_index = 0;
 	std::string dt_format;
 	bool on_close = false;
+	FileLoadStats load_stats;
+	bool live = false;
+	long long sealed_dt = std::numeric_limits<long long>::min();
+
+	/// <summary>
+	/// Positions of the assets with a row at each exchange index, active_assets[active_offsets[i]]
+	/// through active_assets[active_offsets[i + 1]] are the assets that print at dt_index[i]
+	/// </summary>
+	std::vector<size_t> active_offsets;
+	std::vector<uint32_t> active_assets;
+	/// <summary>
+	/// Assets that were streaming or on their last row after the previous step, they change state
+	/// on the next step even if they have no row there
+	/// </summary>
+	std::vector<uint32_t> carry_assets;
+	std::vector<uint32_t> next_carry_assets;
+	/// <summary>
+	/// Exchange index + 1 at which each asset was last stepped, guards against stepping twice
+	/// </summary>
+	std::vector<size_t> stepped_at;
+	bool active_set = true;
+
+	/// <summary>
+	/// Step, observer and fill timings, only recorded while the owning Hydra is profiling
+	/// </summary>
+	bool profile = false;
+	ScopeProfile profile_scope;
+
+	/// <summary>
+	/// Rolling windows over all assets, created by the first registered window
+	/// </summary>
+	UniquePtr<CrossSectionEngine> cross_section;
 
 	ExchangePrivate(
 		std::string exchange_id,
 		size_t exchange_index,
-		std::string dt_format);
+		std::string dt_format,
+		std::optional<LoadWindow> window);
 
 	~ExchangePrivate();
 };
@@ -64,12 +122,13 @@ struct ExchangePrivate
 ExchangePrivate::ExchangePrivate(
 	std::string _exchange_id,
 	size_t _exchange_index,
-	std::string _dt_format)
+	std::string _dt_format,
+	std::optional<LoadWindow> window)
 {
 	exchange_id = _exchange_id;
 	exchange_index = _exchange_index;
 	dt_format = _dt_format;
-	asset_factory = new AssetFactory(dt_format, exchange_id);
+	asset_factory = new AssetFactory(dt_format, exchange_id, std::move(window));
 	covariance_matrix = CovarianceMatrix();
 }
 
@@ -86,12 +145,17 @@ Exchange::Exchange(
 	size_t exchange_index,
 	std::string dt_format,
 	std::string source,
-	std::optional<std::vector<std::string>> symbols
+	std::optional<std::vector<std::string>> symbols,
+	std::optional<LoadWindow> window,
+	StoragePrecision precision
 ) noexcept
 {
 	_source = source;
+	_precision = precision;
 	_symbols = symbols;
-	_p = new ExchangePrivate(exchange_id, exchange_index, dt_format);
+	// a window that restricts nothing is a full load and may use the exchange cache
+	if (window && !window->is_full()) _window = window;
+	_p = new ExchangePrivate(exchange_id, exchange_index, dt_format, _window);
 }
 
 
@@ -100,10 +164,8 @@ std::expected<bool, AgisException> Exchange::load_folder() noexcept
 {
 	// get list of files in source directory
 	auto source_path = fs::path(this->_source);
-	auto files = fs::directory_iterator(source_path);
-	
-	// loop through files
-	for (auto const& file : files)
+	std::vector<fs::path> files;
+	for (auto const& file : fs::directory_iterator(source_path))
 	{
 		// get file name minus the extension
 		auto file_name = file.path().stem().string();
@@ -111,10 +173,37 @@ std::expected<bool, AgisException> Exchange::load_folder() noexcept
 		{
 			continue;
 		}
-		AGIS_ASSIGN_OR_RETURN(asset, _p->asset_factory->create_asset(file_name, file.path().string()));
-		_p->assets.push_back(std::move(asset));
+		files.push_back(file.path());
+	}
+
+	// sort on symbol so asset indices do not depend on directory iteration order
+	// or on the order in which the parallel loads finish
+	std::sort(files.begin(), files.end(), [](fs::path const& a, fs::path const& b) {
+		return a.stem().string() < b.stem().string();
+	});
+	size_t index_start = _p->asset_factory->reserve_indices(files.size());
+
+	// every file is independent, parse them concurrently then merge in sorted order
+	std::vector<std::expected<UniquePtr<Asset>, AgisException>> results(files.size());
+	tbb::task_group load_group;
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		load_group.run([this, &files, &results, index_start, i]() {
+			results[i] = _p->asset_factory->create_asset(
+				files[i].stem().string(),
+				files[i].string(),
+				index_start + i
+			);
+		});
 	}
+	load_group.wait();
 
+	_p->assets.reserve(_p->assets.size() + results.size());
+	for (auto& result : results)
+	{
+		if (!result) return std::unexpected(result.error());
+		_p->assets.push_back(std::move(result.value()));
+	}
 	return true;
 }
 
@@ -159,19 +248,39 @@ Exchange::load_h5() noexcept
 //============================================================================
 std::expected<bool, AgisException> Exchange::load_assets() noexcept
 {
+	auto start = std::chrono::steady_clock::now();
 	// load source as fs path and check if it exists
 	auto source_path = fs::path(this->_source);
 	if (!fs::exists(source_path))
 	{
 		return std::unexpected(AgisException("Source path does not exist"));
 	}
+	if (_window && _window->start && _window->end && *_window->start > *_window->end)
+	{
+		return std::unexpected(AgisException("Load window start is after its end"));
+	}
+
+	// attempt to map a binary cache of a previous load of the same source before parsing.
+	// the cache always holds the full source, so windowed loads read the source directly
+	bool from_cache = false;
+	bool use_cache = !_window;
+	auto symbols = _symbols.value_or(std::vector<std::string>{});
+	auto cache_path = asset_cache_path(this->_source, symbols);
+	auto fingerprint = asset_cache_fingerprint(this->_source, symbols, _p->dt_format);
+#ifndef AGIS_DISABLE_EXCHANGE_CACHE
+	if (use_cache)
+	{
+		auto cache_res = this->load_cache(cache_path, fingerprint);
+		from_cache = cache_res && *cache_res;
+	}
+#endif
 
 	// if source is a directory, call load_folder
-	if (fs::is_directory(source_path))
+	if (!from_cache && fs::is_directory(source_path))
 	{
 		AGIS_ASSIGN_OR_RETURN(res, this->load_folder());
 	}
-	else
+	else if (!from_cache)
 	{
 		// validate file has h5 extension
 		if (source_path.extension() != ".h5")
@@ -180,6 +289,18 @@ std::expected<bool, AgisException> Exchange::load_assets() noexcept
 		}
 		AGIS_ASSIGN_OR_RETURN(res, this->load_h5());
 	}
+
+	// drop assets without a single row inside of the load window and close the gaps
+	// they leave in the asset indices
+	if (_window && !_p->assets.empty())
+	{
+		size_t first_index = _p->assets.front()->get_index();
+		std::erase_if(_p->assets, [](auto const& asset) { return asset->rows() == 0; });
+		for (size_t i = 0; i < _p->assets.size(); i++)
+		{
+			_p->assets[i]->_asset_index = first_index + i;
+		}
+	}
 	for (auto& asset : _p->assets)
 	{
 		_p->asset_index_map.emplace(asset->get_id(), asset->get_index());
@@ -197,12 +318,274 @@ std::expected<bool, AgisException> Exchange::load_assets() noexcept
 				return std::unexpected(AgisException("Asset columns do not match"));
 			}
 		}
+		auto const& asset_stats = asset->get_load_stats();
+		_p->load_stats.bytes += asset_stats.bytes;
+		_p->load_stats.rows += asset_stats.rows;
+	}
+	_p->load_stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+#ifndef AGIS_DISABLE_EXCHANGE_CACHE
+	// failing to write the cache is not fatal, the next load will parse the source again.
+	// once written, rebind the parsed assets to the shared mapping so the first load does
+	// not keep a private copy of the data alive next to the one every later load maps
+	if (use_cache && !from_cache && this->write_cache(cache_path, fingerprint))
+	{
+		std::optional<size_t> index_start;
+		if (!_p->assets.empty()) index_start = _p->assets.front()->get_index();
+		this->load_cache(cache_path, fingerprint, index_start);
+	}
+#endif
+	// the cache always holds doubles, narrowing happens once the panel is final
+	if (_precision == StoragePrecision::FLOAT32)
+	{
+		for (auto& asset : _p->assets)
+		{
+			auto res = asset->narrow();
+			if (!res) return std::unexpected(res.error());
+		}
+	}
+	this->build();
+	return true;
+}
+
+
+//============================================================================
+std::expected<bool, AgisException>
+Exchange::load_memory(MemorySource&& source) noexcept
+{
+	auto start = std::chrono::steady_clock::now();
+	if (source.columns.empty())
+	{
+		return std::unexpected(AgisException("Memory source has no columns"));
+	}
+
+	// sort on symbol so asset indices match a folder load of the same assets
+	auto& panels = source.assets;
+	std::sort(panels.begin(), panels.end(), [](AssetPanel const& a, AssetPanel const& b) {
+		return a.asset_id < b.asset_id;
+	});
+	auto duplicate = std::adjacent_find(panels.begin(), panels.end(), [](AssetPanel const& a, AssetPanel const& b) {
+		return a.asset_id == b.asset_id;
+	});
+	if (duplicate != panels.end())
+	{
+		return std::unexpected(AgisException("Duplicate asset in memory source: " + duplicate->asset_id));
+	}
+	size_t index_start = _p->asset_factory->reserve_indices(panels.size());
+	_p->assets.reserve(_p->assets.size() + panels.size());
+	for (size_t i = 0; i < panels.size(); i++)
+	{
+		AGIS_ASSIGN_OR_RETURN(asset, _p->asset_factory->create_asset(
+			std::move(panels[i]),
+			source.columns,
+			index_start + i
+		));
+		_p->assets.push_back(std::move(asset));
+	}
+	_p->columns = std::move(source.columns);
+	for (auto& asset : _p->assets)
+	{
+		_p->asset_index_map.emplace(asset->get_id(), asset->get_index());
+		auto const& asset_stats = asset->get_load_stats();
+		_p->load_stats.bytes += asset_stats.bytes;
+		_p->load_stats.rows += asset_stats.rows;
+	}
+	_p->load_stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	if (_precision == StoragePrecision::FLOAT32)
+	{
+		for (auto& asset : _p->assets)
+		{
+			auto res = asset->narrow();
+			if (!res) return std::unexpected(res.error());
+		}
 	}
 	this->build();
 	return true;
 }
 
 
+//============================================================================
+std::expected<bool, AgisException>
+Exchange::load_cache(
+	std::string const& cache_path,
+	uint64_t fingerprint,
+	std::optional<size_t> index_start) noexcept
+{
+	// reuse the mapping of another exchange already bound to this cache if there is one
+	auto mapping = AssetCacheRegistry::find(cache_path, fingerprint);
+	bool registered = mapping != nullptr;
+	if (!mapping)
+	{
+		std::error_code ec;
+		if (!fs::exists(cache_path, ec)) return false;
+		AGIS_ASSIGN_OR_RETURN(mapped, MemoryMappedFile::open(cache_path, false));
+		mapping = SharedPtr<MemoryMappedFile>(std::move(mapped));
+	}
+
+	// validate the header, a stale or foreign cache is ignored and rebuilt from source
+	AssetCacheHeader header;
+	if (mapping->size() < sizeof(header)) return false;
+	std::memcpy(&header, mapping->data(), sizeof(header));
+	if (std::memcmp(header.magic, ASSET_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+		header.version != ASSET_CACHE_VERSION ||
+		header.fingerprint != fingerprint ||
+		header.file_size != mapping->size() ||
+		!asset_cache_range_fits(header.entries_offset, header.asset_count, sizeof(AssetCacheEntry), mapping->size()) ||
+		!asset_cache_range_fits(header.strings_offset, header.strings_length, 1, mapping->size()))
+	{
+		return false;
+	}
+
+	// column names are stored first in the string block followed by the asset ids
+	std::vector<std::string> columns;
+	char const* strings = mapping->data() + header.strings_offset;
+	char const* strings_end = strings + header.strings_length;
+	char const* p = strings;
+	for (size_t i = 0; i < header.column_count; i++)
+	{
+		auto len = strnlen(p, strings_end - p);
+		if (p + len >= strings_end) return false;
+		columns.emplace_back(p, len);
+		p += len + 1;
+	}
+
+	std::vector<AssetCacheEntry> entries(header.asset_count);
+	if (header.asset_count)
+	{
+		std::memcpy(
+			entries.data(),
+			mapping->data() + header.entries_offset,
+			header.asset_count * sizeof(AssetCacheEntry)
+		);
+	}
+	// validate every entry before reserving asset indices so a bad cache falls back cleanly
+	for (auto const& entry : entries)
+	{
+		if (!asset_cache_range_fits(entry.id_offset, entry.id_length, 1, header.strings_length) ||
+			!asset_cache_range_fits(entry.dt_offset, entry.rows, sizeof(long long), mapping->size()) ||
+			entry.cols != columns.size() ||
+			!asset_cache_range_fits(entry.data_offset, entry.rows, entry.cols * sizeof(double), mapping->size()) ||
+			entry.open_index >= columns.size() ||
+			entry.close_index >= columns.size())
+		{
+			return false;
+		}
+	}
+
+	// rebinding assets that were just parsed keeps their indices, a fresh load reserves new ones
+	if (index_start && entries.size() != _p->assets.size()) return false;
+	if (!index_start) index_start = _p->asset_factory->reserve_indices(entries.size());
+	std::vector<UniquePtr<Asset>> assets;
+	assets.reserve(entries.size());
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		auto const& entry = entries[i];
+		AGIS_ASSIGN_OR_RETURN(asset, _p->asset_factory->create_asset(
+			std::string(strings + entry.id_offset, entry.id_length),
+			mapping,
+			entry,
+			columns,
+			*index_start + i
+		));
+		assets.push_back(std::move(asset));
+	}
+	if (!registered) AssetCacheRegistry::insert(cache_path, fingerprint, mapping);
+	_p->assets = std::move(assets);
+	return true;
+}
+
+
+//============================================================================
+std::expected<bool, AgisException>
+Exchange::write_cache(std::string const& cache_path, uint64_t fingerprint) const noexcept
+{
+	// lay out the string block and compute the aligned offset of every asset block
+	std::string strings;
+	for (auto const& column : _p->columns)
+	{
+		strings += column;
+		strings.push_back('\0');
+	}
+	std::vector<AssetCacheEntry> entries(_p->assets.size());
+	for (size_t i = 0; i < _p->assets.size(); i++)
+	{
+		auto const& asset = _p->assets[i];
+		auto& entry = entries[i];
+		entry.rows = asset->rows();
+		entry.cols = asset->columns();
+		entry.open_index = asset->get_open_index();
+		entry.close_index = asset->get_close_index();
+		entry.id_offset = strings.size();
+		entry.id_length = asset->get_id().size();
+		strings += asset->get_id();
+		strings.push_back('\0');
+	}
+
+	AssetCacheHeader header{};
+	std::memcpy(header.magic, ASSET_CACHE_MAGIC, sizeof(header.magic));
+	header.version = ASSET_CACHE_VERSION;
+	header.asset_count = static_cast<uint32_t>(entries.size());
+	header.fingerprint = fingerprint;
+	header.column_count = _p->columns.size();
+	header.entries_offset = sizeof(AssetCacheHeader);
+	header.strings_offset = header.entries_offset + entries.size() * sizeof(AssetCacheEntry);
+	header.strings_length = strings.size();
+	size_t offset = header.strings_offset + header.strings_length;
+	for (auto& entry : entries)
+	{
+		entry.dt_offset = offset = asset_cache_align(offset);
+		offset += entry.rows * sizeof(long long);
+		entry.data_offset = offset = asset_cache_align(offset);
+		offset += entry.rows * entry.cols * sizeof(double);
+	}
+	header.file_size = offset;
+
+	// write to a temporary file and rename over the cache so that concurrent readers
+	// never observe a partially written cache
+	auto tmp_path = cache_path + ".tmp";
+	{
+		std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+		if (!out)
+		{
+			return std::unexpected(AgisException("Could not open cache file " + tmp_path));
+		}
+		char const padding[ASSET_CACHE_ALIGNMENT] = {};
+		size_t written = 0;
+		auto write = [&](void const* data, size_t n) {
+			out.write(static_cast<char const*>(data), n);
+			written += n;
+		};
+		auto pad_to = [&](size_t target) {
+			write(padding, target - written);
+		};
+		write(&header, sizeof(header));
+		write(entries.data(), entries.size() * sizeof(AssetCacheEntry));
+		write(strings.data(), strings.size());
+		for (size_t i = 0; i < entries.size(); i++)
+		{
+			auto const& asset = _p->assets[i];
+			auto dt_index = asset->get_dt_index();
+			auto data = asset->get_data();
+			pad_to(entries[i].dt_offset);
+			write(dt_index.data(), dt_index.size_bytes());
+			pad_to(entries[i].data_offset);
+			write(data.data(), data.size_bytes());
+		}
+		if (!out)
+		{
+			return std::unexpected(AgisException("Failed to write cache file " + tmp_path));
+		}
+	}
+	std::error_code ec;
+	fs::rename(tmp_path, cache_path, ec);
+	if (ec)
+	{
+		fs::remove(tmp_path, ec);
+		return std::unexpected(AgisException("Failed to replace cache file " + cache_path));
+	}
+	return true;
+}
+
+
 //============================================================================
 void
 Exchange::register_portfolio(Portfolio* p) noexcept
@@ -224,10 +607,43 @@ Exchange::step(long long global_dt) noexcept
 	{
 		return true;
 	}
-	// move assets forward
-	for (auto& asset : this->_p->assets)
+	auto profile_begin = PROFILER_AVAILABLE && _p->profile ? read_cycles() : 0;
+	// move assets forward. After the first step only the assets that print at this index and
+	// the assets carried over from the previous step can change state, every other asset is
+	// pending or disabled and stays that way
+	auto& next_carry = _p->next_carry_assets;
+	next_carry.clear();
+	auto stamp = _p->current_index + 1;
+	auto step_asset = [&](uint32_t position) {
+		if (_p->stepped_at[position] == stamp) return;
+		_p->stepped_at[position] = stamp;
+		auto state = _p->assets[position]->step(global_dt, _p->current_index);
+		if (state == AssetState::STREAMING || state == AssetState::LAST)
+		{
+			next_carry.push_back(position);
+		}
+	};
+	bool use_active_set = _p->active_set && !_p->live && _p->current_index &&
+		_p->active_offsets.size() == _p->dt_index.size() + 1;
+	if (use_active_set)
 	{
-		asset->step(global_dt);
+		auto begin = _p->active_offsets[_p->current_index];
+		auto end = _p->active_offsets[_p->current_index + 1];
+		for (size_t i = begin; i < end; i++) step_asset(_p->active_assets[i]);
+		for (auto position : _p->carry_assets) step_asset(position);
+	}
+	else
+	{
+		for (uint32_t position = 0; position < _p->assets.size(); position++) step_asset(position);
+	}
+	std::swap(_p->carry_assets, next_carry);
+
+	// the carry list is now exactly the assets that moved onto a new row
+	if (_p->cross_section)
+	{
+		auto window_begin = profile_begin ? read_cycles() : 0;
+		_p->cross_section->step(_p->assets, _p->carry_assets);
+		if (profile_begin) _p->profile_scope.get_mut(StepPhase::OBSERVERS).add(read_cycles() - window_begin);
 	}
 
 	// flag portfolios to call next step
@@ -236,10 +652,110 @@ Exchange::step(long long global_dt) noexcept
 		portfolio.second->_step_call = true;
 	}
 	_p->current_index++;
+	if (profile_begin) _p->profile_scope.record(StepPhase::EXCHANGE_STEP, profile_begin, read_cycles());
+	return true;
+}
+
+
+//============================================================================
+void
+Exchange::set_profiling(bool enabled) noexcept
+{
+	_p->profile = enabled;
+	auto counter = enabled ? &_p->profile_scope.get_mut(StepPhase::OBSERVERS) : nullptr;
+	for (auto& asset : _p->assets) asset->set_observer_profile(counter);
+}
+
+
+//============================================================================
+ScopeProfile const&
+Exchange::get_profile() const noexcept
+{
+	return _p->profile_scope;
+}
+
+
+//============================================================================
+bool
+Exchange::has_bar(long long global_dt) const noexcept
+{
+	return _p->current_index < _p->dt_index.size() && _p->dt_index[_p->current_index] == global_dt;
+}
+
+
+//============================================================================
+std::expected<bool, AgisException>
+Exchange::enable_live(size_t capacity) noexcept
+{
+	for (auto& asset : _p->assets)
+	{
+		AGIS_ASSIGN_OR_RETURN(res, asset->enable_live(capacity));
+	}
+	_p->live = true;
+	return true;
+}
+
+
+//============================================================================
+std::expected<bool, AgisException>
+Exchange::append_bar(std::string const& asset_id, long long dt, std::span<double const> values) noexcept
+{
+	if (!_p->live)
+	{
+		return std::unexpected(AgisException("Exchange " + _p->exchange_id + " is not live"));
+	}
+	auto it = _p->asset_index_map.find(asset_id);
+	if (it == _p->asset_index_map.end())
+	{
+		return std::unexpected(AgisException("Invalid Asset: " + asset_id));
+	}
+	// the asset has already stepped past anything at or before the current exchange time
+	if (_p->current_index && dt <= _p->dt_index[_p->current_index - 1])
+	{
+		return std::unexpected(AgisException("Bar for " + asset_id + " arrived after its time was stepped"));
+	}
+	auto& asset = _p->assets[it->second - _p->assets.front()->get_index()];
+	AGIS_ASSIGN_OR_RETURN(res, asset->append(dt, values));
+	sorted_insert(_p->dt_index, dt, _p->current_index);
 	return true;
 }
 
 
+//============================================================================
+void
+Exchange::seal(long long dt) noexcept
+{
+	_p->sealed_dt = std::max(_p->sealed_dt, dt);
+}
+
+
+//============================================================================
+bool
+Exchange::is_live() const noexcept
+{
+	return _p->live;
+}
+
+
+//============================================================================
+/// <summary>
+/// Latest time through which the exchange has every bar. That is the last bar of the asset that
+/// is furthest behind, or a later time explicitly sealed by the feed. Loaded exchanges are complete.
+/// </summary>
+long long
+Exchange::get_watermark() const noexcept
+{
+	if (!_p->live) return std::numeric_limits<long long>::max();
+	long long watermark = std::numeric_limits<long long>::max();
+	for (auto const& asset : _p->assets)
+	{
+		auto dt_index = asset->get_dt_index();
+		watermark = std::min(watermark, dt_index.empty() ? std::numeric_limits<long long>::min() : dt_index.back());
+	}
+	return std::max(watermark, _p->sealed_dt);
+}
+
+
 //============================================================================
 void
 Exchange::reset() noexcept
@@ -249,20 +765,160 @@ Exchange::reset() noexcept
 		asset->reset();
 	}
 	this->_p->current_index = 0;
+	this->_p->carry_assets.clear();
+	std::fill(this->_p->stepped_at.begin(), this->_p->stepped_at.end(), 0);
+	if (this->_p->cross_section) this->_p->cross_section->reset();
+	this->_p->profile_scope.clear();
 }
 
 //============================================================================
 void Exchange::build() noexcept
 {
-	this->_p->dt_index.clear();
-
+	std::vector<std::span<long long const>> dt_indices;
+	dt_indices.reserve(this->_p->assets.size());
 	for (auto& asset : this->_p->assets) 
 	{
-		this->_p->dt_index = sorted_union(
-			this->_p->dt_index,
-			asset->get_dt_index()
-		);
+		dt_indices.push_back(asset->get_dt_index());
+	}
+	if (dt_indices.size() >= EXCHANGE_PARALLEL_BUILD_ASSETS)
+	{
+		parallel_sorted_union(dt_indices, this->_p->dt_index);
+	}
+	else
+	{
+		sorted_union(dt_indices, this->_p->dt_index);
+	}
+	for (auto& asset : this->_p->assets)
+	{
+		asset->align(this->_p->dt_index);
+	}
+	this->build_active_set();
+}
+
+
+//============================================================================
+void Exchange::build_active_set() noexcept
+{
+	auto& offsets = _p->active_offsets;
+	auto& active = _p->active_assets;
+	auto const& dt_index = _p->dt_index;
+	_p->stepped_at.assign(_p->assets.size(), 0);
+	_p->carry_assets.clear();
+	offsets.clear();
+	active.clear();
+	if (_p->live) return;
+
+	// count the assets printing at each exchange index, then fill them in asset order
+	auto for_each_row = [&](auto&& f) {
+		for (uint32_t position = 0; position < _p->assets.size(); position++)
+		{
+			auto asset_index = _p->assets[position]->get_dt_index();
+			size_t g = 0;
+			for (auto dt : asset_index)
+			{
+				while (g < dt_index.size() && dt_index[g] < dt) g++;
+				if (g == dt_index.size()) break;
+				f(g, position);
+			}
+		}
+	};
+	offsets.assign(dt_index.size() + 1, 0);
+	for_each_row([&](size_t g, uint32_t) { offsets[g + 1]++; });
+	for (size_t i = 0; i < dt_index.size(); i++) offsets[i + 1] += offsets[i];
+	active.resize(offsets.back());
+	std::vector<size_t> cursor(offsets.begin(), offsets.end() - 1);
+	for_each_row([&](size_t g, uint32_t position) { active[cursor[g]++] = position; });
+}
+
+
+//============================================================================
+UniquePtr<Exchange> Exchange::fork() const noexcept
+{
+	// the fork copies the built indices and shares every asset panel, orders, portfolios and
+	// the covariance matrix are run state and start empty
+	auto exchange = std::make_unique<Exchange>(
+		_p->exchange_id, _p->exchange_index, _p->dt_format, _source, _symbols, _window, _precision
+	);
+	auto& p = *exchange->_p;
+	exchange->_index_offset = _index_offset;
+	p.columns = _p->columns;
+	p.asset_index_map = _p->asset_index_map;
+	p.dt_index = _p->dt_index;
+	p.load_stats = _p->load_stats;
+	p.active_offsets = _p->active_offsets;
+	p.active_assets = _p->active_assets;
+	p.active_set = _p->active_set;
+	p.stepped_at.assign(_p->assets.size(), 0);
+	p.assets.reserve(_p->assets.size());
+	for (auto const& asset : _p->assets)
+	{
+		p.assets.push_back(asset->fork(p.dt_index));
+	}
+	return exchange;
+}
+
+
+//============================================================================
+ExchangeSnapshot
+Exchange::snapshot() const noexcept
+{
+	ExchangeSnapshot snapshot;
+	snapshot.current_index = _p->current_index;
+	snapshot.current_dt = _p->current_dt;
+	snapshot.assets.reserve(_p->assets.size());
+	for (auto const& asset : _p->assets)
+	{
+		snapshot.assets.push_back(asset->cursor());
+	}
+	return snapshot;
+}
+
+
+//============================================================================
+void
+Exchange::restore(ExchangeSnapshot const& snapshot) noexcept
+{
+	// assets share nothing but the immutable panels, their observers can be replayed concurrently
+	tbb::parallel_for(size_t(0), _p->assets.size(), [&](size_t i) {
+		_p->assets[i]->restore(snapshot.assets[i]);
+	});
+	_p->current_index = snapshot.current_index;
+	_p->current_dt = snapshot.current_dt;
+	_p->orders.clear();
+	_p->completed_orders.clear();
+
+	// the carry list is exactly the assets that will change state on the next step
+	_p->carry_assets.clear();
+	for (uint32_t position = 0; position < _p->assets.size(); position++)
+	{
+		if (_p->assets[position]->is_streaming()) _p->carry_assets.push_back(position);
 	}
+	std::fill(_p->stepped_at.begin(), _p->stepped_at.end(), 0);
+	if (_p->cross_section) _p->cross_section->restore(_p->assets);
+}
+
+
+//============================================================================
+std::vector<UniquePtr<Order>> const&
+Exchange::get_open_orders() const noexcept
+{
+	return _p->orders;
+}
+
+
+//============================================================================
+void
+Exchange::restore_order(UniquePtr<Order> order) noexcept
+{
+	order->set_order_state(OrderState::OPEN);
+	_p->orders.push_back(std::move(order));
+}
+
+
+//============================================================================
+void Exchange::set_active_set(bool enabled) noexcept
+{
+	_p->active_set = enabled;
 }
 
 
@@ -378,21 +1034,80 @@ get_enclosing_asset(Asset const* a, Asset const* b)
 std::expected<size_t, AgisException>
 Exchange::register_observer(std::function<UniquePtr<AssetObserver>(const Asset&)> observerFactory)
 {
+	// the asset's graph merges the observer and its inputs with any identical nodes already there
 	size_t observer_hash = 0;
 	for (auto& asset : this->_p->assets)
 	{
-		auto observer = observerFactory(*asset);
-		if(!observer_hash) observer_hash = observer->hash();
-		if (asset->get_observer(observer->hash()))
-		{
-			continue;
-		}
-		asset->add_observer(std::move(observer));
+		auto node = asset->add_observer(observerFactory(*asset));
+		if (!observer_hash) observer_hash = node->hash();
 	}
 	return observer_hash;
 }
 
 
+//============================================================================
+std::expected<size_t, AgisException>
+Exchange::register_window(std::string const& column, size_t lookback)
+{
+	auto column_index = get_column_index(column);
+	if (!column_index)
+	{
+		return std::unexpected(AgisException("Exchange " + _p->exchange_id + " has no column " + column));
+	}
+	if (!lookback)
+	{
+		return std::unexpected(AgisException("Window lookback must be positive"));
+	}
+	if (!_p->cross_section)
+	{
+		_p->cross_section = std::make_unique<CrossSectionEngine>(_p->assets.size());
+	}
+	auto slot = _p->cross_section->add_window(*column_index, lookback);
+	// a window added mid run picks up the rows its assets already stepped over
+	_p->cross_section->restore(_p->assets);
+	return slot;
+}
+
+
+//============================================================================
+CrossSectionEngine const*
+Exchange::get_cross_section() const noexcept
+{
+	return _p->cross_section.get();
+}
+
+
+//============================================================================
+std::expected<size_t, AgisException>
+Exchange::precompute_observers(bool validate) noexcept
+{
+	if (_p->live)
+	{
+		return std::unexpected(AgisException("Exchange " + _p->exchange_id + " is live, its observers can only step"));
+	}
+	if (_p->current_index)
+	{
+		return std::unexpected(AgisException("Exchange " + _p->exchange_id + " must precompute observers before its first step"));
+	}
+	// each asset replays only its own panel through its own graph
+	std::vector<uint8_t> precomputed(_p->assets.size(), 0);
+	tbb::parallel_for(size_t(0), _p->assets.size(), [&](size_t i) {
+		precomputed[i] = _p->assets[i]->precompute_observers(validate);
+	});
+	return static_cast<size_t>(std::count(precomputed.begin(), precomputed.end(), 1));
+}
+
+
+//============================================================================
+size_t
+Exchange::feature_mismatches() const noexcept
+{
+	size_t mismatches = 0;
+	for (auto const& asset : _p->assets) mismatches += asset->feature_mismatches();
+	return mismatches;
+}
+
+
 //============================================================================
 std::optional<double>
 Exchange::get_covariance(size_t index1, size_t index2) const noexcept
@@ -415,6 +1130,10 @@ Exchange::get_covariance(size_t index1, size_t index2) const noexcept
 std::expected<bool, AgisException>
 Exchange::init_covariance_matrix(size_t lookback, size_t step_size) noexcept
 {
+	// the observers of an earlier call write through pointers into the old matrix, drop them first
+	auto& observers = _p->covariance_matrix.observers;
+	for (size_t i = 0; i < observers.size(); i++) _p->assets[i]->remove_observers(observers[i]);
+	observers.assign(_p->assets.size(), {});
 	_p->covariance_matrix.matrix = Eigen::MatrixXd::Zero(_p->assets.size(), _p->assets.size());
 	_p->covariance_matrix.lookback = lookback;
 	_p->covariance_matrix.step_size = step_size;
@@ -438,7 +1157,7 @@ Exchange::init_covariance_matrix(size_t lookback, size_t step_size) noexcept
 				auto observer = std::make_unique<ReturnsVarianceObserver>(*a1, lookback);
 				double* diagonal = &_p->covariance_matrix.matrix(i, j);
 				observer->set_pointer(diagonal);
-				a1->add_observer(std::move(observer));
+				observers[i].push_back(a1->add_observer(std::move(observer)));
 				continue;
 			}
 			else
@@ -447,7 +1166,7 @@ Exchange::init_covariance_matrix(size_t lookback, size_t step_size) noexcept
 				double* upper_triangular = &_p->covariance_matrix.matrix(i, j);
 				double* lower_triangular = &_p->covariance_matrix.matrix(j, i);
 				observer->set_pointers(upper_triangular, lower_triangular);
-				a1->add_observer(std::move(observer));
+				observers[i].push_back(a1->add_observer(std::move(observer)));
 			}
 		}
 	}
@@ -478,9 +1197,11 @@ Exchange::create(
 	std::string dt_format,
 	size_t exchange_index,
 	std::string source,
-	std::optional<std::vector<std::string>> symbols)
+	std::optional<std::vector<std::string>> symbols,
+	std::optional<LoadWindow> window,
+	StoragePrecision precision)
 {
-	return std::make_unique<Exchange>(exchange_name, exchange_index, dt_format, source, symbols);
+	return std::make_unique<Exchange>(exchange_name, exchange_index, dt_format, source, symbols, window, precision);
 }
 
 
@@ -524,6 +1245,25 @@ Exchange::get_asset(std::string const& asset_id) const noexcept
 }
 
 
+//============================================================================
+std::optional<size_t>
+Exchange::get_asset_row(std::string const& asset_id, long long dt) const noexcept
+{
+	auto asset = this->get_asset(asset_id);
+	if (!asset) return std::nullopt;
+	auto it = std::lower_bound(_p->dt_index.begin(), _p->dt_index.end(), dt);
+	if (it == _p->dt_index.end() || *it != dt) return std::nullopt;
+	auto exchange_index = static_cast<size_t>(it - _p->dt_index.begin());
+	if (auto row = (*asset)->get_aligned_row(exchange_index)) return row;
+
+	// live assets are not aligned, search their own index
+	auto dt_index = (*asset)->get_dt_index();
+	auto asset_it = std::lower_bound(dt_index.begin(), dt_index.end(), dt);
+	if (asset_it == dt_index.end() || *asset_it != dt) return std::nullopt;
+	return static_cast<size_t>(asset_it - dt_index.begin());
+}
+
+
 //============================================================================
 std::vector<std::string> const&
 Exchange::get_columns() const noexcept
@@ -532,6 +1272,14 @@ Exchange::get_columns() const noexcept
 }
 
 
+//============================================================================
+FileLoadStats const&
+Exchange::get_load_stats() const noexcept
+{
+	return _p->load_stats;
+}
+
+
 //============================================================================
 std::optional<std::unique_ptr<Order>>
 Exchange::place_order(std::unique_ptr<Order> order) noexcept
@@ -592,16 +1340,48 @@ Exchange::process_order(Order* order) noexcept
 void
 Exchange::process_orders(bool on_close) noexcept
 {
+	this->fill_orders(on_close);
+	this->route_orders();
+}
+
+
+//============================================================================
+bool
+Exchange::has_open_orders() const noexcept
+{
+	return !_p->orders.empty();
+}
+
+
+//============================================================================
+void
+Exchange::route_orders() noexcept
+{
+	for (auto& order : _p->completed_orders)
+	{
+		auto portfolio_index = order->get_portfolio_index();
+		auto portfolio = registered_portfolios[portfolio_index];
+		portfolio->process_order(std::move(order));
+	}
+	_p->completed_orders.clear();
+}
+
+
+//============================================================================
+void
+Exchange::fill_orders(bool on_close) noexcept
+{
+	// fills only touch this exchange's assets and the orders themselves, portfolios are
+	// updated afterwards by route_orders so that exchanges can fill concurrently
 	_p->on_close = on_close;
+	auto profile_begin = PROFILER_AVAILABLE && _p->profile ? read_cycles() : 0;
 	for (auto orderIt = this->_p->orders.begin(); orderIt != this->_p->orders.end();)
 	{
 		auto& order = *orderIt;
 		this->process_order(order.get());
 
 		if (order->get_order_state() != OrderState::OPEN) {
-			auto portfolio_index = order->get_portfolio_index();
-			auto portfolio = registered_portfolios[portfolio_index];
-			portfolio->process_order(std::move(order));
+			_p->completed_orders.push_back(std::move(order));
 
 			// swap current order with last order and pop back
 			std::iter_swap(orderIt, this->_p->orders.rbegin());
@@ -612,6 +1392,7 @@ Exchange::process_orders(bool on_close) noexcept
 			++orderIt;
 		}
 	}
+	if (profile_begin) _p->profile_scope.record(StepPhase::PROCESS_ORDERS, profile_begin, read_cycles());
 }
 
 
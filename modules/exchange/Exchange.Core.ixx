@@ -6,6 +6,7 @@ module;
 #define AGIS_API __declspec(dllimport)
 #endif
 #include "AgisDeclare.h"
+#include <cstdint>
 #include <ankerl/unordered_dense.h>
 
 export module ExchangeModule;
@@ -15,14 +16,33 @@ import <expected>;
 import <optional>;
 import <vector>;
 import <shared_mutex>;
+import <span>;
 
 import AgisError;
+import AgisFileUtils;
+import AgisTypes;
+import AssetModule;
+import AgisProfiler;
+import CrossSectionModule;
 
 namespace Agis
 {
 
 struct ExchangePrivate;
 
+
+//============================================================================
+/// <summary>
+/// Cursor of an exchange and of each of its assets, in asset order
+/// </summary>
+export struct ExchangeSnapshot
+{
+	size_t current_index = 0;
+	long long current_dt = 0;
+	std::vector<AssetCursor> assets;
+};
+
+
 export class Exchange
 {
 	friend class ExchangeFactory;
@@ -33,6 +53,8 @@ private:
 	ExchangePrivate* _p;
 	size_t _index_offset = 0;
 	std::optional<std::vector<std::string>> _symbols;
+	std::optional<LoadWindow> _window;
+	StoragePrecision _precision = StoragePrecision::FLOAT64;
 	/// <summary>
 	/// Mapping between portfolio child index and child portfolio
 	/// </summary>
@@ -43,26 +65,53 @@ private:
 		std::string dt_format,
 		size_t exchange_index,
 		std::string source,
-		std::optional<std::vector<std::string>> symbols
+		std::optional<std::vector<std::string>> symbols,
+		std::optional<LoadWindow> window,
+		StoragePrecision precision
 	);
 	static void destroy(Exchange* exchange) noexcept;
 	std::expected<bool, AgisException> load_h5() noexcept;
 	std::expected<bool, AgisException> load_folder() noexcept;
 	std::expected<bool, AgisException> load_assets() noexcept;
+	std::expected<bool, AgisException> load_memory(MemorySource&& source) noexcept;
+	std::expected<bool, AgisException> load_cache(
+		std::string const& cache_path,
+		uint64_t fingerprint,
+		std::optional<size_t> index_start = std::nullopt
+	) noexcept;
+	std::expected<bool, AgisException> write_cache(std::string const& cache_path, uint64_t fingerprint) const noexcept;
 	[[nodiscard]] std::expected<bool, AgisException> step(long long global_dt) noexcept;
 	void register_portfolio(Portfolio* p) noexcept;
 	void reset() noexcept;
 	void build() noexcept;
+	void build_active_set() noexcept;
+	UniquePtr<Exchange> fork() const noexcept;
+	ExchangeSnapshot snapshot() const noexcept;
+	void restore(ExchangeSnapshot const& snapshot) noexcept;
+	std::vector<UniquePtr<Order>> const& get_open_orders() const noexcept;
+	void restore_order(UniquePtr<Order> order) noexcept;
 	[[nodiscard]] std::optional<std::unique_ptr<Order>> place_order(std::unique_ptr<Order> order) noexcept;
 	
 	void process_market_order(Order* order) noexcept;
 	void process_order(Order* order) noexcept;
 	void process_orders(bool on_close) noexcept;
+	void fill_orders(bool on_close) noexcept;
+	void route_orders() noexcept;
+	bool has_open_orders() const noexcept;
+	bool has_bar(long long global_dt) const noexcept;
 
 	bool is_valid_order(Order const* order) const noexcept;
 	
 	void set_index_offset(size_t offset) noexcept { _index_offset = offset;}
+	std::expected<bool, AgisException> enable_live(size_t capacity) noexcept;
+	std::expected<bool, AgisException> append_bar(
+		std::string const& asset_id,
+		long long dt,
+		std::span<double const> values
+	) noexcept;
+	void seal(long long dt) noexcept;
 	std::vector<UniquePtr<Asset>>& get_assets_mut() noexcept;
+	void set_profiling(bool enabled) noexcept;
 
 public:
 	Exchange(
@@ -70,7 +119,9 @@ public:
 		size_t exchange_index,
 		std::string dt_format,
 		std::string source,
-		std::optional<std::vector<std::string>> symbols
+		std::optional<std::vector<std::string>> symbols,
+		std::optional<LoadWindow> window = std::nullopt,
+		StoragePrecision precision = StoragePrecision::FLOAT64
 	) noexcept;
 
 	AGIS_API ~Exchange();
@@ -79,6 +130,8 @@ public:
 	Exchange& operator=(Exchange const&) = delete;
 	size_t get_exchange_index() const noexcept;
 	auto const& symbols() const noexcept { return _symbols; }
+	auto const& window() const noexcept { return _window; }
+	StoragePrecision precision() const noexcept { return _precision; }
 	std::optional<size_t> get_column_index(std::string const& column) const noexcept;
 	long long get_dt() const noexcept;
 	std::string const& get_exchange_id() const noexcept;
@@ -88,14 +141,47 @@ public:
 	std::optional<size_t> get_asset_index(std::string const& asset_id) const noexcept;
 	std::vector<long long> const& get_dt_index() const noexcept;
 	size_t get_index_offset() const noexcept { return _index_offset; }
+	bool is_live() const noexcept;
+
+	/// <summary>
+	/// Cycles spent stepping this exchange, updating its observers and filling its orders
+	/// </summary>
+	ScopeProfile const& get_profile() const noexcept;
+	long long get_watermark() const noexcept;
 	
 	AGIS_API std::expected<size_t, AgisException> register_observer(std::function<UniquePtr<AssetObserver>(const Asset&)> observerFactory);
+
+	/// <summary>
+	/// Register a rolling window of lookback rows over column on every asset and return its slot in
+	/// the exchange's cross section engine, identical windows share a slot
+	/// </summary>
+	AGIS_API std::expected<size_t, AgisException> register_window(std::string const& column, size_t lookback);
+	CrossSectionEngine const* get_cross_section() const noexcept;
+
+	/// <summary>
+	/// Compute the full series of every asset's observers ahead of the run, in parallel across assets,
+	/// so that observer reads during the run are loads from the stored series and the graphs are no
+	/// longer stepped. Assets whose graphs hold observers that write outside the asset keep stepping
+	/// them. With validate the graphs are still stepped and every value is checked against the stored
+	/// one. Must be called on a built, non live exchange before its first step, returns the number of
+	/// assets precomputed. Registering an observer afterwards puts that asset back on the incremental path.
+	/// </summary>
+	AGIS_API std::expected<size_t, AgisException> precompute_observers(bool validate = false) noexcept;
+	AGIS_API size_t feature_mismatches() const noexcept;
 	AGIS_API std::optional<double> get_covariance(size_t index1, size_t index2) const noexcept;
 	AGIS_API std::expected<bool, AgisException> init_covariance_matrix(size_t lookback, size_t step_size) noexcept;
 	AGIS_API std::vector<UniquePtr<Asset>> const& get_assets() const noexcept;
 	AGIS_API std::optional<Asset const*> get_asset(size_t asset_index) const noexcept;
 	AGIS_API std::optional<Asset const*> get_asset(std::string const& asset_id) const noexcept;
+	AGIS_API std::optional<size_t> get_asset_row(std::string const& asset_id, long long dt) const noexcept;
 	AGIS_API std::vector<std::string> const& get_columns() const noexcept;
+
+	/// <summary>
+	/// Step only the assets that print at each exchange time and those whose state changes from
+	/// the previous step, rather than every asset. Enabled by default, disable to compare against a full scan
+	/// </summary>
+	AGIS_API void set_active_set(bool enabled) noexcept;
+	AGIS_API FileLoadStats const& get_load_stats() const noexcept;
 };
 
 
@@ -2,12 +2,16 @@ module;
 
 #include "AgisDeclare.h"
 #include "AgisMacros.h"
+#include <algorithm>
+#include <chrono>
+#include <limits>
 
 module ExchangeMapModule;
 import AssetModule;
 import OrderModule;
 import ExchangeModule;
 import AgisArrayUtils;
+import AgisTimeUtils;
 
 namespace Agis
 {
@@ -19,14 +23,18 @@ ExchangeFactory::create_exchange(
 		std::string exchange_id,
 		std::string dt_format,
 		std::string source,
-		std::optional<std::vector<std::string>> symbols)
+		std::optional<std::vector<std::string>> symbols,
+		std::optional<LoadWindow> window,
+		StoragePrecision precision)
 {
 	auto exchange = Exchange::create(
 		exchange_id,
 		dt_format,
 		_exchange_counter,
 		source,
-		symbols
+		symbols,
+		window,
+		precision
 	);
 	auto res = exchange->load_assets();
 	if (!res)
@@ -38,15 +46,56 @@ ExchangeFactory::create_exchange(
 }
 
 
+//============================================================================
+std::expected<UniquePtr<Exchange>, AgisException>
+ExchangeFactory::create_exchange(
+		std::string exchange_id,
+		MemorySource&& source,
+		StoragePrecision precision)
+{
+	// memory exchanges have no source on disk, their timestamps are already epoch nanoseconds
+	auto exchange = Exchange::create(
+		exchange_id,
+		std::string(DT_FORMAT_EPOCH_NS),
+		_exchange_counter,
+		"memory:" + exchange_id,
+		std::nullopt,
+		std::nullopt,
+		precision
+	);
+	auto res = exchange->load_memory(std::move(source));
+	if (!res)
+	{
+		return std::unexpected(res.error());
+	}
+	_exchange_counter++;
+	return std::move(exchange);
+}
+
+
 //============================================================================
 struct ExchangeMapPrivate
 {
 	ExchangeFactory factory;
 	
 	std::vector<long long> dt_index;
-	size_t current_index;
+	size_t current_index = 0;
 	long long global_dt = 0;
 
+	/// <summary>
+	/// Steady clock time in nanoseconds at which the last bar for each dt index entry was
+	/// appended by a live feed, 0 for entries that were loaded from source
+	/// </summary>
+	std::vector<long long> arrival_times;
+	bool live = false;
+	bool built = false;
+
+	/// <summary>
+	/// Scratch space for parallel steps, the exchanges with work at the current time and their results
+	/// </summary>
+	std::vector<Exchange*> active_exchanges;
+	std::vector<std::expected<bool, AgisException>> step_results;
+
 	std::unordered_map<std::string, size_t> asset_indecies;
 	std::vector<Asset*> assets;
 	std::vector<UniquePtr<Exchange>> exchanges;
@@ -61,7 +110,9 @@ ExchangeMap::create_exchange(
 	std::string exchange_id,
 	std::string dt_format,
 	std::string source,
-	std::optional<std::vector<std::string>> symbols)
+	std::optional<std::vector<std::string>> symbols,
+	std::optional<LoadWindow> window,
+	StoragePrecision precision)
 {
 	// check if exchange already exists
 	if (_p->exchange_indecies.find(exchange_id) != _p->exchange_indecies.end())
@@ -70,9 +121,36 @@ ExchangeMap::create_exchange(
 	}  
 
 	// create the new exchange and copy over asset pointers
+	_p->built = false;
 	AGIS_ASSIGN_OR_RETURN(exchange, _p->factory.create_exchange(
-		exchange_id, dt_format, source, symbols)
+		exchange_id, dt_format, source, symbols, window, precision)
 	);
+	return register_exchange(std::move(exchange));
+}
+
+
+//============================================================================
+std::expected<Exchange const*, AgisException>
+ExchangeMap::create_exchange(
+	std::string exchange_id,
+	MemorySource&& source,
+	StoragePrecision precision)
+{
+	if (_p->exchange_indecies.find(exchange_id) != _p->exchange_indecies.end())
+	{
+		return std::unexpected<AgisException>("Exchange already exists");
+	}
+	_p->built = false;
+	AGIS_ASSIGN_OR_RETURN(exchange, _p->factory.create_exchange(exchange_id, std::move(source), precision));
+	return register_exchange(std::move(exchange));
+}
+
+
+//============================================================================
+Exchange const*
+ExchangeMap::register_exchange(UniquePtr<Exchange> exchange) noexcept
+{
+	auto exchange_id = exchange->get_exchange_id();
 	auto& exchange_assets = exchange->get_assets();
 	exchange->set_index_offset(_p->assets.size());
 	for (auto& asset : exchange_assets)
@@ -118,18 +196,127 @@ ExchangeMap::~ExchangeMap()
 std::expected<bool, AgisException>
 ExchangeMap::build() noexcept
 {
-	this->_p->dt_index.clear();
+	// the merged index only changes when an exchange is added or a live bar arrives
+	if (_p->built && !_p->live)
+	{
+		this->_p->arrival_times.assign(this->_p->dt_index.size(), 0);
+		return true;
+	}
+	std::vector<std::span<long long const>> dt_indices;
+	dt_indices.reserve(_p->exchanges.size());
 	for (auto& exchange : _p->exchanges)
 	{
-		this->_p->dt_index = sorted_union(
-			this->_p->dt_index,
-			exchange->get_dt_index()
-		);
+		dt_indices.push_back(exchange->get_dt_index());
+	}
+	sorted_union(dt_indices, this->_p->dt_index);
+	this->_p->arrival_times.assign(this->_p->dt_index.size(), 0);
+	_p->built = true;
+	return true;
+}
+
+
+//============================================================================
+std::expected<bool, AgisException>
+ExchangeMap::fork_from(ExchangeMap const& other) noexcept
+{
+	if (!_p->exchanges.empty())
+	{
+		return std::unexpected(AgisException("Can only fork into an empty exchange map"));
+	}
+	if (other._p->live)
+	{
+		return std::unexpected(AgisException("Can not fork a live exchange map"));
+	}
+	for (auto const& exchange : other._p->exchanges)
+	{
+		auto forked = exchange->fork();
+		for (auto& asset : forked->get_assets())
+		{
+			_p->assets.push_back(asset.get());
+		}
+		_p->exchanges.push_back(std::move(forked));
+	}
+	_p->factory._exchange_counter = other._p->factory._exchange_counter;
+	_p->asset_indecies = other._p->asset_indecies;
+	_p->exchange_indecies = other._p->exchange_indecies;
+	_p->dt_index = other._p->dt_index;
+	_p->arrival_times.assign(_p->dt_index.size(), 0);
+	_p->built = other._p->built;
+	candles = other.candles;
+	return true;
+}
+
+
+//============================================================================
+ExchangeMapSnapshot
+ExchangeMap::snapshot() const noexcept
+{
+	ExchangeMapSnapshot snapshot;
+	snapshot.current_index = _p->current_index;
+	snapshot.global_dt = _p->global_dt;
+	snapshot.exchanges.reserve(_p->exchanges.size());
+	for (auto const& exchange : _p->exchanges)
+	{
+		snapshot.exchanges.push_back(exchange->snapshot());
 	}
+	return snapshot;
+}
+
+
+//============================================================================
+std::expected<bool, AgisException>
+ExchangeMap::restore(ExchangeMapSnapshot const& snapshot) noexcept
+{
+	if (_p->live)
+	{
+		return std::unexpected(AgisException("Can not restore a live exchange map"));
+	}
+	if (snapshot.exchanges.size() != _p->exchanges.size() || snapshot.current_index > _p->dt_index.size())
+	{
+		return std::unexpected(AgisException("Snapshot does not match the exchange map"));
+	}
+	for (size_t i = 0; i < _p->exchanges.size(); i++)
+	{
+		if (snapshot.exchanges[i].assets.size() != _p->exchanges[i]->get_assets().size())
+		{
+			return std::unexpected(AgisException("Snapshot does not match exchange " + _p->exchanges[i]->get_exchange_id()));
+		}
+	}
+	for (size_t i = 0; i < _p->exchanges.size(); i++)
+	{
+		_p->exchanges[i]->restore(snapshot.exchanges[i]);
+	}
+	_p->current_index = snapshot.current_index;
+	_p->global_dt = snapshot.global_dt;
 	return true;
 }
 
 
+//============================================================================
+std::vector<Order const*>
+ExchangeMap::get_open_orders() const noexcept
+{
+	std::vector<Order const*> orders;
+	for (auto const& exchange : _p->exchanges)
+	{
+		for (auto const& order : exchange->get_open_orders())
+		{
+			orders.push_back(order.get());
+		}
+	}
+	return orders;
+}
+
+
+//============================================================================
+void
+ExchangeMap::restore_order(UniquePtr<Order> order) noexcept
+{
+	auto exchange_index = order->get_exchange_index();
+	_p->exchanges[exchange_index]->restore_order(std::move(order));
+}
+
+
 //============================================================================
 void
 ExchangeMap::reset() noexcept
@@ -144,30 +331,86 @@ ExchangeMap::reset() noexcept
 
 
 //============================================================================
-void ExchangeMap::process_orders(bool on_close) noexcept
+void ExchangeMap::process_orders(bool on_close, tbb::task_group* pool) noexcept
 {
+	auto& active = _p->active_exchanges;
+	active.clear();
 	for (auto& exchange : _p->exchanges)
 	{
-		if (exchange->get_dt() == _p->global_dt)
+		if (exchange->get_dt() == _p->global_dt && exchange->has_open_orders())
 		{
-			exchange->process_orders(on_close);
+			active.push_back(exchange.get());
 		}
 	}
+	if (!pool || active.size() < 2)
+	{
+		for (auto exchange : active) exchange->process_orders(on_close);
+		return;
+	}
+
+	// exchanges fill their own orders concurrently, the filled orders are then routed to
+	// portfolios serially in exchange order so portfolio state matches the serial path exactly
+	for (auto exchange : active)
+	{
+		pool->run([exchange, on_close] { exchange->fill_orders(on_close); });
+	}
+	pool->wait();
+	for (auto exchange : active) exchange->route_orders();
+}
+
+
+//============================================================================
+void
+ExchangeMap::set_profiling(bool enabled) noexcept
+{
+	for (auto& exchange : _p->exchanges)
+	{
+		exchange->set_profiling(enabled);
+	}
 }
 
 
 //============================================================================
 std::expected<bool, AgisException>
-ExchangeMap::step() noexcept
+ExchangeMap::step(tbb::task_group* pool) noexcept
 {
 	if (_p->current_index >= _p->dt_index.size())
 	{
 		return true;
 	}
 	_p->global_dt = _p->dt_index[_p->current_index];
-	for (auto& exchange : _p->exchanges)
+	auto& active = _p->active_exchanges;
+	if (pool)
 	{
-		AGIS_ASSIGN_OR_RETURN(res, exchange->step(_p->global_dt));
+		active.clear();
+		for (auto& exchange : _p->exchanges)
+		{
+			if (exchange->has_bar(_p->global_dt)) active.push_back(exchange.get());
+		}
+	}
+	if (!pool || active.size() < 2)
+	{
+		for (auto& exchange : _p->exchanges)
+		{
+			AGIS_ASSIGN_OR_RETURN(res, exchange->step(_p->global_dt));
+		}
+	}
+	else
+	{
+		// exchanges share no asset state so each can step its assets and observers on its own task
+		auto& results = _p->step_results;
+		results.assign(active.size(), true);
+		for (size_t i = 0; i < active.size(); i++)
+		{
+			pool->run([this, &active, &results, i] {
+				results[i] = active[i]->step(_p->global_dt);
+			});
+		}
+		pool->wait();
+		for (auto& result : results)
+		{
+			if (!result) return std::unexpected(result.error());
+		}
 	}
 	_p->current_index++;
 	return true;
@@ -282,6 +525,93 @@ ExchangeMap::force_place_order(Order* order, bool is_close) noexcept
 }
 
 
+//============================================================================
+std::expected<bool, AgisException>
+ExchangeMap::enable_live(std::string const& exchange_id, size_t capacity) noexcept
+{
+	AGIS_ASSIGN_OR_RETURN(exchange, this->get_exchange_mut(exchange_id));
+	AGIS_ASSIGN_OR_RETURN(res, exchange->enable_live(capacity));
+	_p->live = true;
+	return true;
+}
+
+
+//============================================================================
+std::expected<bool, AgisException>
+ExchangeMap::append_bar(
+	std::string const& exchange_id,
+	std::string const& asset_id,
+	long long dt,
+	std::span<double const> values) noexcept
+{
+	// a bar at or before the global time can no longer be stepped by any exchange
+	if (_p->current_index && dt <= _p->global_dt)
+	{
+		return std::unexpected(AgisException("Bar for " + asset_id + " arrived after its time was stepped"));
+	}
+	AGIS_ASSIGN_OR_RETURN(exchange, this->get_exchange_mut(exchange_id));
+	AGIS_ASSIGN_OR_RETURN(res, exchange->append_bar(asset_id, dt, values));
+	auto arrival = std::chrono::steady_clock::now().time_since_epoch().count();
+	auto size = _p->dt_index.size();
+	auto position = *sorted_insert(_p->dt_index, dt, _p->current_index);
+	if (_p->dt_index.size() != size)
+	{
+		_p->arrival_times.insert(_p->arrival_times.begin() + position, arrival);
+	}
+	else
+	{
+		_p->arrival_times[position] = arrival;
+	}
+	candles++;
+	return true;
+}
+
+
+//============================================================================
+std::expected<bool, AgisException>
+ExchangeMap::seal(std::string const& exchange_id, long long dt) noexcept
+{
+	AGIS_ASSIGN_OR_RETURN(exchange, this->get_exchange_mut(exchange_id));
+	exchange->seal(dt);
+	return true;
+}
+
+
+//============================================================================
+bool
+ExchangeMap::is_live() const noexcept
+{
+	return _p->live;
+}
+
+
+//============================================================================
+/// <summary>
+/// Number of leading dt index entries that every exchange is complete through and can be stepped
+/// </summary>
+size_t
+ExchangeMap::get_ready_count() const noexcept
+{
+	if (!_p->live) return _p->dt_index.size();
+	long long watermark = std::numeric_limits<long long>::max();
+	for (auto const& exchange : _p->exchanges)
+	{
+		watermark = std::min(watermark, exchange->get_watermark());
+	}
+	auto it = std::upper_bound(_p->dt_index.begin(), _p->dt_index.end(), watermark);
+	return static_cast<size_t>(std::distance(_p->dt_index.begin(), it));
+}
+
+
+//============================================================================
+long long
+ExchangeMap::get_arrival_time(size_t index) const noexcept
+{
+	if (index >= _p->arrival_times.size()) return 0;
+	return _p->arrival_times[index];
+}
+
+
 //============================================================================
 std::expected<Exchange*, AgisException>
 ExchangeMap::get_exchange_mut(std::string const& id) const noexcept
@@ -8,6 +8,7 @@ module;
 #endif
 
 #include "AgisDeclare.h"
+#include <tbb/task_group.h>
 
 export module ExchangeMapModule;
 
@@ -16,14 +17,30 @@ import <string>;
 import <vector>;
 import <expected>;
 import <optional>;
+import <span>;
 
 import AgisError;
+import AgisFileUtils;
+import AgisTypes;
+import ExchangeModule;
 
 namespace Agis
 {
 
 struct ExchangeMapPrivate;
 
+
+//============================================================================
+/// <summary>
+/// Global cursor of an exchange map and the cursors of its exchanges, in exchange index order
+/// </summary>
+export struct ExchangeMapSnapshot
+{
+	size_t current_index = 0;
+	long long global_dt = 0;
+	std::vector<ExchangeSnapshot> exchanges;
+};
+
 //============================================================================
 export class ExchangeFactory
 {
@@ -35,10 +52,15 @@ private:
 		std::string exchange_id,
 		std::string dt_format,
 		std::string source,
-		std::optional<std::vector<std::string>> symbols
+		std::optional<std::vector<std::string>> symbols,
+		std::optional<LoadWindow> window,
+		StoragePrecision precision
+	);
+	[[nodiscard]] std::expected<UniquePtr<Exchange>, AgisException> create_exchange(
+		std::string exchange_id,
+		MemorySource&& source,
+		StoragePrecision precision
 	);
-
-
 };
 
 export class ExchangeMap
@@ -48,18 +70,42 @@ export class ExchangeMap
 private:
 	ExchangeMapPrivate* _p;
 	size_t candles = 0;
-	std::expected<bool, AgisException> step() noexcept;
+	std::expected<bool, AgisException> step(tbb::task_group* pool = nullptr) noexcept;
 	std::expected<bool, AgisException> build() noexcept;
 	void reset() noexcept;
-	void process_orders(bool on_close) noexcept;
+	void process_orders(bool on_close, tbb::task_group* pool = nullptr) noexcept;
+	void set_profiling(bool enabled) noexcept;
 	[[nodiscard]] std::expected<Exchange const*, AgisException> create_exchange(
 		std::string exchange_id,
 		std::string dt_format,
 		std::string source,
-		std::optional<std::vector<std::string>> symbols
+		std::optional<std::vector<std::string>> symbols,
+		std::optional<LoadWindow> window,
+		StoragePrecision precision
+	);
+	[[nodiscard]] std::expected<Exchange const*, AgisException> create_exchange(
+		std::string exchange_id,
+		MemorySource&& source,
+		StoragePrecision precision
 	);
+	Exchange const* register_exchange(UniquePtr<Exchange> exchange) noexcept;
 	std::vector<Asset*> const& get_assets() const noexcept;
+	std::expected<bool, AgisException> fork_from(ExchangeMap const& other) noexcept;
+	ExchangeMapSnapshot snapshot() const noexcept;
+	std::expected<bool, AgisException> restore(ExchangeMapSnapshot const& snapshot) noexcept;
+	std::vector<Order const*> get_open_orders() const noexcept;
+	void restore_order(UniquePtr<Order> order) noexcept;
 	std::expected<bool, AgisException> force_place_order(Order* order, bool is_close) noexcept;
+	std::expected<bool, AgisException> enable_live(std::string const& exchange_id, size_t capacity) noexcept;
+	std::expected<bool, AgisException> append_bar(
+		std::string const& exchange_id,
+		std::string const& asset_id,
+		long long dt,
+		std::span<double const> values
+	) noexcept;
+	std::expected<bool, AgisException> seal(std::string const& exchange_id, long long dt) noexcept;
+	size_t get_ready_count() const noexcept;
+	long long get_arrival_time(size_t index) const noexcept;
 	AGIS_API [[nodiscard]] std::expected<Exchange*, AgisException> get_exchange_mut(std::string const& id) const noexcept;
 
 public:
@@ -76,6 +122,7 @@ public:
 	AGIS_API [[nodiscard]] std::expected<Exchange const*, AgisException> get_exchange(std::string const& id) const noexcept;
 	AGIS_API long long get_global_time() const noexcept;
 	long long get_next_time() const noexcept;
+	bool is_live() const noexcept;
 	[[nodiscard]] std::vector<long long> const& get_dt_index() const noexcept;
 };
 
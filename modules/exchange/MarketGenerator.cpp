@@ -0,0 +1,243 @@
+module;
+
+#include "AgisMacros.h"
+#include <tbb/parallel_for.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numbers>
+#include <random>
+
+module MarketGeneratorModule;
+
+namespace Agis
+{
+
+//============================================================================
+/// <summary>
+/// Random source of one generated series. The engine's output is fixed by the standard and the
+/// distributions are written out here, so a seed gives the same market on every platform.
+/// </summary>
+class SeriesRandom
+{
+public:
+	SeriesRandom(uint64_t seed, uint64_t stream) noexcept
+		: _engine(mix(seed ^ mix(stream + 1)))
+	{
+	}
+
+	/// <summary>
+	/// Uniform on [0, 1)
+	/// </summary>
+	double uniform() noexcept
+	{
+		return static_cast<double>(_engine() >> 11) * 0x1.0p-53;
+	}
+
+	/// <summary>
+	/// Standard normal by Box-Muller, the second value of each pair is kept for the next call
+	/// </summary>
+	double normal() noexcept
+	{
+		if (_has_spare)
+		{
+			_has_spare = false;
+			return _spare;
+		}
+		double u1 = 0.0;
+		while (u1 <= 0.0) u1 = uniform();
+		auto radius = std::sqrt(-2.0 * std::log(u1));
+		auto angle = 2.0 * std::numbers::pi * uniform();
+		_spare = radius * std::sin(angle);
+		_has_spare = true;
+		return radius * std::cos(angle);
+	}
+
+	bool chance(double probability) noexcept { return probability > 0.0 && uniform() < probability; }
+
+	/// <summary>
+	/// Uniform integer on [begin, end)
+	/// </summary>
+	size_t range(size_t begin, size_t end) noexcept
+	{
+		if (end <= begin) return begin;
+		return begin + static_cast<size_t>(uniform() * (end - begin));
+	}
+
+private:
+	static uint64_t mix(uint64_t x) noexcept
+	{
+		// splitmix64 finalizer, spreads nearby seeds and streams over the whole state
+		x += 0x9E3779B97F4A7C15ull;
+		x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+		x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+		return x ^ (x >> 31);
+	}
+
+	std::mt19937_64 _engine;
+	double _spare = 0.0;
+	bool _has_spare = false;
+};
+
+
+//============================================================================
+std::vector<std::string> const&
+generated_columns() noexcept
+{
+	static std::vector<std::string> const columns = { "OPEN", "HIGH", "LOW", "CLOSE", "VOLUME" };
+	return columns;
+}
+
+
+//============================================================================
+static std::expected<bool, AgisException>
+validate_config(MarketGeneratorConfig const& config) noexcept
+{
+	auto is_fraction = [](double value) { return value >= 0.0 && value <= 1.0; };
+	if (!config.asset_count || config.bar_count < 2)
+	{
+		return std::unexpected(AgisException("Generated market needs at least one asset and two bars"));
+	}
+	if (config.bar_interval <= 0 || config.timestamp_jitter < 0.0 || config.timestamp_jitter >= 1.0)
+	{
+		return std::unexpected(AgisException("Bar interval must be positive and timestamp jitter in [0, 1)"));
+	}
+	if (config.start_price <= 0.0 || config.volatility < 0.0 || config.jump_volatility < 0.0)
+	{
+		return std::unexpected(AgisException("Start price must be positive and volatilities non negative"));
+	}
+	if (!is_fraction(config.missing_probability) || !is_fraction(config.jump_probability) ||
+		!is_fraction(config.factor_share) || !is_fraction(config.listing_fraction) ||
+		!is_fraction(config.delisting_fraction))
+	{
+		return std::unexpected(AgisException("Generator probabilities and fractions must be in [0, 1]"));
+	}
+	if (config.process == PriceProcess::FACTOR && !config.factor_count)
+	{
+		return std::unexpected(AgisException("Factor process needs at least one factor"));
+	}
+	return true;
+}
+
+
+//============================================================================
+std::expected<MemorySource, AgisException>
+generate_market(MarketGeneratorConfig const& config) noexcept
+{
+	AGIS_ASSIGN_OR_RETURN(valid, validate_config(config));
+	auto const bars = config.bar_count;
+
+	// the calendar and the factors draw from streams past every asset's, so asset a is the same
+	// series whatever the number of assets generated alongside it
+	constexpr uint64_t calendar_stream = std::numeric_limits<uint64_t>::max();
+	constexpr uint64_t factor_stream = calendar_stream - 1;
+
+	// one timeline shared by every asset, assets differ only in which of its bars they print
+	SeriesRandom calendar_random(config.seed, calendar_stream);
+	std::vector<long long> timeline(bars);
+	for (size_t i = 0; i < bars; i++)
+	{
+		auto jitter = static_cast<long long>(calendar_random.uniform() * config.timestamp_jitter * config.bar_interval);
+		timeline[i] = config.start_dt + static_cast<long long>(i) * config.bar_interval + jitter;
+	}
+
+	// factor returns are common to every asset and drawn before the assets fan out
+	std::vector<double> factors;
+	if (config.process == PriceProcess::FACTOR)
+	{
+		SeriesRandom factor_random(config.seed, factor_stream);
+		factors.resize(bars * config.factor_count);
+		for (auto& factor : factors) factor = factor_random.normal();
+	}
+
+	auto width = std::to_string(config.asset_count - 1).size();
+	auto const& columns = generated_columns();
+	auto const cols = columns.size();
+	auto const vol = config.volatility;
+
+	MemorySource source;
+	source.columns = columns;
+	source.assets.resize(config.asset_count);
+	tbb::parallel_for(size_t(0), config.asset_count, [&](size_t a) {
+		// coverage draws come from their own stream so gaps and listings never change the prices
+		SeriesRandom random(config.seed, a);
+		SeriesRandom coverage(~config.seed, a);
+		auto& panel = source.assets[a];
+		auto id = std::to_string(a);
+		panel.asset_id = config.prefix + std::string(width - id.size(), '0') + id;
+
+		// listing window of the asset, a late listing falls in the first half of the market and
+		// an early delisting in the second so every asset keeps at least one bar
+		size_t first = 0;
+		size_t last = bars;
+		if (coverage.chance(config.listing_fraction)) first = coverage.range(1, bars / 2 + 1);
+		if (coverage.chance(config.delisting_fraction)) last = coverage.range(std::max(first + 1, bars / 2), bars);
+
+		std::vector<double> betas;
+		double beta_norm = 0.0;
+		if (config.process == PriceProcess::FACTOR)
+		{
+			betas.resize(config.factor_count);
+			for (auto& beta : betas)
+			{
+				beta = random.normal();
+				beta_norm += beta * beta;
+			}
+			beta_norm = beta_norm > 0.0 ? std::sqrt(beta_norm) : 1.0;
+		}
+		auto factor_weight = std::sqrt(config.factor_share);
+		auto idio_weight = std::sqrt(1.0 - config.factor_share);
+
+		panel.dt_index.reserve(last - first);
+		panel.data.reserve((last - first) * cols);
+		double close = config.start_price;
+		size_t gap = 0;
+		for (size_t i = 0; i < last; i++)
+		{
+			// the price moves on every bar of the timeline, missing bars are simply not printed
+			double shock = 0.0;
+			switch (config.process)
+			{
+				case PriceProcess::GBM:
+				case PriceProcess::JUMP_DIFFUSION:
+					shock = random.normal();
+					break;
+				case PriceProcess::FACTOR:
+				{
+					double common = 0.0;
+					for (size_t k = 0; k < betas.size(); k++) common += betas[k] * factors[i * betas.size() + k];
+					shock = factor_weight * common / beta_norm + idio_weight * random.normal();
+					break;
+				}
+			}
+			auto log_return = config.drift - 0.5 * vol * vol + vol * shock;
+			if (config.process == PriceProcess::JUMP_DIFFUSION && random.chance(config.jump_probability))
+			{
+				log_return += config.jump_mean + config.jump_volatility * random.normal();
+			}
+			auto open = close * std::exp(0.1 * vol * random.normal());
+			close *= std::exp(log_return);
+			auto high = std::max(open, close) * std::exp(0.5 * vol * std::abs(random.normal()));
+			auto low = std::min(open, close) * std::exp(-0.5 * vol * std::abs(random.normal()));
+			auto volume = config.volume_mean * std::exp(0.5 * random.normal() - 0.125);
+
+			if (i < first) continue;
+			if (gap)
+			{
+				gap--;
+				continue;
+			}
+			if (i > first && coverage.chance(config.missing_probability))
+			{
+				gap = config.missing_length ? config.missing_length - 1 : 0;
+				continue;
+			}
+			panel.dt_index.push_back(timeline[i]);
+			panel.data.insert(panel.data.end(), { open, high, low, close, volume });
+		}
+	});
+	return source;
+}
+
+}
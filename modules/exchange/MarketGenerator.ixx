@@ -0,0 +1,106 @@
+module;
+
+#pragma once
+#ifdef AGISCORE_EXPORTS
+#define AGIS_API __declspec(dllexport)
+#else
+#define AGIS_API __declspec(dllimport)
+#endif
+
+#include <cstdint>
+
+export module MarketGeneratorModule;
+
+import <string>;
+import <vector>;
+import <expected>;
+
+import AgisError;
+import AgisFileUtils;
+
+namespace Agis
+{
+
+//============================================================================
+/// <summary>
+/// Process that drives the close of every generated asset
+/// </summary>
+export enum class PriceProcess : uint8_t
+{
+	GBM,
+	JUMP_DIFFUSION,
+	FACTOR
+};
+
+
+//============================================================================
+/// <summary>
+/// Shape of a generated market. Rates are per bar and timestamps are epoch nanoseconds. The same
+/// config and seed always produce the same market, whatever the number of threads used.
+/// </summary>
+export struct MarketGeneratorConfig
+{
+	size_t asset_count = 10;
+	size_t bar_count = 252;
+	uint64_t seed = 1;
+	std::string prefix = "SYN";
+
+	PriceProcess process = PriceProcess::GBM;
+	double start_price = 100.0;
+	double drift = 0.0002;
+	double volatility = 0.01;
+	double volume_mean = 1e6;
+
+	/// <summary>
+	/// JUMP_DIFFUSION: chance of a jump on any bar and the normal distribution of the jump log return
+	/// </summary>
+	double jump_probability = 0.01;
+	double jump_mean = 0.0;
+	double jump_volatility = 0.05;
+
+	/// <summary>
+	/// FACTOR: number of common factors and the share of each asset's variance they explain
+	/// </summary>
+	size_t factor_count = 3;
+	double factor_share = 0.5;
+
+	/// <summary>
+	/// Bar times are start_dt + i * bar_interval, each pushed later by up to timestamp_jitter
+	/// of an interval so that consecutive times are irregular but stay strictly increasing
+	/// </summary>
+	long long start_dt = 946857600000000000;
+	long long bar_interval = 86400000000000;
+	double timestamp_jitter = 0.0;
+
+	/// <summary>
+	/// Chance that a gap of missing_length bars starts on any bar of an asset
+	/// </summary>
+	double missing_probability = 0.0;
+	size_t missing_length = 1;
+
+	/// <summary>
+	/// Share of assets that list after the first bar and that delist before the last one, listings
+	/// fall in the first half of the market and delistings in the second
+	/// </summary>
+	double listing_fraction = 0.0;
+	double delisting_fraction = 0.0;
+};
+
+
+//============================================================================
+/// <summary>
+/// Columns of every generated asset: OPEN, HIGH, LOW, CLOSE, VOLUME
+/// </summary>
+export AGIS_API std::vector<std::string> const& generated_columns() noexcept;
+
+
+//============================================================================
+/// <summary>
+/// Generate OHLCV panels for config.asset_count assets over a shared timeline of config.bar_count
+/// bars, ready to be passed to Hydra::create_exchange. Assets are generated concurrently.
+/// </summary>
+export AGIS_API [[nodiscard]] std::expected<MemorySource, AgisException> generate_market(
+	MarketGeneratorConfig const& config
+) noexcept;
+
+}
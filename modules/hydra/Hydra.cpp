@@ -3,6 +3,10 @@ module;
 #include "AgisMacros.h"
 #include "AgisDeclare.h"
 #include <tbb/task_group.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
 
 module HydraModule;
 
@@ -10,10 +14,18 @@ import PortfolioModule;
 import StrategyModule;
 import ExchangeMapModule;
 import ExchangeModule;
+import OrderModule;
+import AgisStepPool;
+import AgisProfiler;
 
 namespace Agis
 {
 
+/// <summary>
+/// Number of steps between checks of the interrupt flag in the batch run loop
+/// </summary>
+static constexpr size_t HYDRA_INTERRUPT_INTERVAL = 64;
+
 
 struct HydraPrivate
 {
@@ -24,6 +36,20 @@ struct HydraPrivate
 	size_t current_index = 0;
 	tbb::task_group pool;
 	bool built = false;
+	bool parallel_exchanges = false;
+	LatencyStats latency;
+
+	/// <summary>
+	/// Persistent workers that run the strategy phase of a step when enabled, and the strategies
+	/// collected for the current step in portfolio tree order
+	/// </summary>
+	UniquePtr<StepPool> step_pool;
+	std::vector<Strategy*> step_batch;
+
+	/// <summary>
+	/// Phase timings of the steps taken while profiling is enabled
+	/// </summary>
+	StepProfiler profiler;
 
 	HydraPrivate()
 		: exchanges()
@@ -35,6 +61,25 @@ struct HydraPrivate
 };
 
 
+//============================================================================
+/// <summary>
+/// Add the interval each exchange spent in phase during the current step to the trace, exchanges
+/// record their own intervals so this also picks up exchanges that ran on the task group
+/// </summary>
+static void
+trace_exchanges(HydraPrivate& p, StepPhase phase, uint64_t since) noexcept
+{
+	if (!p.profiler.tracing()) return;
+	for (auto const& [id, index] : p.exchanges.get_exchange_indecies())
+	{
+		auto exchange = p.exchanges.get_exchange(id);
+		if (!exchange) continue;
+		auto lane = static_cast<uint32_t>(index + 1);
+		p.profiler.trace_scope(exchange.value()->get_profile(), phase, lane, since);
+	}
+}
+
+
 //============================================================================
 Hydra::Hydra()
 {
@@ -91,8 +136,8 @@ Hydra::get_current_index() const noexcept
 
 
 //============================================================================
-std::expected<bool, AgisException> 
-Hydra::run() noexcept
+std::expected<bool, AgisException>
+Hydra::prepare_run() noexcept
 {
 	// build and reset all members as needed 
 	if(!_p->built)
@@ -100,19 +145,102 @@ Hydra::run() noexcept
 		AGIS_ASSIGN_OR_RETURN(res, build());
 	}
 	if (_p->current_index == 0) this->reset();
-	_mutex.lock();
+	return true;
+}
+
+
+//============================================================================
+size_t
+Hydra::run_end() const noexcept
+{
+	// a live run stops once it has caught up with the feed, bars can only be appended under the
+	// write lock so the bound can not move while a run holds it
+	if (_p->exchanges.is_live()) return _p->exchanges.get_ready_count();
+	return _p->exchanges.get_dt_index().size();
+}
+
+
+//============================================================================
+std::expected<size_t, AgisException>
+Hydra::run_range(size_t end, std::atomic<bool> const* stop) noexcept
+{
+	// end of data is checked once by the caller, only the interrupt flags are polled in the loop
 	_running.store(true);
-	auto index = _p->exchanges.get_dt_index();
-	for (size_t i = _p->current_index; i < index.size(); ++i)
+	size_t steps = 0;
+	while (_p->current_index < end)
 	{
-		AGIS_ASSIGN_OR_RETURN(res, step());
-		if (!_running.load()) break;
+		if (auto error = advance())
+		{
+			return std::unexpected(std::move(*error));
+		}
+		steps++;
+		if (steps % HYDRA_INTERRUPT_INTERVAL == 0)
+		{
+			if (!_running.load(std::memory_order_relaxed)) break;
+			if (stop && stop->load(std::memory_order_relaxed)) break;
+		}
 	}
-	_mutex.unlock();
+	return steps;
+}
+
+
+//============================================================================
+std::expected<bool, AgisException> 
+Hydra::run() noexcept
+{
+	AGIS_ASSIGN_OR_RETURN(prepared, prepare_run());
+	auto lock = std::unique_lock(_mutex);
+	AGIS_ASSIGN_OR_RETURN(steps, run_range(run_end()));
 	return true;
 }
 
 
+//============================================================================
+std::expected<size_t, AgisException>
+Hydra::run_n(size_t n) noexcept
+{
+	AGIS_ASSIGN_OR_RETURN(prepared, prepare_run());
+	auto lock = std::unique_lock(_mutex);
+	auto end = run_end();
+	if (end - std::min(end, _p->current_index) > n) end = _p->current_index + n;
+	return run_range(end);
+}
+
+
+//============================================================================
+std::expected<size_t, AgisException>
+Hydra::run_n(size_t n, std::atomic<bool> const& stop) noexcept
+{
+	AGIS_ASSIGN_OR_RETURN(prepared, prepare_run());
+	auto lock = std::unique_lock(_mutex);
+	auto end = run_end();
+	if (end - std::min(end, _p->current_index) > n) end = _p->current_index + n;
+	return run_range(end, &stop);
+}
+
+
+//============================================================================
+std::expected<size_t, AgisException>
+Hydra::run_until(long long dt) noexcept
+{
+	AGIS_ASSIGN_OR_RETURN(prepared, prepare_run());
+	auto lock = std::unique_lock(_mutex);
+	auto const& dt_index = _p->exchanges.get_dt_index();
+	auto end = run_end();
+	if (_p->current_index >= end) return 0;
+	auto last = std::upper_bound(dt_index.begin() + _p->current_index, dt_index.begin() + end, dt);
+	return run_range(static_cast<size_t>(last - dt_index.begin()));
+}
+
+
+//============================================================================
+UniquePtr<HydraRun>
+Hydra::run_async(ProgressCallback on_progress, size_t progress_interval)
+{
+	return std::make_unique<HydraRun>(*this, std::move(on_progress), progress_interval);
+}
+
+
 //============================================================================
 std::expected<bool, AgisException>
 Hydra::run_to(long long dt) noexcept
@@ -135,6 +263,7 @@ Hydra::build() noexcept
 	auto lock = std::unique_lock(_mutex);
 	AGIS_ASSIGN_OR_RETURN(res, _p->exchanges.build());
 	_p->master_portfolio.build(_p->exchanges.get_dt_index().size());
+	_p->exchanges.set_profiling(_p->profiler.enabled());
 	_p->built = true;
 	_state = HydraState::BUILT;
 	return true;
@@ -143,38 +272,237 @@ Hydra::build() noexcept
 std::expected<bool, AgisException>
 Hydra::step() noexcept
 {
-	if (_p->current_index == _p->exchanges.get_dt_index().size())
+	// a live Hydra waits until every exchange has all of its bars for the next time
+	if (_p->exchanges.is_live())
+	{
+		if (_p->current_index >= _p->exchanges.get_ready_count()) return false;
+	}
+	else if (_p->current_index == _p->exchanges.get_dt_index().size())
 	{
 		return std::unexpected<AgisException>(AgisException("End of data"));
 	}
+	if (auto error = advance())
+	{
+		return std::unexpected(std::move(*error));
+	}
+	return true;
+}
+
+
+//============================================================================
+std::optional<AgisException>
+Hydra::advance() noexcept
+{
+	// phases are timed back to back, each mark returns the start of the next phase
+	auto& profiler = _p->profiler;
+	bool profile = profiler.enabled();
+	uint64_t mark = 0;
+	if (profile)
+	{
+		profiler.begin_step(_p->current_index);
+		mark = read_cycles();
+	}
 
 	// step assets and exchanges forward in time
-	_p->exchanges.step();
+	_p->exchanges.step(_p->parallel_exchanges ? &_p->pool : nullptr);
+	if (profile)
+	{
+		trace_exchanges(*_p, StepPhase::EXCHANGE_STEP, mark);
+		mark = profiler.mark(StepPhase::EXCHANGE_STEP, mark);
+	}
 
 	// evaluate master portfolio at current time and prices
 	auto res_eval = _p->master_portfolio.evaluate(true, true);
-	if (!res_eval) return res_eval;
+	if (!res_eval) return std::move(res_eval.error());
+	if (profile) mark = profiler.mark(StepPhase::REPRICE, mark);
 
 	// step portfolios forward in time and call strategy next as needed
-	AGIS_ASSIGN_OR_RETURN(res,_p->master_portfolio.step());
-	_p->pool.wait();
+	if (_p->step_pool)
+	{
+		// each worker takes the same contiguous chunk of the batch every step and the call returns
+		// at the phase barrier once every chunk is done
+		auto& batch = _p->step_batch;
+		batch.clear();
+		auto res = _p->master_portfolio.step(&batch);
+		if (!res) return std::move(res.error());
+		_p->step_pool->run(batch.size(), [&batch](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) Portfolio::step_strategy(batch[i]);
+		});
+	}
+	else
+	{
+		auto res = _p->master_portfolio.step();
+		_p->pool.wait();
+		if (!res) return std::move(res.error());
+	}
+	if (profile) mark = profiler.mark(StepPhase::STRATEGY_STEP, mark);
 
 	// process any open orders
-	_p->exchanges.process_orders(true);
+	_p->exchanges.process_orders(true, _p->parallel_exchanges ? &_p->pool : nullptr);
+	if (profile)
+	{
+		trace_exchanges(*_p, StepPhase::PROCESS_ORDERS, mark);
+		mark = profiler.mark(StepPhase::PROCESS_ORDERS, mark);
+	}
 
 	// evaluate master portfolio at current time and prices
 	res_eval = _p->master_portfolio.evaluate(true, false);
-	if (!res_eval) return res_eval;
+	if (!res_eval) return std::move(res_eval.error());
+	if (profile) profiler.mark(StepPhase::EVALUATE, mark);
+
+	auto arrival = _p->exchanges.get_arrival_time(_p->current_index);
+	if (arrival)
+	{
+		auto latency = std::chrono::steady_clock::now().time_since_epoch().count() - arrival;
+		_p->latency.count++;
+		_p->latency.total_ns += latency;
+		_p->latency.max_ns = std::max(_p->latency.max_ns, latency);
+		_p->latency.last_ns = latency;
+	}
 
 	_p->current_index++;
-	if (_p->current_index == _p->exchanges.get_dt_index().size())
+	if (!_p->exchanges.is_live() && _p->current_index == _p->exchanges.get_dt_index().size())
 	{
 		_state = HydraState::FINISHED;
 	}
+	return std::nullopt;
+}
+
+
+//============================================================================
+std::expected<bool, AgisException>
+Hydra::enable_live(std::string const& exchange_id, size_t capacity) noexcept
+{
+	auto lock = std::unique_lock(_mutex);
+	return _p->exchanges.enable_live(exchange_id, capacity);
+}
+
+
+//============================================================================
+std::expected<bool, AgisException>
+Hydra::append_bar(
+	std::string const& exchange_id,
+	std::string const& asset_id,
+	long long dt,
+	std::span<double const> values) noexcept
+{
+	auto lock = std::unique_lock(_mutex);
+	return _p->exchanges.append_bar(exchange_id, asset_id, dt, values);
+}
+
+
+//============================================================================
+std::expected<bool, AgisException>
+Hydra::seal(std::string const& exchange_id, long long dt) noexcept
+{
+	auto lock = std::unique_lock(_mutex);
+	return _p->exchanges.seal(exchange_id, dt);
+}
+
+
+//============================================================================
+void
+Hydra::set_parallel_exchanges(bool enabled) noexcept
+{
+	auto lock = std::unique_lock(_mutex);
+	_p->parallel_exchanges = enabled;
+}
+
+
+//============================================================================
+void
+Hydra::set_step_workers(size_t workers) noexcept
+{
+	auto lock = std::unique_lock(_mutex);
+	if (!workers)
+	{
+		_p->step_pool.reset();
+		return;
+	}
+	if (_p->step_pool && _p->step_pool->size() == workers) return;
+	_p->step_pool = std::make_unique<StepPool>(workers);
+}
+
+
+//============================================================================
+void
+Hydra::set_profiling(bool enabled) noexcept
+{
+	auto lock = std::unique_lock(_mutex);
+	_p->profiler.set_enabled(enabled);
+	_p->exchanges.set_profiling(_p->profiler.enabled());
+	for (auto& [id, strategy] : _p->strategies)
+	{
+		strategy->_profile = _p->profiler.enabled();
+	}
+}
+
+
+//============================================================================
+void
+Hydra::set_profile_trace(size_t begin, size_t end) noexcept
+{
+	auto lock = std::unique_lock(_mutex);
+	_p->profiler.set_trace_window(begin, end);
+}
+
+
+//============================================================================
+StepProfile
+Hydra::get_profile() const noexcept
+{
+	StepProfile profile;
+	profile.steps = _p->profiler.steps();
+	profile.cycles_per_us = _p->profiler.cycles_per_us();
+	profile.phases = _p->profiler.scope().read();
+	auto& observers = profile.phases[static_cast<size_t>(StepPhase::OBSERVERS)];
+	for (auto const& [id, index] : _p->exchanges.get_exchange_indecies())
+	{
+		auto exchange = _p->exchanges.get_exchange(id);
+		if (!exchange) continue;
+		auto stats = exchange.value()->get_profile().read();
+		observers += stats[static_cast<size_t>(StepPhase::OBSERVERS)];
+		profile.exchanges[id] = stats;
+	}
+	for (auto const& [id, strategy] : _p->strategies)
+	{
+		auto stats = strategy->_step_profile.read();
+		profile.strategies[id] = stats;
+		profile.portfolios[strategy->get_portfolio_id()] += stats;
+	}
+	return profile;
+}
+
+
+//============================================================================
+std::expected<bool, AgisException>
+Hydra::write_profile_trace(std::string const& path) const noexcept
+{
+	auto lock = std::shared_lock(_mutex);
+	std::vector<std::string> lanes = { "hydra" };
+	for (auto const& [id, index] : _p->exchanges.get_exchange_indecies())
+	{
+		if (lanes.size() < index + 2) lanes.resize(index + 2);
+		lanes[index + 1] = id;
+	}
+	std::ofstream file(path, std::ios::out | std::ios::trunc);
+	if (!file.is_open())
+	{
+		return std::unexpected(AgisException("Failed to open profile trace file: " + path));
+	}
+	file << _p->profiler.trace_json(lanes);
 	return true;
 }
 
 
+//============================================================================
+LatencyStats const&
+Hydra::get_latency_stats() const noexcept
+{
+	return _p->latency;
+}
+
+
 //============================================================================
 std::expected<bool, AgisException>
 Hydra::reset() noexcept
@@ -183,11 +511,160 @@ Hydra::reset() noexcept
 	_p->exchanges.reset();
 	_p->master_portfolio.reset();
 	_p->current_index = 0;
+	_p->latency = LatencyStats{};
+	_p->profiler.clear();
+	for (auto& [id, strategy] : _p->strategies)
+	{
+		strategy->_step_profile.clear();
+	}
 	_state = HydraState::BUILT;
 	return true;
 }
 
 
+//============================================================================
+std::expected<UniquePtr<Hydra>, AgisException>
+Hydra::fork() const noexcept
+{
+	auto lock = std::shared_lock(_mutex);
+	auto hydra = std::make_unique<Hydra>();
+	AGIS_ASSIGN_OR_RETURN(res, hydra->_p->exchanges.fork_from(_p->exchanges));
+	hydra->_p->master_portfolio.build_mutex_map();
+	hydra->_p->parallel_exchanges = _p->parallel_exchanges;
+	return std::move(hydra);
+}
+
+
+//============================================================================
+std::expected<SharedPtr<HydraSnapshot const>, AgisException>
+Hydra::snapshot() const noexcept
+{
+	auto lock = std::shared_lock(_mutex);
+	if (!_p->built)
+	{
+		return std::unexpected(AgisException("Hydra must be built before taking a snapshot"));
+	}
+	if (_p->exchanges.is_live())
+	{
+		return std::unexpected(AgisException("Can not snapshot a live Hydra"));
+	}
+	auto snapshot = std::make_shared<HydraSnapshot>();
+	snapshot->current_index = _p->current_index;
+	snapshot->market = _p->exchanges.snapshot();
+	snapshot->portfolios.push_back(_p->master_portfolio.snapshot());
+	for (auto const& [id, portfolio] : _p->portfolios)
+	{
+		snapshot->portfolios.push_back(portfolio->snapshot());
+	}
+	for (auto const& [id, strategy] : _p->strategies)
+	{
+		snapshot->strategies.push_back(strategy->snapshot());
+	}
+	for (auto order : _p->exchanges.get_open_orders())
+	{
+		auto strategy = order->get_strategy();
+		if (!strategy)
+		{
+			return std::unexpected(AgisException("Can not snapshot an open order without a strategy"));
+		}
+		auto order_snapshot = order->snapshot();
+		order_snapshot.strategy_id = strategy->get_strategy_id();
+		snapshot->open_orders.push_back(std::move(order_snapshot));
+	}
+	return snapshot;
+}
+
+
+//============================================================================
+std::expected<bool, AgisException>
+Hydra::restore(HydraSnapshot const& snapshot) noexcept
+{
+	if (!_p->built)
+	{
+		AGIS_ASSIGN_OR_RETURN(res, build());
+	}
+	auto lock = std::unique_lock(_mutex);
+	if (snapshot.portfolios.size() != _p->portfolios.size() + 1 ||
+		snapshot.strategies.size() != _p->strategies.size())
+	{
+		return std::unexpected(AgisException("Snapshot portfolios and strategies do not match the Hydra"));
+	}
+	std::unordered_map<std::string, PortfolioSnapshot const*> portfolio_snapshots;
+	for (auto const& portfolio_snapshot : snapshot.portfolios)
+	{
+		if (portfolio_snapshot.portfolio_id != "master" && !_p->portfolios.contains(portfolio_snapshot.portfolio_id))
+		{
+			return std::unexpected(AgisException("Snapshot portfolio " + portfolio_snapshot.portfolio_id + " not found"));
+		}
+		portfolio_snapshots[portfolio_snapshot.portfolio_id] = &portfolio_snapshot;
+	}
+	for (auto const& strategy_snapshot : snapshot.strategies)
+	{
+		if (!_p->strategies.contains(strategy_snapshot.strategy_id))
+		{
+			return std::unexpected(AgisException("Snapshot strategy " + strategy_snapshot.strategy_id + " not found"));
+		}
+	}
+
+	// market first, positions evaluate against the restored asset cursors
+	AGIS_ASSIGN_OR_RETURN(res_market, _p->exchanges.restore(snapshot.market));
+
+	// rebuild the portfolio tree from an empty state: strategies recreate their open trades and
+	// portfolios relink them into positions from the top of the tree down, the order and trade
+	// histories freed by the reset are rebuilt from the snapshot
+	for (auto& [id, strategy] : _p->strategies)
+	{
+		strategy->release_trades();
+	}
+	_p->master_portfolio.reset();
+	for (auto const& strategy_snapshot : snapshot.strategies)
+	{
+		AGIS_ASSIGN_OR_RETURN(res, _p->strategies.at(strategy_snapshot.strategy_id)->restore(strategy_snapshot));
+	}
+	std::unordered_map<size_t, Order*> restored_orders;
+	std::function<std::expected<bool, AgisException>(Portfolio&)> restore_tree = [&](Portfolio& portfolio)
+		-> std::expected<bool, AgisException> {
+		auto it = portfolio_snapshots.find(portfolio.get_portfolio_id());
+		if (it == portfolio_snapshots.end())
+		{
+			return std::unexpected(AgisException("Snapshot portfolio " + portfolio.get_portfolio_id() + " missing"));
+		}
+		AGIS_ASSIGN_OR_RETURN(res, portfolio.restore(*it->second, _p->strategies, restored_orders));
+		for (auto& [index, child] : portfolio._child_portfolios)
+		{
+			AGIS_ASSIGN_OR_RETURN(res, restore_tree(*child));
+		}
+		return true;
+	};
+	AGIS_ASSIGN_OR_RETURN(res_tree, restore_tree(_p->master_portfolio));
+
+	for (auto const& order_snapshot : snapshot.open_orders)
+	{
+		auto it = _p->strategies.find(order_snapshot.strategy_id);
+		if (it == _p->strategies.end())
+		{
+			return std::unexpected(AgisException("Snapshot order strategy " + order_snapshot.strategy_id + " not found"));
+		}
+		auto strategy = it->second;
+		auto portfolio = strategy->get_portfolio_mut();
+		auto order = std::make_unique<Order>(
+			order_snapshot,
+			strategy,
+			strategy->get_strategy_index(),
+			strategy->_exchange.get_exchange_index(),
+			portfolio->get_portfolio_index()
+		);
+		order->set_parent_portfolio(portfolio);
+		_p->exchanges.restore_order(std::move(order));
+	}
+
+	_p->current_index = snapshot.current_index;
+	_p->latency = LatencyStats{};
+	_state = _p->current_index == _p->exchanges.get_dt_index().size() ? HydraState::FINISHED : HydraState::BUILT;
+	return true;
+}
+
+
 //============================================================================
 std::optional<Strategy const*>
 Hydra::get_strategy(std::string const& strategy_id) const noexcept
@@ -298,6 +775,7 @@ Hydra::register_strategy(std::unique_ptr<Strategy> strategy)
 	auto portfolio = strategy->get_portfolio_mut();
 	auto p = strategy.get();
 	auto id = strategy->get_strategy_id();
+	strategy->_profile = _p->profiler.enabled();
 	auto res = portfolio->add_strategy(std::move(strategy));
 	if (!res) return res;
 	_p->strategies[std::move(id)] = p;
@@ -374,11 +852,29 @@ Hydra::create_exchange(
 	std::string exchange_id,
 	std::string dt_format,
 	std::string source,
-	std::optional<std::vector<std::string>> symbols)
+	std::optional<std::vector<std::string>> symbols,
+	std::optional<LoadWindow> window,
+	StoragePrecision precision)
+{
+	auto lock = std::unique_lock(_mutex);
+	_p->built = false;
+	auto res = _p->exchanges.create_exchange(exchange_id, dt_format, source, symbols, window, precision);
+	if (!res) return res;
+	_p->master_portfolio.build_mutex_map();
+	return res.value();
+}
+
+
+//============================================================================
+std::expected<Exchange const*, AgisException>
+Hydra::create_exchange(
+	std::string exchange_id,
+	MemorySource source,
+	StoragePrecision precision)
 {
 	auto lock = std::unique_lock(_mutex);
 	_p->built = false;
-	auto res = _p->exchanges.create_exchange(exchange_id, dt_format, source, symbols);
+	auto res = _p->exchanges.create_exchange(exchange_id, std::move(source), precision);
 	if (!res) return res;
 	_p->master_portfolio.build_mutex_map();
 	return res.value();
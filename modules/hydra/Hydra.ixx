@@ -16,9 +16,14 @@ import <vector>;
 import <memory>;
 import <shared_mutex>;
 import <unordered_map>;
+import <span>;
 
 import AgisTypes;
 import AgisError;
+import AgisFileUtils;
+import HydraSnapshotModule;
+import HydraRunModule;
+import AgisProfiler;
 
 namespace Agis
 {
@@ -35,6 +40,22 @@ export enum class HydraState : uint8_t
 	FINISHED,
 };
 
+//============================================================================
+/// <summary>
+/// Bar to order latency of a live Hydra, measured from the arrival of the bar that completed a
+/// timestamp until the orders placed at that timestamp have been processed
+/// </summary>
+export struct LatencyStats
+{
+	size_t count = 0;
+	long long total_ns = 0;
+	long long max_ns = 0;
+	long long last_ns = 0;
+
+	double mean_ns() const noexcept { return count ? static_cast<double>(total_ns) / count : 0.0; }
+};
+
+
 export class Hydra
 {
 private:
@@ -43,6 +64,11 @@ private:
 	std::atomic<bool> _running = false;
 	mutable std::shared_mutex _mutex;
 
+	[[nodiscard]] Result<bool, AgisException> prepare_run() noexcept;
+	[[nodiscard]] Result<size_t, AgisException> run_range(size_t end, std::atomic<bool> const* stop = nullptr) noexcept;
+	[[nodiscard]] Optional<AgisException> advance() noexcept;
+	size_t run_end() const noexcept;
+
 public:
 	AGIS_API Hydra();
 	AGIS_API ~Hydra();
@@ -56,9 +82,103 @@ public:
 	AGIS_API [[nodiscard]] size_t get_current_index() const noexcept;
 	AGIS_API [[nodiscard]] Result<bool, AgisException> run() noexcept;
 	AGIS_API [[nodiscard]] Result<bool, AgisException> run_to(long long dt) noexcept;
+
+	/// <summary>
+	/// Step at most n times, or every step a live feed has ready. End of data is checked once
+	/// up front and interrupts are polled every few steps rather than on every step. Returns
+	/// the number of steps taken.
+	/// </summary>
+	AGIS_API [[nodiscard]] Result<size_t, AgisException> run_n(size_t n) noexcept;
+
+	/// <summary>
+	/// run_n that also stops within the interrupt interval once stop is set. stop belongs to the
+	/// caller and is never written here, so a request made before the call stops it as well.
+	/// </summary>
+	AGIS_API [[nodiscard]] Result<size_t, AgisException> run_n(size_t n, std::atomic<bool> const& stop) noexcept;
+
+	/// <summary>
+	/// Step through every remaining time up to and including dt using the same loop as run_n.
+	/// Returns the number of steps taken.
+	/// </summary>
+	AGIS_API [[nodiscard]] Result<size_t, AgisException> run_until(long long dt) noexcept;
+
+	/// <summary>
+	/// Run to the end of the data on a new thread and return the handle that reports its progress,
+	/// pauses, resumes, cancels and awaits it. The write lock is only held while stepping, in chunks
+	/// of progress_interval steps.
+	/// </summary>
+	AGIS_API [[nodiscard]] UniquePtr<HydraRun> run_async(
+		ProgressCallback on_progress = nullptr,
+		size_t progress_interval = HYDRA_PROGRESS_INTERVAL
+	);
 	AGIS_API [[nodiscard]] Result<bool, AgisException> build() noexcept;
 	AGIS_API [[nodiscard]] Result<bool, AgisException> step() noexcept;
+	AGIS_API [[nodiscard]] Result<bool, AgisException> enable_live(std::string const& exchange_id, size_t capacity) noexcept;
+	AGIS_API [[nodiscard]] Result<bool, AgisException> append_bar(
+		std::string const& exchange_id,
+		std::string const& asset_id,
+		long long dt,
+		std::span<double const> values
+	) noexcept;
+	AGIS_API [[nodiscard]] Result<bool, AgisException> seal(std::string const& exchange_id, long long dt) noexcept;
+	AGIS_API [[nodiscard]] LatencyStats const& get_latency_stats() const noexcept;
+
+	/// <summary>
+	/// Time every phase of each step, per exchange and per strategy, with the time stamp counter.
+	/// Disabled by default, a disabled profiler costs one branch per phase and defining
+	/// AGIS_DISABLE_PROFILER removes it entirely. Timings are cleared on reset.
+	/// </summary>
+	AGIS_API void set_profiling(bool enabled) noexcept;
+
+	/// <summary>
+	/// Keep trace events for the steps with index in [begin, end) while profiling
+	/// </summary>
+	AGIS_API void set_profile_trace(size_t begin, size_t end) noexcept;
+
+	/// <summary>
+	/// Copy of the timings so far, safe to call from another thread while a run is in progress
+	/// </summary>
+	AGIS_API [[nodiscard]] StepProfile get_profile() const noexcept;
+
+	/// <summary>
+	/// Write the traced steps to path as Chrome trace event JSON, one lane for the Hydra and one per exchange
+	/// </summary>
+	AGIS_API [[nodiscard]] Result<bool, AgisException> write_profile_trace(std::string const& path) const noexcept;
+
+	/// <summary>
+	/// Step exchanges and fill their open orders concurrently on the Hydra's task group when more than
+	/// one exchange has data at the current time. Filled orders still reach portfolios in exchange order
+	/// so results are identical to the serial path.
+	/// </summary>
+	AGIS_API void set_parallel_exchanges(bool enabled) noexcept;
+
+	/// <summary>
+	/// Run the strategies of each step on the given number of long lived threads, the calling thread
+	/// included, instead of spawning a task per strategy on every step. Strategies are split into fixed
+	/// contiguous chunks per thread and the phase ends on a spin then block barrier. Pass 0 to return
+	/// to the task group.
+	/// </summary>
+	AGIS_API void set_step_workers(size_t workers) noexcept;
 	AGIS_API [[nodiscard]] Result<bool, AgisException> reset() noexcept;
+
+	/// <summary>
+	/// Create a Hydra over the same exchanges without reloading them. The fork shares every asset panel
+	/// and copies the built indices, it owns its own asset cursors, observers, portfolios and strategies.
+	/// This Hydra must outlive the fork and must not add exchanges while forks exist.
+	/// </summary>
+	AGIS_API [[nodiscard]] Result<UniquePtr<Hydra>, AgisException> fork() const noexcept;
+
+	/// <summary>
+	/// Capture the run state at the current index. The snapshot is immutable and shared, it can be
+	/// restored any number of times into this Hydra or into forks that were given the same setup.
+	/// </summary>
+	AGIS_API [[nodiscard]] Result<SharedPtr<HydraSnapshot const>, AgisException> snapshot() const noexcept;
+
+	/// <summary>
+	/// Return to the state captured by snapshot. Market cursors are set directly and asset observers
+	/// replay only their own asset's rows, no strategy or portfolio work is repeated.
+	/// </summary>
+	AGIS_API [[nodiscard]] Result<bool, AgisException> restore(HydraSnapshot const& snapshot) noexcept;
 	AGIS_API [[nodiscard]] std::unordered_map<std::string, Strategy*> const& get_strategies() const noexcept;
 	AGIS_API [[nodiscard]] Optional<Strategy const*> get_strategy(std::string const& strategy_id) const noexcept;
 	AGIS_API [[nodiscard]] Optional<Strategy*> get_strategy_mut(std::string const& strategy_id) const noexcept;
@@ -83,7 +203,19 @@ public:
 		std::string exchange_id,
 		std::string dt_format,
 		std::string source,
-		Optional<std::vector<std::string>> symbols = std::nullopt
+		Optional<std::vector<std::string>> symbols = std::nullopt,
+		Optional<LoadWindow> window = std::nullopt,
+		StoragePrecision precision = StoragePrecision::FLOAT64
+	);
+
+	/// <summary>
+	/// Create an exchange over panels held in memory, such as a generated market. The exchange
+	/// takes ownership of the panels and is otherwise identical to one loaded from disk.
+	/// </summary>
+	AGIS_API [[nodiscard]] Result<Exchange const*, AgisException> create_exchange(
+		std::string exchange_id,
+		MemorySource source,
+		StoragePrecision precision = StoragePrecision::FLOAT64
 	);
 };
 
@@ -0,0 +1,109 @@
+module;
+
+#include "AgisMacros.h"
+#include "AgisDeclare.h"
+#include <charconv>
+
+module HydraFeedModule;
+
+import HydraModule;
+
+namespace Agis
+{
+
+
+//============================================================================
+FileTailFeed::FileTailFeed(Hydra& hydra, std::string path, std::string dt_format)
+	: _hydra(hydra), _path(std::move(path)), _dt_parser(std::move(dt_format))
+{
+}
+
+
+//============================================================================
+std::expected<size_t, AgisException>
+FileTailFeed::poll() noexcept
+{
+	if (!_stream.is_open())
+	{
+		_stream.open(_path, std::ios::binary);
+		if (!_stream.is_open())
+		{
+			return std::unexpected(AgisException("Could not open feed " + _path));
+		}
+	}
+
+	size_t lines = 0;
+	std::string line;
+	while (std::getline(_stream, line))
+	{
+		// getline hitting end of file means the writer has not finished this line yet
+		if (_stream.eof())
+		{
+			_partial += line;
+			break;
+		}
+		if (!_partial.empty())
+		{
+			line = _partial + line;
+			_partial.clear();
+		}
+		if (!line.empty() && line.back() == '\r') line.pop_back();
+		if (line.empty()) continue;
+		AGIS_ASSIGN_OR_RETURN(res, this->process_line(line));
+		lines++;
+	}
+	// clear end of file so the next poll picks up where this one stopped
+	_stream.clear();
+	return lines;
+}
+
+
+//============================================================================
+std::expected<size_t, AgisException>
+FileTailFeed::poll_and_step() noexcept
+{
+	AGIS_ASSIGN_OR_RETURN(lines, this->poll());
+	while (true)
+	{
+		AGIS_ASSIGN_OR_RETURN(stepped, _hydra.step());
+		if (!stepped) break;
+	}
+	return lines;
+}
+
+
+//============================================================================
+std::expected<bool, AgisException>
+FileTailFeed::process_line(std::string_view line) noexcept
+{
+	auto next_field = [&line]() {
+		auto comma = line.find(',');
+		auto field = line.substr(0, comma);
+		line.remove_prefix(comma == std::string_view::npos ? line.size() : comma + 1);
+		return field;
+	};
+	auto exchange_id = std::string(next_field());
+	auto asset_id = std::string(next_field());
+	AGIS_ASSIGN_OR_RETURN(dt, _dt_parser.parse(next_field()));
+	if (asset_id.empty())
+	{
+		return _hydra.seal(exchange_id, dt);
+	}
+
+	_values.clear();
+	while (!line.empty())
+	{
+		auto field = next_field();
+		while (!field.empty() && field.front() == ' ') field.remove_prefix(1);
+		double value = 0.0;
+		auto [ptr, ec] = std::from_chars(field.data(), field.data() + field.size(), value);
+		if (ec != std::errc())
+		{
+			return std::unexpected(AgisException("Failed to parse feed value for " + asset_id));
+		}
+		_values.push_back(value);
+	}
+	return _hydra.append_bar(exchange_id, asset_id, dt, _values);
+}
+
+}
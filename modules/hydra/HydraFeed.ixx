@@ -0,0 +1,62 @@
+module;
+
+#pragma once
+#ifdef AGISCORE_EXPORTS
+#define AGIS_API __declspec(dllexport)
+#else
+#define AGIS_API __declspec(dllimport)
+#endif
+
+#include "AgisDeclare.h"
+
+export module HydraFeedModule;
+
+import <string>;
+import <string_view>;
+import <vector>;
+import <fstream>;
+import <expected>;
+
+import AgisError;
+import AgisTimeUtils;
+
+namespace Agis
+{
+
+//============================================================================
+/// <summary>
+/// Reference live feed that tails a text file or named pipe of bars and appends them to a
+/// live Hydra. Every line is either a bar
+///     exchange_id,asset_id,datetime,value_0,...,value_n
+/// with one value per exchange column, or a seal with an empty asset id
+///     exchange_id,,datetime
+/// marking the exchange complete through datetime. A partially written last line is held
+/// back until the rest of it arrives.
+/// </summary>
+export class FileTailFeed
+{
+public:
+	AGIS_API FileTailFeed(Hydra& hydra, std::string path, std::string dt_format);
+
+	/// <summary>
+	/// Append every complete line written since the last poll, returns the number of lines consumed
+	/// </summary>
+	AGIS_API [[nodiscard]] std::expected<size_t, AgisException> poll() noexcept;
+
+	/// <summary>
+	/// Poll the feed and step the Hydra through every timestamp the new bars completed
+	/// </summary>
+	AGIS_API [[nodiscard]] std::expected<size_t, AgisException> poll_and_step() noexcept;
+
+private:
+	std::expected<bool, AgisException> process_line(std::string_view line) noexcept;
+
+	Hydra& _hydra;
+	std::string _path;
+	std::ifstream _stream;
+	std::string _partial;
+	std::vector<double> _values;
+	DateTimeParser _dt_parser;
+};
+
+}
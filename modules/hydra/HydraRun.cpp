@@ -0,0 +1,178 @@
+module;
+
+#include "AgisDeclare.h"
+#include <algorithm>
+
+module HydraRunModule;
+
+import HydraModule;
+
+namespace Agis
+{
+
+//============================================================================
+HydraRun::HydraRun(Hydra& hydra, ProgressCallback on_progress, size_t progress_interval)
+	: _hydra(hydra)
+	, _on_progress(std::move(on_progress))
+	, _progress_interval(std::max<size_t>(progress_interval, 1))
+	, _start(std::chrono::steady_clock::now())
+	, _future(_promise.get_future().share())
+{
+	_thread = std::thread([this] { this->run(); });
+}
+
+
+//============================================================================
+HydraRun::~HydraRun()
+{
+	cancel();
+	if (_thread.joinable()) _thread.join();
+}
+
+
+//============================================================================
+void
+HydraRun::pause() noexcept
+{
+	auto lock = std::unique_lock(_control_mutex);
+	if (_status != RunStatus::RUNNING) return;
+	_pause_requested = true;
+	_stop.store(true);
+}
+
+
+//============================================================================
+void
+HydraRun::resume() noexcept
+{
+	auto lock = std::unique_lock(_control_mutex);
+	_pause_requested = false;
+	_control_cv.notify_all();
+}
+
+
+//============================================================================
+void
+HydraRun::cancel() noexcept
+{
+	auto lock = std::unique_lock(_control_mutex);
+	if (_status != RunStatus::RUNNING && _status != RunStatus::PAUSED) return;
+	_cancel_requested = true;
+	_stop.store(true);
+	_control_cv.notify_all();
+}
+
+
+//============================================================================
+RunStatus
+HydraRun::status() const noexcept
+{
+	auto lock = std::unique_lock(_control_mutex);
+	return _status;
+}
+
+
+//============================================================================
+RunProgress
+HydraRun::progress() const noexcept
+{
+	auto lock = std::unique_lock(_control_mutex);
+	return _progress;
+}
+
+
+//============================================================================
+bool
+HydraRun::done() const noexcept
+{
+	return _future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+
+//============================================================================
+Result<size_t, AgisException>
+HydraRun::wait() const
+{
+	return _future.get();
+}
+
+
+//============================================================================
+bool
+HydraRun::wait_while_paused() noexcept
+{
+	auto lock = std::unique_lock(_control_mutex);
+	if (_pause_requested && !_cancel_requested)
+	{
+		_status = RunStatus::PAUSED;
+		auto paused_at = std::chrono::steady_clock::now();
+		_control_cv.wait(lock, [this] { return !_pause_requested || _cancel_requested; });
+		_paused_time += std::chrono::steady_clock::now() - paused_at;
+		_status = RunStatus::RUNNING;
+	}
+	// a pause handled by waiting leaves the stop flag set, reset it so it does not cut the next
+	// chunk short. Pause and cancel take this lock, any issued from here on stop the chunk
+	if (!_cancel_requested) _stop.store(false);
+	return !_cancel_requested;
+}
+
+
+//============================================================================
+void
+HydraRun::report(size_t steps) noexcept
+{
+	RunProgress progress;
+	progress.index = _hydra.get_current_index();
+	progress.end = _hydra.get_dt_index().size();
+	progress.global_time = _hydra.get_global_time();
+	progress.steps = steps;
+	auto active = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start - _paused_time).count();
+	progress.steps_per_sec = active > 0.0 ? steps / active : 0.0;
+	{
+		auto lock = std::unique_lock(_control_mutex);
+		_progress = progress;
+	}
+	if (_on_progress) _on_progress(progress);
+}
+
+
+//============================================================================
+void
+HydraRun::finish(RunStatus status, Result<size_t, AgisException> result) noexcept
+{
+	{
+		auto lock = std::unique_lock(_control_mutex);
+		_status = status;
+	}
+	_promise.set_value(std::move(result));
+}
+
+
+//============================================================================
+void
+HydraRun::run() noexcept
+{
+	// each chunk is a run_n under the Hydra's write lock, the lock is free between chunks. The stop
+	// flag cuts a chunk short, a chunk that takes no steps means the data has run out.
+	size_t steps = 0;
+	while (wait_while_paused())
+	{
+		auto res = _hydra.run_n(_progress_interval, _stop);
+		if (!res)
+		{
+			report(steps);
+			finish(RunStatus::FAILED, std::unexpected(std::move(res.error())));
+			return;
+		}
+		steps += *res;
+		report(steps);
+		if (!*res)
+		{
+			finish(RunStatus::FINISHED, steps);
+			return;
+		}
+	}
+	finish(RunStatus::CANCELLED, steps);
+}
+
+}
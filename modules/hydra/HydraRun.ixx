@@ -0,0 +1,130 @@
+module;
+
+#pragma once
+#ifdef AGISCORE_EXPORTS
+#define AGIS_API __declspec(dllexport)
+#else
+#define AGIS_API __declspec(dllimport)
+#endif
+
+#include "AgisDeclare.h"
+
+export module HydraRunModule;
+
+import <atomic>;
+import <chrono>;
+import <condition_variable>;
+import <functional>;
+import <future>;
+import <mutex>;
+import <thread>;
+
+import AgisTypes;
+import AgisError;
+
+namespace Agis
+{
+
+//============================================================================
+/// <summary>
+/// Steps between progress reports of an asynchronous run unless another cadence is given
+/// </summary>
+export constexpr size_t HYDRA_PROGRESS_INTERVAL = 4096;
+
+
+//============================================================================
+export enum class RunStatus : uint8_t
+{
+	RUNNING,
+	PAUSED,
+	CANCELLED,
+	FINISHED,
+	FAILED
+};
+
+
+//============================================================================
+/// <summary>
+/// Position of an asynchronous run as of its last report. Steps per second is taken over the time
+/// spent running, time spent paused is left out.
+/// </summary>
+export struct RunProgress
+{
+	size_t index = 0;
+	size_t end = 0;
+	long long global_time = 0;
+	size_t steps = 0;
+	double steps_per_sec = 0.0;
+};
+
+export using ProgressCallback = std::function<void(RunProgress const&)>;
+
+
+//============================================================================
+/// <summary>
+/// Handle to a Hydra run on its own thread. The run steps in chunks of the progress interval and
+/// holds the Hydra's write lock only inside a chunk, so between chunks and while paused the Hydra can
+/// be read under its shared lock. Control calls never take the Hydra's lock, pause and cancel set the
+/// run's own stop flag and take effect within the Hydra's interrupt interval. Destroying the handle
+/// cancels the run and joins its thread, the Hydra must outlive the handle.
+/// </summary>
+export class HydraRun
+{
+public:
+	/// <summary>
+	/// Start running hydra to the end of its data. on_progress is called on the run's thread after
+	/// every progress_interval steps and once more when the run ends, without the Hydra's lock held.
+	/// It must not throw.
+	/// </summary>
+	AGIS_API HydraRun(Hydra& hydra, ProgressCallback on_progress = nullptr, size_t progress_interval = HYDRA_PROGRESS_INTERVAL);
+	AGIS_API ~HydraRun();
+
+	HydraRun(HydraRun const&) = delete;
+	HydraRun& operator=(HydraRun const&) = delete;
+
+	AGIS_API void pause() noexcept;
+	AGIS_API void resume() noexcept;
+	AGIS_API void cancel() noexcept;
+
+	AGIS_API [[nodiscard]] RunStatus status() const noexcept;
+	AGIS_API [[nodiscard]] RunProgress progress() const noexcept;
+	AGIS_API [[nodiscard]] bool done() const noexcept;
+
+	/// <summary>
+	/// Future of the number of steps the run took, ready once the run has finished, failed or been
+	/// cancelled. A cancelled run keeps the state it reached and is not an error.
+	/// </summary>
+	AGIS_API [[nodiscard]] std::shared_future<Result<size_t, AgisException>> future() const noexcept { return _future; }
+
+	/// <summary>
+	/// Block until the run ends and return its outcome
+	/// </summary>
+	AGIS_API [[nodiscard]] Result<size_t, AgisException> wait() const;
+
+private:
+	void run() noexcept;
+	bool wait_while_paused() noexcept;
+	void report(size_t steps) noexcept;
+	void finish(RunStatus status, Result<size_t, AgisException> result) noexcept;
+
+	Hydra& _hydra;
+	ProgressCallback _on_progress;
+	size_t _progress_interval;
+
+	mutable std::mutex _control_mutex;
+	std::condition_variable _control_cv;
+	RunStatus _status = RunStatus::RUNNING;
+	bool _pause_requested = false;
+	bool _cancel_requested = false;
+	std::atomic<bool> _stop = false;
+	RunProgress _progress;
+
+	std::chrono::steady_clock::time_point _start;
+	std::chrono::steady_clock::duration _paused_time{};
+
+	std::promise<Result<size_t, AgisException>> _promise;
+	std::shared_future<Result<size_t, AgisException>> _future;
+	std::thread _thread;
+};
+
+}
@@ -0,0 +1,35 @@
+module;
+
+#pragma once
+#include "AgisDeclare.h"
+
+export module HydraSnapshotModule;
+
+import <string>;
+import <vector>;
+
+import OrderModule;
+import ExchangeMapModule;
+import PortfolioModule;
+import StrategyModule;
+
+namespace Agis
+{
+
+//============================================================================
+/// <summary>
+/// In memory copy of the run state of a Hydra between two steps: market cursors, portfolios,
+/// positions, open trades, tracers and the orders resting on exchanges. Portfolios and strategies
+/// are referenced by id, a snapshot restores into the Hydra it was taken from or into any Hydra
+/// over the same exchanges with the same portfolios and strategies, such as a fork given the same setup.
+/// </summary>
+export struct HydraSnapshot
+{
+	size_t current_index = 0;
+	ExchangeMapSnapshot market;
+	std::vector<PortfolioSnapshot> portfolios;
+	std::vector<StrategySnapshot> strategies;
+	std::vector<OrderSnapshot> open_orders;
+};
+
+}
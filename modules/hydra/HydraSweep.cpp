@@ -0,0 +1,125 @@
+module;
+
+#include "AgisMacros.h"
+#include "AgisDeclare.h"
+#include <tbb/task_arena.h>
+#include <tbb/parallel_for.h>
+#include <algorithm>
+
+module HydraSweepModule;
+
+import HydraModule;
+import PortfolioModule;
+import StrategyTracerModule;
+
+namespace Agis
+{
+
+
+//============================================================================
+HydraSweep::HydraSweep(Hydra const& base, size_t parallelism)
+	: _base(base), _parallelism(parallelism)
+{
+}
+
+
+//============================================================================
+SweepRun
+HydraSweep::run_one(size_t run_index, SweepSetup const& setup, HydraSnapshot const* from) const noexcept
+{
+	SweepRun result;
+	result.run_index = run_index;
+	auto hydra = _base.fork();
+	if (!hydra)
+	{
+		result.error = hydra.error();
+		return result;
+	}
+	// setup is user code called from inside the sweep's tasks, it must not unwind through them
+	std::expected<bool, AgisException> setup_res;
+	try
+	{
+		setup_res = setup(**hydra, run_index);
+	}
+	catch (std::exception const& e)
+	{
+		result.error = AgisException("Sweep setup threw: " + std::string(e.what()));
+		return result;
+	}
+	catch (...)
+	{
+		result.error = AgisException("Sweep setup threw an unknown exception");
+		return result;
+	}
+	if (!setup_res)
+	{
+		result.error = setup_res.error();
+		return result;
+	}
+	if (from)
+	{
+		auto restore_res = (*hydra)->restore(*from);
+		if (!restore_res)
+		{
+			result.error = restore_res.error();
+			return result;
+		}
+	}
+	auto run_res = (*hydra)->run();
+	if (!run_res)
+	{
+		result.error = run_res.error();
+		return result;
+	}
+
+	// collect the master portfolio's histories and summarize them
+	auto master = (*hydra)->get_portfolio("master").value();
+	auto const& tracers = master->get_tracers();
+	if (auto nlv = tracers.get_column(Tracer::NLV)) result.nlv_history = **nlv;
+	if (auto cash = tracers.get_column(Tracer::CASH)) result.cash_history = **cash;
+	if (!result.nlv_history.empty())
+	{
+		result.starting_nlv = result.nlv_history.front();
+		result.final_nlv = result.nlv_history.back();
+		if (result.starting_nlv != 0.0)
+		{
+			result.total_return = result.final_nlv / result.starting_nlv - 1.0;
+		}
+		double peak = result.nlv_history.front();
+		for (auto nlv : result.nlv_history)
+		{
+			peak = std::max(peak, nlv);
+			if (peak > 0.0) result.max_drawdown = std::max(result.max_drawdown, (peak - nlv) / peak);
+		}
+	}
+	return result;
+}
+
+
+//============================================================================
+std::expected<SweepTable, AgisException>
+HydraSweep::run(size_t run_count, SweepSetup const& setup, SharedPtr<HydraSnapshot const> from) noexcept
+{
+	if (!setup)
+	{
+		return std::unexpected(AgisException("Sweep setup is empty"));
+	}
+	if (_base.get_dt_index().empty())
+	{
+		return std::unexpected(AgisException("Sweep base Hydra has not been built"));
+	}
+	SweepTable table;
+	table.dt_index = _base.get_dt_index();
+	table.runs.resize(run_count);
+
+	auto concurrency = _parallelism ? static_cast<int>(_parallelism) : tbb::task_arena::automatic;
+	tbb::task_arena arena(concurrency);
+	arena.execute([&] {
+		tbb::parallel_for(size_t(0), run_count, [&](size_t i) {
+			table.runs[i] = run_one(i, setup, from.get());
+		});
+	});
+	return table;
+}
+
+}
@@ -0,0 +1,102 @@
+module;
+
+#pragma once
+#ifdef AGISCORE_EXPORTS
+#define AGIS_API __declspec(dllexport)
+#else
+#define AGIS_API __declspec(dllimport)
+#endif
+
+#include "AgisDeclare.h"
+
+export module HydraSweepModule;
+
+import <string>;
+import <vector>;
+import <optional>;
+import <expected>;
+import <functional>;
+
+import AgisError;
+import HydraSnapshotModule;
+
+namespace Agis
+{
+
+//============================================================================
+/// <summary>
+/// Outcome of a single run of a parameter sweep. Histories are the master portfolio's tracers
+/// sampled on the global dt index.
+/// </summary>
+export struct SweepRun
+{
+	size_t run_index = 0;
+	std::optional<AgisException> error;
+	std::vector<double> nlv_history;
+	std::vector<double> cash_history;
+	double starting_nlv = 0.0;
+	double final_nlv = 0.0;
+	double total_return = 0.0;
+	double max_drawdown = 0.0;
+};
+
+
+//============================================================================
+/// <summary>
+/// Results of every run of a sweep, runs are ordered by run index regardless of completion order
+/// </summary>
+export struct SweepTable
+{
+	std::vector<long long> dt_index;
+	std::vector<SweepRun> runs;
+};
+
+
+//============================================================================
+/// <summary>
+/// Called once per run on a fresh fork of the base Hydra to create that run's portfolios and
+/// strategies for the given run index. Runs are set up concurrently on different forks, so setup must
+/// be safe to call from several threads at once. An exception thrown by setup is caught and recorded
+/// as that run's error.
+/// </summary>
+export using SweepSetup = std::function<std::expected<bool, AgisException>(Hydra&, size_t)>;
+
+
+//============================================================================
+/// <summary>
+/// Runs the same strategy setup with many parameter combinations over one loaded set of exchanges.
+/// Every run gets a fork of the base Hydra that shares its asset panels and built indices and owns
+/// only its run state, runs execute concurrently up to the configured degree of parallelism.
+/// </summary>
+export class HydraSweep
+{
+public:
+	/// <summary>
+	/// Sweep over the exchanges of base, which must stay alive and unchanged for the sweep's lifetime.
+	/// A parallelism of 0 uses every available core.
+	/// </summary>
+	AGIS_API HydraSweep(Hydra const& base, size_t parallelism = 0);
+
+	AGIS_API void set_parallelism(size_t parallelism) noexcept { _parallelism = parallelism; }
+	AGIS_API size_t get_parallelism() const noexcept { return _parallelism; }
+
+	/// <summary>
+	/// Fork the base run_count times, apply setup to each fork and run it to completion. A run whose
+	/// setup or run fails records the error and does not stop the rest of the sweep. Given a snapshot,
+	/// every fork is restored from it after setup and continues from the snapshot's index instead of
+	/// starting over, setup must create the portfolios and strategies the snapshot was taken with.
+	/// </summary>
+	AGIS_API [[nodiscard]] std::expected<SweepTable, AgisException> run(
+		size_t run_count,
+		SweepSetup const& setup,
+		SharedPtr<HydraSnapshot const> from = nullptr
+	) noexcept;
+
+private:
+	SweepRun run_one(size_t run_index, SweepSetup const& setup, HydraSnapshot const* from) const noexcept;
+
+	Hydra const& _base;
+	size_t _parallelism;
+};
+
+}
@@ -21,6 +21,8 @@ import HydraModule;
 import StrategyModule;
 import ASTStrategyModule;
 import PortfolioModule;
+import AgisFileUtils;
+import AgisTypes;
 
 namespace Agis
 {
@@ -58,6 +60,30 @@ serialize_exchange(
 		j.AddMember("symbols", std::move(symbols_json), allocator);
 	}
 
+	// save the load window if the exchange was restricted to one
+	if (exchange.window())
+	{
+		auto const& window = *exchange.window();
+		rapidjson::Document window_json(rapidjson::kObjectType);
+		if (window.start) window_json.AddMember("start", rapidjson::Value(static_cast<int64_t>(*window.start)), allocator);
+		if (window.end) window_json.AddMember("end", rapidjson::Value(static_cast<int64_t>(*window.end)), allocator);
+		if (window.columns)
+		{
+			rapidjson::Document columns_json(rapidjson::kArrayType);
+			for (auto const& column : *window.columns)
+			{
+				rapidjson::Value v_column(column.c_str(), allocator);
+				columns_json.PushBack(v_column.Move(), allocator);
+			}
+			window_json.AddMember("columns", std::move(columns_json), allocator);
+		}
+		j.AddMember("window", std::move(window_json), allocator);
+	}
+	if (exchange.precision() == StoragePrecision::FLOAT32)
+	{
+		j.AddMember("precision", "float32", allocator);
+	}
+
 	return j;
 }
 
@@ -208,7 +234,47 @@ deserialize_exchange_map(rapidjson::Document const& json, Hydra* hydra)
 			_symbols = symbols_vec;
 		}
 
-		auto res = hydra->create_exchange(exchange_id, dt_format, source, _symbols);
+		// load in the load window if it exists
+		std::optional<LoadWindow> _window;
+		if (exchange.value.HasMember("window"))
+		{
+			auto& window_json = exchange.value["window"];
+			if (!window_json.IsObject())
+			{
+				return std::unexpected(AgisException("expected window to be object"));
+			}
+			LoadWindow window;
+			if (window_json.HasMember("start")) window.start = window_json["start"].GetInt64();
+			if (window_json.HasMember("end")) window.end = window_json["end"].GetInt64();
+			if (window_json.HasMember("columns"))
+			{
+				auto& columns = window_json["columns"];
+				if (!columns.IsArray())
+				{
+					return std::unexpected(AgisException("expected window columns to be array"));
+				}
+				std::vector<std::string> columns_vec;
+				for (auto& column : columns.GetArray())
+				{
+					columns_vec.push_back(column.GetString());
+				}
+				window.columns = columns_vec;
+			}
+			_window = window;
+		}
+
+		auto precision = StoragePrecision::FLOAT64;
+		if (exchange.value.HasMember("precision"))
+		{
+			std::string precision_str = exchange.value["precision"].GetString();
+			if (precision_str == "float32") precision = StoragePrecision::FLOAT32;
+			else if (precision_str != "float64")
+			{
+				return std::unexpected(AgisException("invalid exchange precision: " + precision_str));
+			}
+		}
+
+		auto res = hydra->create_exchange(exchange_id, dt_format, source, _symbols, _window, precision);
 		if (!res)
 		{
 			return std::unexpected(res.error());
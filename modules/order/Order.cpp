@@ -79,6 +79,52 @@ Order::Order(OrderType order_type,
 }
 
 
+//============================================================================
+Order::Order(OrderSnapshot const& snapshot,
+	Strategy* strategy,
+	size_t strategy_index,
+	size_t exchange_index,
+	size_t portfolio_index
+)
+{
+	// keeps the id of the snapshot order, the asset of a filled order is set by the caller
+	_id = snapshot.order_id;
+	_type = snapshot.type;
+	_state = snapshot.state;
+	_force_close = snapshot.force_close;
+	_asset_index = snapshot.asset_index;
+	_units = snapshot.units;
+	_fill_price = snapshot.fill_price;
+	_create_time = snapshot.create_time;
+	_fill_time = snapshot.fill_time;
+	_cancel_time = snapshot.cancel_time;
+	_strategy = strategy;
+	_strategy_index = strategy_index;
+	_portfolio_index = portfolio_index;
+	_exchange_index = exchange_index;
+}
+
+
+//============================================================================
+OrderSnapshot
+Order::snapshot() const noexcept
+{
+	// the strategy id is filled in by the caller, the order module only sees the strategy pointer
+	OrderSnapshot snapshot;
+	snapshot.type = _type;
+	snapshot.state = _state;
+	snapshot.force_close = _force_close;
+	snapshot.order_id = _id;
+	snapshot.asset_index = _asset_index;
+	snapshot.units = _units;
+	snapshot.fill_price = _fill_price;
+	snapshot.create_time = _create_time;
+	snapshot.fill_time = _fill_time;
+	snapshot.cancel_time = _cancel_time;
+	return snapshot;
+}
+
+
 //============================================================================
 void Order::fill(Asset const* asset, double avg_price_, long long fill_time)
 {
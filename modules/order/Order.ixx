@@ -37,6 +37,27 @@ export enum class OrderState
 
 class OrderFactory;
 
+
+//============================================================================
+/// <summary>
+/// Value copy of an order resting on an exchange or kept in a portfolio's order history, the
+/// strategy is referenced by id so the order can be placed back into a Hydra built with the same setup
+/// </summary>
+export struct OrderSnapshot
+{
+	OrderType type = OrderType::UNKNOWN;
+	OrderState state = OrderState::PENDING;
+	bool force_close = false;
+	size_t order_id = 0;
+	size_t asset_index = 0;
+	double units = 0;
+	double fill_price = 0;
+	long long create_time = 0;
+	long long fill_time = 0;
+	long long cancel_time = 0;
+	std::string strategy_id;
+};
+
 export class Order
 {
 	friend class ExchangeMap;
@@ -94,6 +115,13 @@ public:
 		size_t exchange_index,
 		size_t portfolio_index
 	);
+	Order(OrderSnapshot const& snapshot,
+		Strategy* strategy,
+		size_t strategy_index,
+		size_t exchange_index,
+		size_t portfolio_index
+	);
+	OrderSnapshot snapshot() const noexcept;
 	void set_parent_portfolio(Portfolio* portfolio) noexcept { this->_portfolio = portfolio; }
 	[[nodiscard]] inline bool is_force_close() const noexcept { return this->_force_close; }
 	[[nodiscard]] inline Strategy const* get_strategy() const noexcept { return this->_strategy; }
@@ -17,6 +17,7 @@ import ExchangeMapModule;
 import TradeModule;
 import StrategyModule;
 import AgisXPool;
+import AgisProfiler;
 
 import <string>;
 
@@ -224,6 +225,138 @@ void Portfolio::reset()
 }
 
 
+//============================================================================
+PortfolioSnapshot
+Portfolio::snapshot() const noexcept
+{
+	PortfolioSnapshot snapshot;
+	snapshot.portfolio_id = _portfolio_id;
+	snapshot.tracers = _tracers.snapshot();
+	snapshot.positions.reserve(_positions.size());
+	for (auto it = _positions.begin(); it != _positions.end(); ++it)
+	{
+		snapshot.positions.push_back(it->second->snapshot());
+	}
+	snapshot.order_history.reserve(_p->order_history.size());
+	for (auto order : _p->order_history)
+	{
+		auto order_snapshot = order->snapshot();
+		if (auto strategy = order->get_strategy()) order_snapshot.strategy_id = strategy->get_strategy_id();
+		snapshot.order_history.push_back(std::move(order_snapshot));
+	}
+	snapshot.trade_history.reserve(_p->trade_history.size());
+	for (auto trade : _p->trade_history)
+	{
+		snapshot.trade_history.push_back({ trade->get_strategy()->get_strategy_id(), trade->snapshot() });
+	}
+	return snapshot;
+}
+
+
+//============================================================================
+std::expected<bool, AgisException>
+Portfolio::restore(
+	PortfolioSnapshot const& snapshot,
+	std::unordered_map<std::string, Strategy*> const& strategies,
+	std::unordered_map<size_t, Order*>& restored_orders) noexcept
+{
+	// expects the portfolio to have been reset and every strategy to have restored its open trades.
+	// Parents restore before their children so that positions can link to their parent positions.
+	_tracers.restore(snapshot.tracers);
+	_step_call = false;
+
+	// an order is remembered by every portfolio up the tree from the one that placed it, it is
+	// rebuilt once and shared the same way so that only the placing portfolio frees it
+	for (auto const& order_snapshot : snapshot.order_history)
+	{
+		auto order_it = restored_orders.find(order_snapshot.order_id);
+		if (order_it == restored_orders.end())
+		{
+			auto it = strategies.find(order_snapshot.strategy_id);
+			if (it == strategies.end())
+			{
+				return std::unexpected(AgisException("Snapshot order strategy " + order_snapshot.strategy_id + " not found"));
+			}
+			auto strategy = it->second;
+			auto portfolio = strategy->get_portfolio_mut();
+			auto order = new Order(
+				order_snapshot,
+				strategy,
+				strategy->get_strategy_index(),
+				strategy->_exchange.get_exchange_index(),
+				portfolio->get_portfolio_index()
+			);
+			order->set_parent_portfolio(portfolio);
+			order->_asset = strategy->_exchange.get_asset(order_snapshot.asset_index).value_or(nullptr);
+			order_it = restored_orders.emplace(order_snapshot.order_id, order).first;
+		}
+		_p->order_history.push_back(order_it->second);
+	}
+	for (auto const& closed : snapshot.trade_history)
+	{
+		auto it = strategies.find(closed.strategy_id);
+		if (it == strategies.end())
+		{
+			return std::unexpected(AgisException("Snapshot trade strategy " + closed.strategy_id + " not found"));
+		}
+		auto asset = it->second->_exchange.get_asset(closed.trade.asset_index);
+		if (!asset)
+		{
+			return std::unexpected(AgisException("Snapshot trade asset not found in portfolio " + _portfolio_id));
+		}
+		_p->trade_history.push_back(new Trade(it->second, *asset.value(), closed.trade));
+	}
+
+	for (auto const& position_snapshot : snapshot.positions)
+	{
+		auto asset_index = position_snapshot.asset_index;
+		Asset const* asset = nullptr;
+		if (_exchange)
+		{
+			auto asset_opt = _exchange.value()->get_asset(asset_index);
+			if (asset_opt) asset = asset_opt.value();
+		}
+		else if (asset_index < _exchange_map.value()->get_assets().size())
+		{
+			asset = _exchange_map.value()->get_assets()[asset_index];
+		}
+		if (!asset)
+		{
+			return std::unexpected(AgisException("Snapshot position asset not found in portfolio " + _portfolio_id));
+		}
+
+		Position* position = _p->position_pool.get(asset, position_snapshot);
+		for (auto const& strategy_id : position_snapshot.strategy_ids)
+		{
+			auto it = strategies.find(strategy_id);
+			if (it == strategies.end())
+			{
+				return std::unexpected(AgisException("Snapshot strategy " + strategy_id + " not found"));
+			}
+			auto trade_opt = it->second->get_trade_mut(asset_index);
+			if (!trade_opt)
+			{
+				return std::unexpected(AgisException("Snapshot trade of strategy " + strategy_id + " not found"));
+			}
+			auto trade = trade_opt.value();
+			position->_trades.insert({ trade->get_strategy_index(), trade });
+			if (trade->_portfolio == this) trade->_parent_position = position;
+		}
+		if (!position->_trades.empty())
+		{
+			auto trade = position->_trades.begin()->second;
+			position->_strategy_index = trade->get_strategy_index();
+			position->_portfolio_index = trade->get_portfolio_index();
+		}
+		position->parent_position = get_parent_position(asset_index);
+		TbbAccessor accessor;
+		_positions.insert(accessor, asset_index);
+		accessor->second = position;
+	}
+	return true;
+}
+
+
 //============================================================================
 void
 Portfolio::zero_out()
@@ -284,26 +417,42 @@ Portfolio::evaluate(bool on_close, bool is_reprice)
 }
 
 
+//============================================================================
+void
+Portfolio::step_strategy(Strategy* strategy) noexcept
+{
+	if (strategy->has_exception() || strategy->is_disabled()) {
+		return;
+	}
+	auto profile_begin = PROFILER_AVAILABLE && strategy->_profile ? read_cycles() : 0;
+	auto res = strategy->step();
+	if (profile_begin) strategy->_step_profile.add(read_cycles() - profile_begin);
+	if (!res) {
+		strategy->set_exception(std::move(res.error()));
+	}
+}
+
+
 //============================================================================
 std::expected<bool, AgisException>
-Portfolio::step()
+Portfolio::step(std::vector<Strategy*>* batch)
 {
+	// strategies to step are either spawned on the task group or, given a batch, collected so the
+	// caller can run them on its own workers
 	if (_step_call) {
 		for (auto& strategy_pair : _strategies) {
 			auto strategy = strategy_pair.second.get();
+			if (batch) {
+				batch->push_back(strategy);
+				continue;
+			}
 			_task_group.run([strategy]() {
-				if (strategy->has_exception() || strategy->is_disabled()) {
-					return;
-				}
-				auto res = strategy->step();
-				if (!res) {
-					strategy->set_exception(std::move(res.error()));
-				}
+				step_strategy(strategy);
 				});
 		}
 	}
 	for (auto& [index, child_portfolio] : _child_portfolios) {
-		AGIS_ASSIGN_OR_RETURN(res, child_portfolio->step());
+		AGIS_ASSIGN_OR_RETURN(res, child_portfolio->step(batch));
 	}
 	_step_call = false;
 	return true;
@@ -728,4 +877,12 @@ Portfolio::order_history() const noexcept
 	return _p->order_history;
 }
 
+
+//============================================================================
+tbb::concurrent_vector<Trade*> const&
+Portfolio::trade_history() const noexcept
+{
+	return _p->trade_history;
+}
+
 }
\ No newline at end of file
@@ -17,9 +17,15 @@ export module PortfolioModule;
 import <optional>;
 import <expected>;
 import <shared_mutex>;
+import <string>;
+import <vector>;
+import <unordered_map>;
 
 import AgisError;
 import ExchangeModule;
+import OrderModule;
+import PositionModule;
+import TradeModule;
 import StrategyTracerModule;
 
 namespace Agis
@@ -27,6 +33,33 @@ namespace Agis
 
 class PortfolioPrivate;
 
+
+//============================================================================
+/// <summary>
+/// Value copy of a trade kept in a portfolio's trade history, referenced by strategy id
+/// </summary>
+export struct ClosedTradeSnapshot
+{
+	std::string strategy_id;
+	TradeSnapshot trade;
+};
+
+
+//============================================================================
+/// <summary>
+/// Value copy of the run state of a single portfolio, its child portfolios and strategies are
+/// captured separately. The order history holds the orders remembered by the portfolio in the
+/// order they were remembered, including the ones placed by its children.
+/// </summary>
+export struct PortfolioSnapshot
+{
+	std::string portfolio_id;
+	TracerSnapshot tracers;
+	std::vector<PositionSnapshot> positions;
+	std::vector<OrderSnapshot> order_history;
+	std::vector<ClosedTradeSnapshot> trade_history;
+};
+
 export class Portfolio
 {
 	friend class Hydra;
@@ -55,10 +88,17 @@ private:
 	void reset();
 	void zero_out();
 	void build_mutex_map() noexcept;
+	PortfolioSnapshot snapshot() const noexcept;
+	[[nodiscard]] std::expected<bool, AgisException> restore(
+		PortfolioSnapshot const& snapshot,
+		std::unordered_map<std::string, Strategy*> const& strategies,
+		std::unordered_map<size_t, Order*>& restored_orders
+	) noexcept;
 	std::mutex& get_asset_mutex(size_t asset_index) const noexcept;
 	[[nodiscard]] std::expected<bool, AgisException> remove_strategy(Strategy& strategy);
 	[[nodiscard]] std::expected<bool, AgisException> evaluate(bool on_close, bool is_reprice);
-	[[nodiscard]] std::expected<bool, AgisException> step();
+	[[nodiscard]] std::expected<bool, AgisException> step(std::vector<Strategy*>* batch = nullptr);
+	static void step_strategy(Strategy* strategy) noexcept;
 
 	template <typename T>
 	void free_object_vector(tbb::concurrent_vector<T*>& objects);
@@ -111,6 +151,7 @@ public:
 	AGIS_API double get_nlv() const noexcept;
 	AGIS_API auto const& positions() const noexcept {return _positions;}
 	AGIS_API tbb::concurrent_vector<Order*> const& order_history() const noexcept;
+	AGIS_API tbb::concurrent_vector<Trade*> const& trade_history() const noexcept;
 	AGIS_API auto const& get_tracers() const noexcept { return _tracers; }
 	AGIS_API bool has_tracer(Tracer t) const noexcept { return _tracers.has(t); }
 	AGIS_API void set_tracer(Tracer t) noexcept { _tracers.set(t); }
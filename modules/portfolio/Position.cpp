@@ -133,6 +133,57 @@ Position::init(
 }
 
 
+//============================================================================
+void
+Position::init(Asset const* asset, PositionSnapshot const& snapshot) noexcept
+{
+	// trades and the parent position are linked by the portfolio that restores the position
+	_asset = asset;
+	_position_id = _position_counter++;
+	parent_position = std::nullopt;
+	_units = snapshot.units;
+	_avg_price = snapshot.avg_price;
+	_open_price = snapshot.open_price;
+	_close_price = snapshot.close_price;
+	_last_price = snapshot.last_price;
+	_nlv = snapshot.nlv;
+	_unrealized_pnl = snapshot.unrealized_pnl;
+	_realized_pnl = snapshot.realized_pnl;
+	_open_time = snapshot.open_time;
+	_close_time = snapshot.close_time;
+	_bars_held = snapshot.bars_held;
+	_asset_index = snapshot.asset_index;
+	_trades.clear();
+}
+
+
+//============================================================================
+PositionSnapshot
+Position::snapshot() const noexcept
+{
+	PositionSnapshot snapshot{
+		_asset_index,
+		_units,
+		_avg_price,
+		_open_price,
+		_close_price,
+		_last_price,
+		_nlv,
+		_unrealized_pnl,
+		_realized_pnl,
+		_open_time,
+		_close_time,
+		_bars_held
+	};
+	snapshot.strategy_ids.reserve(_trades.size());
+	for (auto const& [strategy_index, trade] : _trades)
+	{
+		snapshot.strategy_ids.push_back(trade->get_strategy()->get_strategy_id());
+	}
+	return snapshot;
+}
+
+
 //============================================================================
 void
 Position::reset()
@@ -13,10 +13,34 @@ export module PositionModule;
 
 import <atomic>;
 import <optional>;
+import <vector>;
+import <string>;
 
 namespace Agis
 {
 
+//============================================================================
+/// <summary>
+/// Value copy of an open position. Trades are referenced by the id of the strategy that owns them
+/// and are listed in the order the position iterates them.
+/// </summary>
+export struct PositionSnapshot
+{
+    size_t asset_index = 0;
+    double units = 0;
+    double avg_price = 0;
+    double open_price = 0;
+    double close_price = 0;
+    double last_price = 0;
+    double nlv = 0;
+    double unrealized_pnl = 0;
+    double realized_pnl = 0;
+    long long open_time = 0;
+    long long close_time = 0;
+    size_t bars_held = 0;
+    std::vector<std::string> strategy_ids;
+};
+
 export class Position
 {
     friend class Trade;
@@ -78,7 +102,9 @@ public:
         Trade* trade,
         std::optional<Position*> parent_position = std::nullopt
     ) noexcept;
+    void init(Asset const* asset, PositionSnapshot const& snapshot) noexcept;
     void reset();
+    PositionSnapshot snapshot() const noexcept;
 
 
     Position(
@@ -42,6 +42,56 @@ Trade::Trade(Strategy* strategy, Order const* order, Position* parent_position)
 }
 
 
+//============================================================================
+Trade::Trade(Strategy* strategy, Asset const& asset, TradeSnapshot const& snapshot) noexcept
+	: _asset(asset), _parent_position(nullptr)
+{
+	// the parent position is linked by the portfolio once its positions have been restored
+	_trade_id = _trade_counter++;
+	_strategy = strategy;
+	_portfolio = strategy->get_portfolio_mut();
+	_units = snapshot.units;
+	_avg_price = snapshot.avg_price;
+	_open_price = snapshot.open_price;
+	_close_price = snapshot.close_price;
+	_last_price = snapshot.last_price;
+	_nlv = snapshot.nlv;
+	_unrealized_pnl = snapshot.unrealized_pnl;
+	_realized_pnl = snapshot.realized_pnl;
+
+	_open_time = snapshot.open_time;
+	_close_time = snapshot.close_time;
+	_bars_held = snapshot.bars_held;
+	_strategy_alloc_touch = snapshot.strategy_alloc_touch;
+
+	_asset_index = snapshot.asset_index;
+	_strategy_index = strategy->get_strategy_index();
+	_portfolio_index = _portfolio->get_portfolio_index();
+}
+
+
+//============================================================================
+TradeSnapshot
+Trade::snapshot() const noexcept
+{
+	return {
+		_asset_index,
+		_units,
+		_avg_price,
+		_open_price,
+		_close_price,
+		_last_price,
+		_nlv,
+		_unrealized_pnl,
+		_realized_pnl,
+		_open_time,
+		_close_time,
+		_bars_held,
+		_strategy_alloc_touch
+	};
+}
+
+
 //============================================================================
 void Trade::close(Order const* filled_order)
 {
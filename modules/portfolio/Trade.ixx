@@ -16,6 +16,28 @@ import <atomic>;
 namespace Agis
 {
 
+//============================================================================
+/// <summary>
+/// Value copy of an open trade, the owning strategy rebuilds the trade from it on restore
+/// </summary>
+export struct TradeSnapshot
+{
+    size_t asset_index = 0;
+    double units = 0;
+    double avg_price = 0;
+    double open_price = 0;
+    double close_price = 0;
+    double last_price = 0;
+    double nlv = 0;
+    double unrealized_pnl = 0;
+    double realized_pnl = 0;
+    long long open_time = 0;
+    long long close_time = 0;
+    size_t bars_held = 0;
+    bool strategy_alloc_touch = false;
+};
+
+
 export class Trade
 {
     friend class Position;
@@ -60,6 +82,8 @@ public:
     bool is_strategy_alloc_touch() const noexcept { return _strategy_alloc_touch; }
     void set_strategy_alloc_touch(bool b) const noexcept { _strategy_alloc_touch = b; }
     Trade(Strategy* strategy, Order const* order, Position* parent_position) noexcept;
+    Trade(Strategy* strategy, Asset const& asset, TradeSnapshot const& snapshot) noexcept;
+    TradeSnapshot snapshot() const noexcept;
     ~Trade() = default;
     AGIS_API auto const get_strategy() const { return _strategy; }
     AGIS_API size_t get_portfolio_index() const { return _portfolio_index; }
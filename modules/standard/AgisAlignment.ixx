@@ -0,0 +1,159 @@
+module;
+#include <cstdint>
+#include <cstddef>
+
+export module AgisAlignment;
+
+import <vector>;
+import <span>;
+import <optional>;
+import <bit>;
+
+namespace Agis
+{
+
+//============================================================================
+/// <summary>
+/// Compact mapping from the positions of a sorted global index to the rows of a sorted local
+/// index that is a subset of it. The mapping is a bitmap over the global index with a running
+/// popcount per 64 bit word, so both membership and the local row of a global position are O(1)
+/// at a cost of roughly 1.5 bits per global position.
+/// </summary>
+export class RowAlignment
+{
+public:
+	RowAlignment() = default;
+
+	/// <summary>
+	/// Build the alignment of local against global. Every value of local must be present in
+	/// global, returns nullopt otherwise.
+	/// </summary>
+	static std::optional<RowAlignment> build(
+		std::span<long long const> local,
+		std::span<long long const> global) noexcept
+	{
+		RowAlignment alignment;
+		alignment._global = global.data();
+		alignment._size = global.size();
+		alignment._rows = local.size();
+		alignment._bits.assign((global.size() + 63) / 64, 0);
+		alignment._rank.assign(alignment._bits.size() + 1, 0);
+		size_t g = 0;
+		for (size_t row = 0; row < local.size(); row++)
+		{
+			while (g < global.size() && global[g] < local[row]) g++;
+			if (g == global.size() || global[g] != local[row]) return std::nullopt;
+			alignment._bits[g >> 6] |= uint64_t(1) << (g & 63);
+			g++;
+		}
+		for (size_t w = 0; w < alignment._bits.size(); w++)
+		{
+			alignment._rank[w + 1] = alignment._rank[w] + static_cast<uint32_t>(std::popcount(alignment._bits[w]));
+		}
+		return alignment;
+	}
+
+	/// <summary>
+	/// Point the alignment at a copy of the global index it was built against
+	/// </summary>
+	void rebind(std::span<long long const> global) noexcept
+	{
+		if (global.size() != _size)
+		{
+			*this = RowAlignment();
+			return;
+		}
+		_global = global.data();
+	}
+
+	/// <summary>
+	/// True if the local index has a row at global position g
+	/// </summary>
+	inline bool contains(size_t g) const noexcept
+	{
+		return g < _size && (_bits[g >> 6] >> (g & 63)) & 1;
+	}
+
+	/// <summary>
+	/// Number of local rows strictly before global position g
+	/// </summary>
+	inline size_t rank(size_t g) const noexcept
+	{
+		if (g >= _size) return _rows;
+		auto word = _bits[g >> 6] & ((uint64_t(1) << (g & 63)) - 1);
+		return _rank[g >> 6] + std::popcount(word);
+	}
+
+	/// <summary>
+	/// Local row at global position g, or nullopt if the local index has no row there
+	/// </summary>
+	inline std::optional<size_t> row(size_t g) const noexcept
+	{
+		if (!contains(g)) return std::nullopt;
+		return rank(g);
+	}
+
+	/// <summary>
+	/// True if both alignments were built against the same global index
+	/// </summary>
+	inline bool same_index(RowAlignment const& other) const noexcept
+	{
+		return !empty() && _global == other._global && _size == other._size;
+	}
+
+	/// <summary>
+	/// True if every row of other is also a row of this alignment and no row of this alignment
+	/// falls between the first and last row of other. Both must be built against the same global index.
+	/// </summary>
+	bool encloses(RowAlignment const& other) const noexcept
+	{
+		if (!same_index(other) || other._rows > _rows) return false;
+		if (!other._rows) return true;
+		auto first = other.first();
+		auto last = other.last();
+		if (rank(last + 1) - rank(first) != other._rows) return false;
+		for (size_t w = first >> 6; w <= (last >> 6); w++)
+		{
+			if (other._bits[w] & ~_bits[w]) return false;
+		}
+		return true;
+	}
+
+	/// <summary>
+	/// Global position of the first local row, size() if there are no rows
+	/// </summary>
+	size_t first() const noexcept
+	{
+		for (size_t w = 0; w < _bits.size(); w++)
+		{
+			if (_bits[w]) return (w << 6) + std::countr_zero(_bits[w]);
+		}
+		return _size;
+	}
+
+	/// <summary>
+	/// Global position of the last local row, size() if there are no rows
+	/// </summary>
+	size_t last() const noexcept
+	{
+		for (size_t w = _bits.size(); w-- > 0;)
+		{
+			if (_bits[w]) return (w << 6) + 63 - std::countl_zero(_bits[w]);
+		}
+		return _size;
+	}
+
+	size_t size() const noexcept { return _size; }
+	size_t rows() const noexcept { return _rows; }
+	bool empty() const noexcept { return _bits.empty(); }
+	size_t bytes() const noexcept { return _bits.size() * sizeof(uint64_t) + _rank.size() * sizeof(uint32_t); }
+
+private:
+	std::vector<uint64_t> _bits;
+	std::vector<uint32_t> _rank;
+	long long const* _global = nullptr;
+	size_t _size = 0;
+	size_t _rows = 0;
+};
+
+}
@@ -0,0 +1,74 @@
+// AgisAllocCounter.cpp : allocation counting for benchmarks. Not a module unit, replacement
+// operator new and delete have to be declared in the global module.
+#ifdef AGISCORE_EXPORTS
+#define AGIS_API __declspec(dllexport)
+#else
+#define AGIS_API __declspec(dllimport)
+#endif
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace Agis
+{
+
+#ifdef AGIS_COUNT_ALLOCATIONS
+static std::atomic<uint64_t> allocations = 0;
+#endif
+
+
+//============================================================================
+AGIS_API bool
+allocation_counting() noexcept
+{
+#ifdef AGIS_COUNT_ALLOCATIONS
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+//============================================================================
+AGIS_API uint64_t
+allocation_count() noexcept
+{
+#ifdef AGIS_COUNT_ALLOCATIONS
+	return allocations.load(std::memory_order_relaxed);
+#else
+	return 0;
+#endif
+}
+
+}
+
+
+#ifdef AGIS_COUNT_ALLOCATIONS
+//============================================================================
+// array and nothrow forms forward to these, aligned allocations are left to the runtime
+void*
+operator new(std::size_t size)
+{
+	Agis::allocations.fetch_add(1, std::memory_order_relaxed);
+	if (auto p = std::malloc(size ? size : 1)) return p;
+	throw std::bad_alloc();
+}
+
+
+//============================================================================
+void
+operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+
+//============================================================================
+void
+operator delete(void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+#endif
@@ -0,0 +1,34 @@
+module;
+
+#pragma once
+#ifdef AGISCORE_EXPORTS
+#define AGIS_API __declspec(dllexport)
+#else
+#define AGIS_API __declspec(dllimport)
+#endif
+
+#include <cstdint>
+
+export module AgisAllocCounter;
+
+//============================================================================
+// declared with C++ language linkage so the counting operator new, which must live outside of
+// any module, can define them in the same translation unit
+export extern "C++"
+{
+namespace Agis
+{
+
+/// <summary>
+/// True if AgisCore was built with AGIS_COUNT_ALLOCATIONS and counts its heap allocations
+/// </summary>
+AGIS_API bool allocation_counting() noexcept;
+
+/// <summary>
+/// Number of operator new calls made inside AgisCore since the library was loaded, always 0 when
+/// allocations are not counted
+/// </summary>
+AGIS_API uint64_t allocation_count() noexcept;
+
+}
+}
@@ -1,12 +1,18 @@
+module;
+#include <tbb/parallel_invoke.h>
+#include <functional>
 export module AgisArrayUtils;
 
 import <vector>;
+import <span>;
+import <optional>;
+import <algorithm>;
 
 export namespace Agis
 {
 
 std::vector<long long>
-    sorted_union(const std::vector<long long>& vec1, const std::vector<long long>& vec2) {
+    sorted_union(std::span<long long const> vec1, std::span<long long const> vec2) {
     std::vector<long long> result;
     int i = 0;
     int j = 0;
@@ -51,4 +57,90 @@ std::vector<long long>
     return result;
 }
 
-}
\ No newline at end of file
+/// <summary>
+/// Merge any number of sorted inputs into a single sorted index of unique values. A min heap holds
+/// the head of every non empty input so the result is written once in O(T log k) with no
+/// intermediate vectors, where T is the total number of values and k the number of inputs.
+/// </summary>
+void
+    sorted_union(std::span<std::span<long long const> const> inputs, std::vector<long long>& result) {
+    result.clear();
+    struct Head {
+        long long value;
+        size_t input;
+        size_t position;
+    };
+    auto greater = [](Head const& a, Head const& b) { return a.value > b.value; };
+
+    std::vector<Head> heap;
+    heap.reserve(inputs.size());
+    size_t max_size = 0;
+    for (size_t i = 0; i < inputs.size(); i++) {
+        if (inputs[i].empty()) continue;
+        heap.push_back({ inputs[i][0], i, 0 });
+        max_size = std::max(max_size, inputs[i].size());
+    }
+    std::make_heap(heap.begin(), heap.end(), greater);
+    result.reserve(max_size);
+
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), greater);
+        auto& head = heap.back();
+        if (result.empty() || head.value != result.back()) {
+            result.push_back(head.value);
+        }
+        auto const& input = inputs[head.input];
+        if (++head.position < input.size()) {
+            head.value = input[head.position];
+            std::push_heap(heap.begin(), heap.end(), greater);
+        }
+        else {
+            heap.pop_back();
+        }
+    }
+}
+
+
+/// <summary>
+/// Divide and conquer variant of the k-way sorted_union for very large numbers of inputs. Each half
+/// of the inputs is merged on its own task until a group is small enough for the heap merge, then
+/// the two halves are joined with a linear two way union.
+/// </summary>
+void
+    parallel_sorted_union(
+        std::span<std::span<long long const> const> inputs,
+        std::vector<long long>& result,
+        size_t grain_size = 64) {
+    if (inputs.size() <= std::max<size_t>(grain_size, 2)) {
+        sorted_union(inputs, result);
+        return;
+    }
+    auto mid = inputs.size() / 2;
+    std::vector<long long> left, right;
+    tbb::parallel_invoke(
+        [&] { parallel_sorted_union(inputs.first(mid), left, grain_size); },
+        [&] { parallel_sorted_union(inputs.subspan(mid), right, grain_size); }
+    );
+    result = sorted_union(left, right);
+}
+
+/// <summary>
+/// Insert value into a sorted vector of unique values if it is not already present. Returns the
+/// position of value, or nullopt if value is new and would land before min_position, i.e. in the
+/// part of the index that has already been consumed.
+/// </summary>
+std::optional<size_t>
+    sorted_insert(std::vector<long long>& vec, long long value, size_t min_position) noexcept {
+    auto it = std::lower_bound(vec.begin(), vec.end(), value);
+    size_t position = static_cast<size_t>(it - vec.begin());
+    if (it != vec.end() && *it == value) {
+        return position;
+    }
+    if (position < min_position) {
+        return std::nullopt;
+    }
+    vec.insert(it, value);
+    return position;
+}
+
+}
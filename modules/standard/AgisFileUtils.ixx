@@ -2,6 +2,9 @@ export module AgisFileUtils;
 
 import <expected>;
 import <filesystem>;
+import <optional>;
+import <string>;
+import <vector>;
 
 
 import AgisError;
@@ -17,6 +20,64 @@ enum class FileType
 };
 
 
+//============================================================================
+/// <summary>
+/// Throughput counters recorded while loading asset data from disk
+/// </summary>
+struct FileLoadStats
+{
+	size_t bytes = 0;
+	size_t rows = 0;
+	double seconds = 0.0;
+
+	double bytes_per_second() const noexcept { return seconds > 0.0 ? bytes / seconds : 0.0; }
+	double rows_per_second() const noexcept { return seconds > 0.0 ? rows / seconds : 0.0; }
+};
+
+
+//============================================================================
+/// <summary>
+/// Restricts an exchange load to the rows in [start, end] (epoch nanoseconds, inclusive)
+/// and to a subset of columns. The open and close columns are always loaded so the
+/// exchange can price orders. Unset members leave that dimension unrestricted.
+/// </summary>
+struct LoadWindow
+{
+	std::optional<long long> start;
+	std::optional<long long> end;
+	std::optional<std::vector<std::string>> columns;
+
+	bool before_start(long long dt) const noexcept { return start && dt < *start; }
+	bool after_end(long long dt) const noexcept { return end && dt > *end; }
+	bool is_full() const noexcept { return !start && !end && !columns; }
+};
+
+
+//============================================================================
+/// <summary>
+/// Rows of one asset held in memory, data is row major with one value per column of its source
+/// for every entry of dt_index (epoch nanoseconds, strictly increasing)
+/// </summary>
+struct AssetPanel
+{
+	std::string asset_id;
+	std::vector<long long> dt_index;
+	std::vector<double> data;
+};
+
+
+//============================================================================
+/// <summary>
+/// In memory exchange source, an alternative to a csv folder or h5 file for data that is
+/// generated or already loaded by the caller. Every asset shares the same columns.
+/// </summary>
+struct MemorySource
+{
+	std::vector<std::string> columns;
+	std::vector<AssetPanel> assets;
+};
+
+
 std::expected<FileType, AgisException> get_file_type(std::string file_path)
 {
 	if (!std::filesystem::exists(file_path))
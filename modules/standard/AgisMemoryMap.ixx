@@ -0,0 +1,150 @@
+module;
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <cstddef>
+#include "AgisDeclare.h"
+
+export module AgisMemoryMap;
+
+import <string>;
+import <expected>;
+import <memory>;
+
+import AgisError;
+
+namespace Agis
+{
+
+//============================================================================
+/// <summary>
+/// Read only memory mapping of a file on disk. Any pointer handed out by data()
+/// is only valid for the lifetime of the mapping.
+/// </summary>
+export class MemoryMappedFile
+{
+public:
+	~MemoryMappedFile() { close(); }
+	MemoryMappedFile(MemoryMappedFile const&) = delete;
+	MemoryMappedFile& operator=(MemoryMappedFile const&) = delete;
+
+	/// <summary>
+	/// Map a file read only. Pass sequential = false for mappings that are held open and
+	/// revisited, such as the exchange cache, so the OS does not drop pages behind the reader.
+	/// </summary>
+	static std::expected<UniquePtr<MemoryMappedFile>, AgisException> open(
+		std::string const& path,
+		bool sequential = true
+	) noexcept;
+
+	char const* data() const noexcept { return _data; }
+	char const* end() const noexcept { return _data + _size; }
+	size_t size() const noexcept { return _size; }
+	std::string const& path() const noexcept { return _path; }
+
+private:
+	MemoryMappedFile() = default;
+	void close() noexcept;
+
+	std::string _path;
+	char const* _data = nullptr;
+	size_t _size = 0;
+#ifdef _WIN32
+	HANDLE _file = INVALID_HANDLE_VALUE;
+	HANDLE _mapping = nullptr;
+#else
+	int _fd = -1;
+#endif
+};
+
+
+//============================================================================
+std::expected<UniquePtr<MemoryMappedFile>, AgisException>
+MemoryMappedFile::open(std::string const& path, bool sequential) noexcept
+{
+	auto m = UniquePtr<MemoryMappedFile>(new MemoryMappedFile());
+	m->_path = path;
+#ifdef _WIN32
+	m->_file = CreateFileA(
+		path.c_str(),
+		GENERIC_READ,
+		FILE_SHARE_READ,
+		nullptr,
+		OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | (sequential ? FILE_FLAG_SEQUENTIAL_SCAN : 0),
+		nullptr
+	);
+	if (m->_file == INVALID_HANDLE_VALUE)
+	{
+		return std::unexpected(AgisException("Could not open file " + path));
+	}
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(m->_file, &file_size))
+	{
+		return std::unexpected(AgisException("Could not get size of file " + path));
+	}
+	m->_size = static_cast<size_t>(file_size.QuadPart);
+	// zero length files can not be mapped, leave data as nullptr
+	if (!m->_size) return m;
+	m->_mapping = CreateFileMappingA(m->_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!m->_mapping)
+	{
+		return std::unexpected(AgisException("Could not create file mapping for " + path));
+	}
+	m->_data = static_cast<char const*>(MapViewOfFile(m->_mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+	m->_fd = ::open(path.c_str(), O_RDONLY);
+	if (m->_fd < 0)
+	{
+		return std::unexpected(AgisException("Could not open file " + path));
+	}
+	struct stat st;
+	if (fstat(m->_fd, &st) != 0)
+	{
+		return std::unexpected(AgisException("Could not get size of file " + path));
+	}
+	m->_size = static_cast<size_t>(st.st_size);
+	if (!m->_size) return m;
+	void* addr = mmap(nullptr, m->_size, PROT_READ, MAP_SHARED, m->_fd, 0);
+	if (addr == MAP_FAILED)
+	{
+		return std::unexpected(AgisException("Could not create file mapping for " + path));
+	}
+	if (sequential) madvise(addr, m->_size, MADV_SEQUENTIAL);
+	m->_data = static_cast<char const*>(addr);
+#endif
+	if (!m->_data)
+	{
+		return std::unexpected(AgisException("Could not map view of file " + path));
+	}
+	return m;
+}
+
+
+//============================================================================
+void
+MemoryMappedFile::close() noexcept
+{
+#ifdef _WIN32
+	if (_data) UnmapViewOfFile(_data);
+	if (_mapping) CloseHandle(_mapping);
+	if (_file != INVALID_HANDLE_VALUE) CloseHandle(_file);
+	_mapping = nullptr;
+	_file = INVALID_HANDLE_VALUE;
+#else
+	if (_data) munmap(const_cast<char*>(_data), _size);
+	if (_fd >= 0) ::close(_fd);
+	_fd = -1;
+#endif
+	_data = nullptr;
+	_size = 0;
+}
+
+}
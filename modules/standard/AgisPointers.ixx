@@ -143,4 +143,31 @@ private:
     std::size_t elementCount;  // Number of elements
     std::size_t strideSize;    // Size of the stride
 };
-}
\ No newline at end of file
+
+
+//============================================================================
+/// <summary>
+/// Read only strided view of one column of an asset panel stored as either double or float.
+/// Reads always return double so callers do not depend on the storage precision.
+/// </summary>
+export class StridedColumn {
+public:
+    StridedColumn(double const* ptr, std::size_t size, std::size_t stride)
+        : f64(ptr), elementCount(size), strideSize(stride) {}
+    StridedColumn(float const* ptr, std::size_t size, std::size_t stride)
+        : f32(ptr), elementCount(size), strideSize(stride) {}
+
+    double operator[](std::size_t index) const noexcept {
+        if (f32) return static_cast<double>(f32[index * strideSize]);
+        return f64[index * strideSize];
+    }
+
+    size_t size() const { return this->elementCount; }
+
+private:
+    double const* f64 = nullptr;
+    float const* f32 = nullptr;
+    std::size_t elementCount;
+    std::size_t strideSize;
+};
+}
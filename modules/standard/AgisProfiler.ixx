@@ -0,0 +1,357 @@
+module;
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+export module AgisProfiler;
+
+namespace Agis
+{
+
+//============================================================================
+/// <summary>
+/// Step profiling is compiled in unless AGIS_DISABLE_PROFILER is defined, in which case every
+/// profiling branch folds to a constant false and the hooks cost nothing
+/// </summary>
+#ifdef AGIS_DISABLE_PROFILER
+export constexpr bool PROFILER_AVAILABLE = false;
+#else
+export constexpr bool PROFILER_AVAILABLE = true;
+#endif
+
+
+//============================================================================
+/// <summary>
+/// Read the time stamp counter, or the steady clock in nanoseconds where there is none
+/// </summary>
+export inline uint64_t read_cycles() noexcept
+{
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+
+//============================================================================
+/// <summary>
+/// Phases of a Hydra step. Observer updates run inside the exchange step and are also counted
+/// there, reprice and evaluate are the master portfolio evaluations before and after the orders.
+/// </summary>
+export enum class StepPhase : uint8_t
+{
+	EXCHANGE_STEP,
+	OBSERVERS,
+	REPRICE,
+	STRATEGY_STEP,
+	PROCESS_ORDERS,
+	EVALUATE,
+	COUNT
+};
+
+export constexpr size_t STEP_PHASE_COUNT = static_cast<size_t>(StepPhase::COUNT);
+
+
+//============================================================================
+export constexpr std::string_view step_phase_name(StepPhase phase) noexcept
+{
+	switch (phase)
+	{
+		case StepPhase::EXCHANGE_STEP: return "exchange_step";
+		case StepPhase::OBSERVERS: return "observers";
+		case StepPhase::REPRICE: return "reprice";
+		case StepPhase::STRATEGY_STEP: return "strategy_step";
+		case StepPhase::PROCESS_ORDERS: return "process_orders";
+		case StepPhase::EVALUATE: return "evaluate";
+		default: return "unknown";
+	}
+}
+
+
+//============================================================================
+/// <summary>
+/// Call count and cycle totals of one phase as read from a PhaseCounter
+/// </summary>
+export struct PhaseStats
+{
+	uint64_t count = 0;
+	uint64_t cycles = 0;
+	uint64_t max_cycles = 0;
+
+	double mean_cycles() const noexcept { return count ? static_cast<double>(cycles) / count : 0.0; }
+
+	PhaseStats& operator+=(PhaseStats const& other) noexcept
+	{
+		count += other.count;
+		cycles += other.cycles;
+		if (other.max_cycles > max_cycles) max_cycles = other.max_cycles;
+		return *this;
+	}
+};
+
+
+//============================================================================
+/// <summary>
+/// Accumulates the cycles of one phase. Only one thread adds at a time, the counters are relaxed
+/// atomics so another thread can read them in the middle of a run without tearing.
+/// </summary>
+export class PhaseCounter
+{
+public:
+	PhaseCounter() = default;
+	PhaseCounter(PhaseCounter const&) = delete;
+	PhaseCounter& operator=(PhaseCounter const&) = delete;
+
+	inline void add(uint64_t cycles) noexcept
+	{
+		_count.store(_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		_cycles.store(_cycles.load(std::memory_order_relaxed) + cycles, std::memory_order_relaxed);
+		if (cycles > _max_cycles.load(std::memory_order_relaxed))
+		{
+			_max_cycles.store(cycles, std::memory_order_relaxed);
+		}
+	}
+
+	PhaseStats read() const noexcept
+	{
+		return {
+			_count.load(std::memory_order_relaxed),
+			_cycles.load(std::memory_order_relaxed),
+			_max_cycles.load(std::memory_order_relaxed)
+		};
+	}
+
+	void clear() noexcept
+	{
+		_count.store(0, std::memory_order_relaxed);
+		_cycles.store(0, std::memory_order_relaxed);
+		_max_cycles.store(0, std::memory_order_relaxed);
+	}
+
+private:
+	std::atomic<uint64_t> _count = 0;
+	std::atomic<uint64_t> _cycles = 0;
+	std::atomic<uint64_t> _max_cycles = 0;
+};
+
+
+//============================================================================
+/// <summary>
+/// Phase counters of one scope such as an exchange, along with the bounds of the last interval
+/// recorded for each phase so the owner of a trace can pick them up after the phase
+/// </summary>
+export class ScopeProfile
+{
+public:
+	inline void record(StepPhase phase, uint64_t begin, uint64_t end) noexcept
+	{
+		auto i = static_cast<size_t>(phase);
+		_phases[i].add(end - begin);
+		_last_begin[i] = begin;
+		_last_end[i] = end;
+	}
+
+	PhaseCounter const& get(StepPhase phase) const noexcept { return _phases[static_cast<size_t>(phase)]; }
+	PhaseCounter& get_mut(StepPhase phase) noexcept { return _phases[static_cast<size_t>(phase)]; }
+	uint64_t last_begin(StepPhase phase) const noexcept { return _last_begin[static_cast<size_t>(phase)]; }
+	uint64_t last_end(StepPhase phase) const noexcept { return _last_end[static_cast<size_t>(phase)]; }
+
+	std::array<PhaseStats, STEP_PHASE_COUNT> read() const noexcept
+	{
+		std::array<PhaseStats, STEP_PHASE_COUNT> stats;
+		for (size_t i = 0; i < STEP_PHASE_COUNT; i++) stats[i] = _phases[i].read();
+		return stats;
+	}
+
+	void clear() noexcept
+	{
+		for (auto& phase : _phases) phase.clear();
+		_last_begin.fill(0);
+		_last_end.fill(0);
+	}
+
+private:
+	std::array<PhaseCounter, STEP_PHASE_COUNT> _phases;
+	std::array<uint64_t, STEP_PHASE_COUNT> _last_begin{};
+	std::array<uint64_t, STEP_PHASE_COUNT> _last_end{};
+};
+
+
+//============================================================================
+/// <summary>
+/// One complete event of a Chrome trace, lane 0 is the Hydra and lane i + 1 is exchange i
+/// </summary>
+export struct TraceEvent
+{
+	StepPhase phase;
+	size_t step;
+	uint32_t lane;
+	uint64_t begin;
+	uint64_t end;
+};
+
+
+//============================================================================
+/// <summary>
+/// Per phase timings of a Hydra run along with the exchanges, portfolios and strategies they
+/// were spent in. Cycles convert to time with cycles_per_us.
+/// </summary>
+export struct StepProfile
+{
+	size_t steps = 0;
+	double cycles_per_us = 0.0;
+	std::array<PhaseStats, STEP_PHASE_COUNT> phases;
+	std::unordered_map<std::string, std::array<PhaseStats, STEP_PHASE_COUNT>> exchanges;
+	std::unordered_map<std::string, PhaseStats> portfolios;
+	std::unordered_map<std::string, PhaseStats> strategies;
+
+	PhaseStats const& get(StepPhase phase) const noexcept { return phases[static_cast<size_t>(phase)]; }
+	double to_us(uint64_t cycles) const noexcept { return cycles_per_us > 0.0 ? cycles / cycles_per_us : 0.0; }
+};
+
+
+//============================================================================
+/// <summary>
+/// Step level profiler owned by a Hydra. Records the phases of every step while enabled and keeps
+/// complete trace events for the steps inside the trace window.
+/// </summary>
+export class StepProfiler
+{
+public:
+	inline bool enabled() const noexcept { return PROFILER_AVAILABLE && _enabled; }
+
+	void set_enabled(bool enabled) noexcept
+	{
+		if (enabled && !_enabled) calibrate();
+		_enabled = enabled;
+	}
+
+	/// <summary>
+	/// Keep trace events for the steps in [begin, end), an empty window stops tracing
+	/// </summary>
+	void set_trace_window(size_t begin, size_t end) noexcept
+	{
+		_trace_begin = begin;
+		_trace_end = end;
+		_trace.clear();
+	}
+
+	inline void begin_step(size_t step) noexcept
+	{
+		_step = step;
+		_tracing = step >= _trace_begin && step < _trace_end;
+		_steps.store(_steps.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+
+	inline bool tracing() const noexcept { return _tracing; }
+
+	/// <summary>
+	/// Record the phase from begin until now and return now, so consecutive phases chain
+	/// </summary>
+	inline uint64_t mark(StepPhase phase, uint64_t begin) noexcept
+	{
+		auto end = read_cycles();
+		_scope.record(phase, begin, end);
+		if (_tracing) _trace.push_back({ phase, _step, 0, begin, end });
+		return end;
+	}
+
+	/// <summary>
+	/// Add the last interval a scope recorded for phase to the trace if it falls after since
+	/// </summary>
+	void trace_scope(ScopeProfile const& scope, StepPhase phase, uint32_t lane, uint64_t since) noexcept
+	{
+		if (!_tracing || scope.last_end(phase) <= since) return;
+		_trace.push_back({ phase, _step, lane, scope.last_begin(phase), scope.last_end(phase) });
+	}
+
+	size_t steps() const noexcept { return _steps.load(std::memory_order_relaxed); }
+	ScopeProfile const& scope() const noexcept { return _scope; }
+	std::vector<TraceEvent> const& trace() const noexcept { return _trace; }
+
+	/// <summary>
+	/// Time stamp counter ticks per microsecond measured against the steady clock since the
+	/// profiler was last enabled or cleared
+	/// </summary>
+	double cycles_per_us() const noexcept
+	{
+		auto cycles = read_cycles() - _calibration_cycles;
+		auto us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - _calibration_time).count();
+		return us > 0.0 ? cycles / us : 0.0;
+	}
+
+	void clear() noexcept
+	{
+		_scope.clear();
+		_trace.clear();
+		_steps.store(0, std::memory_order_relaxed);
+		calibrate();
+	}
+
+	/// <summary>
+	/// Chrome trace event JSON of the traced steps, lane names are given in lane order
+	/// </summary>
+	std::string trace_json(std::vector<std::string> const& lanes) const
+	{
+		auto rate = cycles_per_us();
+		if (rate <= 0.0) rate = 1.0;
+		uint64_t origin = _trace.empty() ? 0 : _trace.front().begin;
+		for (auto const& event : _trace) if (event.begin < origin) origin = event.begin;
+
+		std::string json = "{\"traceEvents\":[";
+		bool first = true;
+		for (size_t lane = 0; lane < lanes.size(); lane++)
+		{
+			if (!first) json += ",";
+			first = false;
+			json += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" + std::to_string(lane) +
+				",\"args\":{\"name\":\"" + lanes[lane] + "\"}}";
+		}
+		for (auto const& event : _trace)
+		{
+			if (!first) json += ",";
+			first = false;
+			json += "{\"name\":\"";
+			json += step_phase_name(event.phase);
+			json += "\",\"cat\":\"step\",\"ph\":\"X\",\"pid\":0,\"tid\":" + std::to_string(event.lane) +
+				",\"ts\":" + std::to_string((event.begin - origin) / rate) +
+				",\"dur\":" + std::to_string((event.end - event.begin) / rate) +
+				",\"args\":{\"step\":" + std::to_string(event.step) + "}}";
+		}
+		json += "],\"displayTimeUnit\":\"ns\"}";
+		return json;
+	}
+
+private:
+	void calibrate() noexcept
+	{
+		_calibration_cycles = read_cycles();
+		_calibration_time = std::chrono::steady_clock::now();
+	}
+
+	bool _enabled = false;
+	bool _tracing = false;
+	size_t _step = 0;
+	size_t _trace_begin = 0;
+	size_t _trace_end = 0;
+	std::atomic<size_t> _steps = 0;
+	ScopeProfile _scope;
+	std::vector<TraceEvent> _trace;
+	uint64_t _calibration_cycles = 0;
+	std::chrono::steady_clock::time_point _calibration_time = std::chrono::steady_clock::now();
+};
+
+}
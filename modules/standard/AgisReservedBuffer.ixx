@@ -0,0 +1,141 @@
+module;
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#include <cstddef>
+#include <cstring>
+#include "AgisDeclare.h"
+
+export module AgisReservedBuffer;
+
+import <expected>;
+import <memory>;
+import <string>;
+
+import AgisError;
+
+namespace Agis
+{
+
+//============================================================================
+/// <summary>
+/// Granularity in bytes at which a ReservedBuffer commits memory as it grows
+/// </summary>
+constexpr size_t RESERVED_BUFFER_CHUNK = 1 << 20;
+
+
+//============================================================================
+void*
+reserve_address_space(size_t bytes) noexcept
+{
+#ifdef _WIN32
+	return VirtualAlloc(nullptr, bytes, MEM_RESERVE, PAGE_NOACCESS);
+#else
+	void* addr = mmap(nullptr, bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	return addr == MAP_FAILED ? nullptr : addr;
+#endif
+}
+
+
+//============================================================================
+bool
+commit_address_space(void* addr, size_t bytes) noexcept
+{
+#ifdef _WIN32
+	return VirtualAlloc(addr, bytes, MEM_COMMIT, PAGE_READWRITE) != nullptr;
+#else
+	return mprotect(addr, bytes, PROT_READ | PROT_WRITE) == 0;
+#endif
+}
+
+
+//============================================================================
+void
+release_address_space(void* addr, size_t bytes) noexcept
+{
+#ifdef _WIN32
+	VirtualFree(addr, 0, MEM_RELEASE);
+#else
+	munmap(addr, bytes);
+#endif
+}
+
+
+//============================================================================
+/// <summary>
+/// Append only buffer backed by a block of reserved virtual address space. Memory is committed
+/// one chunk at a time as the buffer grows, so growing never moves the data and every pointer
+/// into the buffer stays valid for the lifetime of the buffer. The capacity is fixed at creation.
+/// </summary>
+export template <typename T>
+class ReservedBuffer
+{
+public:
+	~ReservedBuffer()
+	{
+		if (_data) release_address_space(_data, _reserved_bytes);
+	}
+	ReservedBuffer(ReservedBuffer const&) = delete;
+	ReservedBuffer& operator=(ReservedBuffer const&) = delete;
+
+	static std::expected<UniquePtr<ReservedBuffer<T>>, AgisException> create(size_t capacity) noexcept
+	{
+		auto buffer = UniquePtr<ReservedBuffer<T>>(new ReservedBuffer<T>());
+		buffer->_capacity = capacity;
+		buffer->_reserved_bytes = (capacity * sizeof(T) + RESERVED_BUFFER_CHUNK - 1) & ~(RESERVED_BUFFER_CHUNK - 1);
+		if (!buffer->_reserved_bytes) return buffer;
+		buffer->_data = static_cast<T*>(reserve_address_space(buffer->_reserved_bytes));
+		if (!buffer->_data)
+		{
+			return std::unexpected(AgisException("Failed to reserve " + std::to_string(buffer->_reserved_bytes) + " bytes"));
+		}
+		return buffer;
+	}
+
+	/// <summary>
+	/// Copy n values onto the end of the buffer, committing more memory if needed
+	/// </summary>
+	std::expected<bool, AgisException> append(T const* values, size_t n) noexcept
+	{
+		if (!n) return true;
+		if (_size + n > _capacity)
+		{
+			return std::unexpected(AgisException("Reserved buffer capacity of " + std::to_string(_capacity) + " exceeded"));
+		}
+		size_t required = (_size + n) * sizeof(T);
+		if (required > _committed_bytes)
+		{
+			size_t commit_to = (required + RESERVED_BUFFER_CHUNK - 1) & ~(RESERVED_BUFFER_CHUNK - 1);
+			auto base = reinterpret_cast<char*>(_data);
+			if (!commit_address_space(base + _committed_bytes, commit_to - _committed_bytes))
+			{
+				return std::unexpected(AgisException("Failed to commit reserved buffer memory"));
+			}
+			_committed_bytes = commit_to;
+		}
+		std::memcpy(_data + _size, values, n * sizeof(T));
+		_size += n;
+		return true;
+	}
+
+	T* data() noexcept { return _data; }
+	T const* data() const noexcept { return _data; }
+	size_t size() const noexcept { return _size; }
+	size_t capacity() const noexcept { return _capacity; }
+
+private:
+	ReservedBuffer() = default;
+
+	T* _data = nullptr;
+	size_t _size = 0;
+	size_t _capacity = 0;
+	size_t _reserved_bytes = 0;
+	size_t _committed_bytes = 0;
+};
+
+}
@@ -0,0 +1,145 @@
+module;
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+export module AgisStepPool;
+
+namespace Agis
+{
+
+//============================================================================
+/// <summary>
+/// Number of times a thread polls a PhaseBarrier before it blocks. Phases of a Hydra step are
+/// usually short enough that the next one opens within the spin and the thread never sleeps.
+/// </summary>
+constexpr size_t PHASE_BARRIER_SPIN = 1 << 14;
+
+
+//============================================================================
+/// <summary>
+/// Reusable barrier for a fixed number of threads. Arriving threads poll the phase counter for a
+/// bounded number of times and then block on it, the last thread to arrive opens the next phase.
+/// </summary>
+export class PhaseBarrier
+{
+public:
+	explicit PhaseBarrier(size_t count) noexcept : _count(count), _waiting(count) {}
+
+	PhaseBarrier(PhaseBarrier const&) = delete;
+	PhaseBarrier& operator=(PhaseBarrier const&) = delete;
+
+	void arrive_and_wait() noexcept
+	{
+		auto phase = _phase.load(std::memory_order_acquire);
+		if (_waiting.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			// every other thread is waiting on the phase so the count can be rearmed first
+			_waiting.store(_count, std::memory_order_relaxed);
+			_phase.fetch_add(1, std::memory_order_release);
+			_phase.notify_all();
+			return;
+		}
+		for (size_t i = 0; i < PHASE_BARRIER_SPIN; i++)
+		{
+			if (_phase.load(std::memory_order_acquire) != phase) return;
+		}
+		while (_phase.load(std::memory_order_acquire) == phase)
+		{
+			_phase.wait(phase, std::memory_order_acquire);
+		}
+	}
+
+private:
+	size_t const _count;
+	std::atomic<size_t> _waiting;
+	std::atomic<uint64_t> _phase = 0;
+};
+
+
+//============================================================================
+/// <summary>
+/// Fixed set of long lived threads that run a range of work split into one contiguous chunk per
+/// participant. Participant p always receives the p-th chunk, so a stable workload keeps each item
+/// on the same thread from one call to the next. The calling thread takes part as participant 0.
+/// </summary>
+export class StepPool
+{
+public:
+	/// <summary>
+	/// Create a pool of participants threads including the caller, participants - 1 workers are started
+	/// </summary>
+	explicit StepPool(size_t participants)
+		: _participants(participants ? participants : 1)
+		, _start(_participants)
+		, _done(_participants)
+	{
+		_threads.reserve(_participants - 1);
+		for (size_t p = 1; p < _participants; p++)
+		{
+			_threads.emplace_back([this, p] { worker(p); });
+		}
+	}
+
+	~StepPool()
+	{
+		_stop.store(true, std::memory_order_release);
+		_start.arrive_and_wait();
+		for (auto& thread : _threads) thread.join();
+	}
+
+	StepPool(StepPool const&) = delete;
+	StepPool& operator=(StepPool const&) = delete;
+
+	size_t size() const noexcept { return _participants; }
+
+	/// <summary>
+	/// Call work(begin, end) for every participant's chunk of [0, n) and return once all chunks are done
+	/// </summary>
+	void run(size_t n, std::function<void(size_t, size_t)> const& work) noexcept
+	{
+		if (_participants == 1 || n < 2)
+		{
+			if (n) work(0, n);
+			return;
+		}
+		_work = &work;
+		_n = n;
+		_start.arrive_and_wait();
+		run_chunk(0);
+		_done.arrive_and_wait();
+		_work = nullptr;
+	}
+
+private:
+	void run_chunk(size_t p) const noexcept
+	{
+		auto begin = _n * p / _participants;
+		auto end = _n * (p + 1) / _participants;
+		if (begin < end) (*_work)(begin, end);
+	}
+
+	void worker(size_t p) noexcept
+	{
+		while (true)
+		{
+			_start.arrive_and_wait();
+			if (_stop.load(std::memory_order_acquire)) return;
+			run_chunk(p);
+			_done.arrive_and_wait();
+		}
+	}
+
+	size_t const _participants;
+	PhaseBarrier _start;
+	PhaseBarrier _done;
+	std::vector<std::thread> _threads;
+	std::function<void(size_t, size_t)> const* _work = nullptr;
+	size_t _n = 0;
+	std::atomic<bool> _stop = false;
+};
+
+}
@@ -8,13 +8,19 @@ module;
 
 #include <iomanip>
 #include <chrono>
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <ctime>
 
 
 export module AgisTimeUtils;
 
 import <string>;
+import <string_view>;
 import <expected>;
 import <sstream>;
+import <vector>;
 
 import AgisError;
 
@@ -31,7 +37,11 @@ namespace Agis
 		std::istringstream iss(date_string);
 		iss >> std::get_time(&timeStruct, dt_format.c_str());
 
-		std::time_t utcTime = std::mktime(&timeStruct);
+#ifdef _WIN32
+		std::time_t utcTime = _mkgmtime(&timeStruct);
+#else
+		std::time_t utcTime = timegm(&timeStruct);
+#endif
 
 		// Convert to std::chrono::time_point
 		std::chrono::system_clock::time_point timePoint = std::chrono::system_clock::from_time_t(utcTime);
@@ -40,6 +50,225 @@ namespace Agis
 		return std::chrono::duration_cast<std::chrono::nanoseconds>(timePoint.time_since_epoch()).count();
 	}
 
+	/// <summary>
+	/// dt_format used for datetime columns that already hold integer epoch nanoseconds
+	/// </summary>
+	export constexpr std::string_view DT_FORMAT_EPOCH_NS = "epoch_ns";
+
+
+	//============================================================================
+	/// <summary>
+	/// Days since 1970-01-01 of a proleptic Gregorian civil date (H. Hinnant's days_from_civil).
+	/// The conditionals compile down to conditional moves.
+	/// </summary>
+	export constexpr long long days_from_civil(long long y, unsigned m, unsigned d) noexcept
+	{
+		y -= m <= 2;
+		long long const era = (y >= 0 ? y : y - 399) / 400;
+		unsigned const yoe = static_cast<unsigned>(y - era * 400);
+		unsigned const doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+		unsigned const doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+		return era * 146097 + static_cast<long long>(doe) - 719468;
+	}
+
+
+	//============================================================================
+	/// <summary>
+	/// Number of days in a month of a proleptic Gregorian year, the month must be in [1, 12]
+	/// </summary>
+	export constexpr unsigned days_in_month(long long y, unsigned m) noexcept
+	{
+		constexpr unsigned char days[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+		bool const leap = y % 4 == 0 && (y % 100 != 0 || y % 400 == 0);
+		return days[m - 1] + static_cast<unsigned>(m == 2 && leap);
+	}
+
+
+	//============================================================================
+	/// <summary>
+	/// Datetime parser compiled once from a strftime style format string. Formats made up of
+	/// %Y, %m, %d, %H, %M, %S (and the %F / %T shorthands) with fixed literals between them are
+	/// compiled to a fixed field digit parser that converts to UTC epoch nanoseconds without
+	/// touching the locale or timezone. DT_FORMAT_EPOCH_NS parses integer epoch nanoseconds and
+	/// any other format falls back to str_to_epoch.
+	/// </summary>
+	export class DateTimeParser
+	{
+	public:
+		AGIS_API explicit DateTimeParser(std::string dt_format) noexcept;
+
+		AGIS_API std::expected<long long, AgisException> parse(std::string_view date_string) const noexcept;
+		std::string const& format() const noexcept { return _format; }
+		bool is_compiled() const noexcept { return _mode != Mode::FALLBACK; }
+
+	private:
+		enum class Mode : uint8_t
+		{
+			FIXED,
+			EPOCH_NS,
+			FALLBACK
+		};
+
+		enum Field : uint8_t
+		{
+			YEAR,
+			MONTH,
+			DAY,
+			HOUR,
+			MINUTE,
+			SECOND,
+			FIELD_COUNT
+		};
+
+		static constexpr std::array<size_t, FIELD_COUNT> _widths = { 4, 2, 2, 2, 2, 2 };
+		static constexpr std::array<unsigned, FIELD_COUNT> _defaults = { 1970, 1, 1, 0, 0, 0 };
+
+		bool compile(std::string_view dt_format) noexcept;
+
+		std::string _format;
+		Mode _mode = Mode::FALLBACK;
+		size_t _length = 0;
+		std::array<int, FIELD_COUNT> _offsets = { -1, -1, -1, -1, -1, -1 };
+		std::vector<std::pair<size_t, char>> _literals;
+	};
+
+
+	//============================================================================
+	DateTimeParser::DateTimeParser(std::string dt_format) noexcept
+		: _format(std::move(dt_format))
+	{
+		if (_format == DT_FORMAT_EPOCH_NS)
+		{
+			_mode = Mode::EPOCH_NS;
+		}
+		else if (compile(_format))
+		{
+			_mode = Mode::FIXED;
+		}
+	}
+
+
+	//============================================================================
+	bool
+	DateTimeParser::compile(std::string_view dt_format) noexcept
+	{
+		// expand the %F and %T shorthands so every remaining specifier is a single field
+		std::string expanded;
+		for (size_t i = 0; i < dt_format.size(); i++)
+		{
+			if (dt_format[i] == '%' && i + 1 < dt_format.size())
+			{
+				if (dt_format[i + 1] == 'F') { expanded += "%Y-%m-%d"; i++; continue; }
+				if (dt_format[i + 1] == 'T') { expanded += "%H:%M:%S"; i++; continue; }
+			}
+			expanded += dt_format[i];
+		}
+
+		size_t offset = 0;
+		for (size_t i = 0; i < expanded.size(); i++)
+		{
+			if (expanded[i] != '%')
+			{
+				_literals.emplace_back(offset++, expanded[i]);
+				continue;
+			}
+			if (++i == expanded.size()) return false;
+			int field;
+			switch (expanded[i])
+			{
+				case 'Y': field = YEAR; break;
+				case 'm': field = MONTH; break;
+				case 'd': field = DAY; break;
+				case 'H': field = HOUR; break;
+				case 'M': field = MINUTE; break;
+				case 'S': field = SECOND; break;
+				case '%': _literals.emplace_back(offset++, '%'); continue;
+				default: return false;
+			}
+			// a field may only appear once
+			if (_offsets[field] != -1) return false;
+			_offsets[field] = static_cast<int>(offset);
+			offset += _widths[field];
+		}
+		_length = offset;
+		return true;
+	}
+
+
+	//============================================================================
+	std::expected<long long, AgisException>
+	DateTimeParser::parse(std::string_view date_string) const noexcept
+	{
+		while (!date_string.empty() && (date_string.front() == ' ' || date_string.front() == '\t'))
+			date_string.remove_prefix(1);
+		while (!date_string.empty() && (date_string.back() == ' ' || date_string.back() == '\t' || date_string.back() == '\r'))
+			date_string.remove_suffix(1);
+
+		switch (_mode)
+		{
+			case Mode::EPOCH_NS:
+			{
+				long long epoch = 0;
+				auto [ptr, ec] = std::from_chars(date_string.data(), date_string.data() + date_string.size(), epoch);
+				if (ec != std::errc() || ptr != date_string.data() + date_string.size())
+				{
+					return std::unexpected(AgisException("Invalid epoch: " + std::string(date_string)));
+				}
+				return epoch;
+			}
+			case Mode::FALLBACK:
+				return str_to_epoch(std::string(date_string), _format);
+			case Mode::FIXED:
+				break;
+		}
+
+		if (date_string.size() != _length)
+		{
+			return std::unexpected(AgisException("Datetime " + std::string(date_string) + " does not match format " + _format));
+		}
+		char const* p = date_string.data();
+		unsigned bad = 0;
+		for (auto const& [offset, c] : _literals)
+		{
+			bad |= static_cast<unsigned>(p[offset] != c);
+		}
+
+		// read every field as fixed width digits, any non digit sets the bad flag
+		std::array<unsigned, FIELD_COUNT> values = _defaults;
+		for (size_t field = 0; field < FIELD_COUNT; field++)
+		{
+			if (_offsets[field] < 0) continue;
+			char const* digits = p + _offsets[field];
+			unsigned value = 0;
+			for (size_t i = 0; i < _widths[field]; i++)
+			{
+				unsigned digit = static_cast<unsigned>(digits[i]) - '0';
+				bad |= static_cast<unsigned>(digit > 9);
+				value = value * 10 + digit;
+			}
+			values[field] = value;
+		}
+		// the day is checked against the length of the month, a bad month is checked against January
+		bool const bad_month = values[MONTH] - 1 > 11;
+		bad |= static_cast<unsigned>(bad_month);
+		bad |= static_cast<unsigned>(values[DAY] - 1 >= days_in_month(values[YEAR], bad_month ? 1 : values[MONTH]));
+		bad |= static_cast<unsigned>(values[HOUR] > 23);
+		bad |= static_cast<unsigned>(values[MINUTE] > 59);
+		bad |= static_cast<unsigned>(values[SECOND] > 60);
+		if (bad)
+		{
+			return std::unexpected(AgisException("Datetime " + std::string(date_string) + " does not match format " + _format));
+		}
+
+		long long days = days_from_civil(values[YEAR], values[MONTH], values[DAY]);
+		long long seconds = days * 86400
+			+ static_cast<long long>(values[HOUR]) * 3600
+			+ static_cast<long long>(values[MINUTE]) * 60
+			+ static_cast<long long>(values[SECOND]);
+		return seconds * 1000000000LL;
+	}
+
+
     export AGIS_API std::expected<std::string, AgisException>
     epoch_to_str(
         long long epochTime,
@@ -1,3 +1,6 @@
+module;
+#include <cstdint>
+
 export module AgisTypes;
 
 import <expected>;
@@ -10,4 +13,14 @@ export namespace Agis
 
 	template <typename T>
 	using Optional = std::optional<T>;
+
+	/// <summary>
+	/// Precision an exchange stores its asset panels in. FLOAT32 halves the footprint of the panel,
+	/// values are widened back to double whenever they are read.
+	/// </summary>
+	enum class StoragePrecision : uint8_t
+	{
+		FLOAT64,
+		FLOAT32
+	};
 }
\ No newline at end of file
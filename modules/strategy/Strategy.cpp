@@ -299,6 +299,59 @@ void Strategy::reset() noexcept
 }
 
 
+//============================================================================
+StrategySnapshot
+Strategy::snapshot() const noexcept
+{
+	StrategySnapshot snapshot;
+	snapshot.strategy_id = _strategy_id;
+	snapshot.tracers = _tracers.snapshot();
+	snapshot.trades.reserve(_p->trades.size());
+	for (auto const& [asset_index, trade] : _p->trades)
+	{
+		snapshot.trades.push_back(trade->snapshot());
+	}
+	snapshot.is_disabled = _is_disabled;
+	snapshot.exception = _exception;
+	return snapshot;
+}
+
+
+//============================================================================
+std::expected<bool, AgisException>
+Strategy::restore(StrategySnapshot const& snapshot) noexcept
+{
+	// expects the strategy to have been reset, the trades are linked to their positions by the
+	// portfolios as they restore
+	_tracers.restore(snapshot.tracers);
+	for (auto const& trade_snapshot : snapshot.trades)
+	{
+		auto asset = _exchange.get_asset(trade_snapshot.asset_index);
+		if (!asset)
+		{
+			return std::unexpected(AgisException("Snapshot trade asset not found on exchange " + _exchange.get_exchange_id()));
+		}
+		this->add_trade(new Trade(this, *asset.value(), trade_snapshot));
+	}
+	_is_disabled = snapshot.is_disabled;
+	_exception = snapshot.exception;
+	return true;
+}
+
+
+//============================================================================
+void
+Strategy::release_trades() noexcept
+{
+	// open trades are owned by the strategy until they close and move to the portfolio's history
+	for (auto& [asset_index, trade] : _p->trades)
+	{
+		delete trade;
+	}
+	_p->trades.clear();
+}
+
+
 //============================================================================
 void
 Strategy::add_trade(Trade const* trade)
@@ -15,11 +15,27 @@ export module StrategyModule;
 
 import AgisError;
 import StrategyTracerModule;
+import TradeModule;
+import AgisProfiler;
 
 
 namespace Agis
 {
 
+//============================================================================
+/// <summary>
+/// Value copy of the run state of a strategy: its tracers, its open trades and whether it has been
+/// disabled. Members of derived strategies are not part of the snapshot.
+/// </summary>
+export struct StrategySnapshot
+{
+	std::string strategy_id;
+	TracerSnapshot tracers;
+	std::vector<TradeSnapshot> trades;
+	bool is_disabled = false;
+	std::optional<AgisException> exception;
+};
+
 
 export class Strategy
 {
@@ -37,8 +53,13 @@ private:
 	StrategyTracers _tracers;
 	std::optional<AgisException> _exception;
 	Exchange const& _exchange;
+	bool _profile = false;
+	PhaseCounter _step_profile;
 	
 	void build(size_t n) {_tracers.build(n); }
+	StrategySnapshot snapshot() const noexcept;
+	[[nodiscard]] std::expected<bool, AgisException> restore(StrategySnapshot const& snapshot) noexcept;
+	void release_trades() noexcept;
 	void add_trade(Trade const* trade);
 	void remove_trade(size_t asset_index);
 
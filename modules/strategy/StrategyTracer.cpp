@@ -3,6 +3,7 @@ module;
 #include "AgisDeclare.h"
 #include "AgisMacros.h"
 #include <Eigen/Dense>
+#include <algorithm>
 module StrategyTracerModule;
 
 import PortfolioModule;
@@ -79,6 +80,47 @@ StrategyTracers::build(size_t n)
 }
 
 
+//============================================================================
+TracerSnapshot
+StrategyTracers::snapshot() const
+{
+	TracerSnapshot snapshot;
+	snapshot.nlv = this->nlv.load();
+	snapshot.cash = this->cash.load();
+	snapshot.unrealized_pnl = this->unrealized_pnl.load();
+	snapshot.starting_cash = this->starting_cash.load();
+	snapshot.current_index = _current_index;
+	auto written = [this](std::vector<double> const& history) {
+		auto n = std::min(_current_index, history.size());
+		return std::make_shared<std::vector<double> const>(history.begin(), history.begin() + n);
+	};
+	snapshot.nlv_history = written(this->nlv_history);
+	snapshot.cash_history = written(this->cash_history);
+	snapshot.weights = _weights;
+	return snapshot;
+}
+
+
+//============================================================================
+void
+StrategyTracers::restore(TracerSnapshot const& snapshot)
+{
+	auto restore_history = [](std::vector<double>& history, std::vector<double> const& written) {
+		if (history.size() < written.size()) history.resize(written.size(), 0.0);
+		std::copy(written.begin(), written.end(), history.begin());
+		std::fill(history.begin() + written.size(), history.end(), 0.0);
+	};
+	restore_history(this->nlv_history, *snapshot.nlv_history);
+	restore_history(this->cash_history, *snapshot.cash_history);
+	this->nlv.store(snapshot.nlv);
+	this->cash.store(snapshot.cash);
+	this->unrealized_pnl.store(snapshot.unrealized_pnl);
+	this->starting_cash.store(snapshot.starting_cash);
+	_current_index = snapshot.current_index;
+	if (_weights.size() == snapshot.weights.size()) _weights = snapshot.weights;
+}
+
+
 //============================================================================
 void StrategyTracers::starting_cash_add_assign(double v) noexcept
 {
@@ -190,6 +232,12 @@ std::expected<bool, AgisException> StrategyTracers::evaluate(bool is_reprice)
 		//TODO strategy added after build
 		// Note: at this point all trades have been evaluated and the cash balance has been updated
 		// so we only have to observer the values or use them to calculate other values.
+		// a live exchange can step past the dt index size the tracers were built with
+		if (_current_index >= this->nlv_history.size())
+		{
+			this->nlv_history.resize(_current_index + 1, 0.0);
+			this->cash_history.resize(_current_index + 1, 0.0);
+		}
 		if (this->has(Tracer::NLV)) this->nlv_history[_current_index] = this->nlv.load();
 		if (this->has(Tracer::CASH)) this->cash_history[_current_index] = this->cash.load();
 		_current_index++;
@@ -27,6 +27,23 @@ export enum Tracer : size_t {
     MAX = 5
 };
 
+//============================================================================
+/// <summary>
+/// Value copy of a set of tracers. Histories hold only the entries written so far and are shared
+/// between copies of the snapshot, they are copied once into the tracers' own storage on restore.
+/// </summary>
+export struct TracerSnapshot
+{
+    double nlv = 0;
+    double cash = 0;
+    double unrealized_pnl = 0;
+    double starting_cash = 0;
+    size_t current_index = 0;
+    SharedPtr<std::vector<double> const> nlv_history;
+    SharedPtr<std::vector<double> const> cash_history;
+    Eigen::VectorXd weights;
+};
+
 export class StrategyTracers {
     friend class Strategy;
     friend class Portfolio;
@@ -52,6 +69,8 @@ public:
     void zero_out_tracers();
     void reset();
     void build(size_t n);
+    TracerSnapshot snapshot() const;
+    void restore(TracerSnapshot const& snapshot);
 
     void starting_cash_add_assign(double v) noexcept;
     void cash_add_assign(double v) noexcept;